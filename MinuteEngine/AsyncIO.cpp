@@ -0,0 +1,430 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "AsyncIO.h"
+#include "IO.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+// io_uring is used through its system calls, so that liburing is not needed
+#if defined(__linux__) && !defined(ME_ASYNC_IO_NO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define ME_ASYNC_IO_URING
+#endif
+#endif
+#endif
+
+#ifdef ME_ASYNC_IO_URING
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace ME {
+#ifdef ME_ASYNC_IO_URING
+	struct AsyncIO::Ring {
+		int fd = -1;
+		void* sqPtr = MAP_FAILED;
+		void* cqPtr = MAP_FAILED;
+		io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+		size_t sqSize = 0;
+		size_t cqSize = 0;
+		size_t sqesSize = 0;
+		bool singleMap = false;			// Submission and completion rings share a mapping
+
+		unsigned* sqTail = nullptr;
+		unsigned* sqMask = nullptr;
+		unsigned* sqArray = nullptr;
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		unsigned* cqMask = nullptr;
+		io_uring_cqe* cqes = nullptr;
+
+		// A file being read. Each is in at most one submission at a time, so the rings never overflow.
+		struct Slot {
+			Request request;
+			Result result;
+			int file = -1;
+			size_t offset = 0;
+			iovec iov;
+		};
+		std::vector<Slot> slots;
+		std::vector<uint> freeSlots;
+		uint inflight = 0;
+		uint unsubmitted = 0;
+
+		~Ring() {
+			destroy();
+		}
+		bool setup(uint depth) {
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+			fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+			if (fd < 0)
+				return false;
+			sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+			singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+			if (singleMap)
+				sqSize = cqSize = std::max(sqSize, cqSize);
+			sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if (sqPtr == MAP_FAILED)
+				return false;
+			cqPtr = (singleMap ? sqPtr : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING));
+			if (cqPtr == MAP_FAILED)
+				return false;
+			sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+			if (sqes == MAP_FAILED)
+				return false;
+
+			char* sq = (char*)sqPtr;
+			sqTail = (unsigned*)(sq + params.sq_off.tail);
+			sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+			sqArray = (unsigned*)(sq + params.sq_off.array);
+			char* cq = (char*)cqPtr;
+			cqHead = (unsigned*)(cq + params.cq_off.head);
+			cqTail = (unsigned*)(cq + params.cq_off.tail);
+			cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+			cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+			slots.resize(params.sq_entries);
+			for (uint i = 0; i < params.sq_entries; i++)
+				freeSlots.push_back(params.sq_entries - 1 - i);
+			return true;
+		}
+		void destroy() {
+			if (sqes != MAP_FAILED)
+				munmap(sqes, sqesSize);
+			if (cqPtr != MAP_FAILED && !singleMap)
+				munmap(cqPtr, cqSize);
+			if (sqPtr != MAP_FAILED)
+				munmap(sqPtr, sqSize);
+			if (fd >= 0)
+				close(fd);
+			sqes = (io_uring_sqe*)MAP_FAILED;
+			cqPtr = sqPtr = MAP_FAILED;
+			fd = -1;
+		}
+
+		// Queue a read of what is left of [ slot ], to be submitted by [ enter() ]
+		void push(uint slot) {
+			Slot& s = slots[slot];
+			s.iov.iov_base = s.result.data.data() + s.offset;
+			s.iov.iov_len = s.result.data.size() - s.offset;
+
+			const unsigned tail = *sqTail;		// Only this thread writes it
+			const unsigned index = tail & *sqMask;
+			io_uring_sqe* sqe = &sqes[index];
+			std::memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READV;		// Rather than IORING_OP_READ, which needs Linux 5.6
+			sqe->fd = s.file;
+			sqe->addr = (unsigned long long)(uintptr_t)&s.iov;
+			sqe->len = 1;
+			sqe->off = s.offset;
+			sqe->user_data = slot;
+			sqArray[index] = index;
+			__atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+			unsubmitted++;
+		}
+		// Submit queued reads, and wait for [ waitNum ] completions. Returns false on an error that will not pass.
+		bool enter(uint waitNum) {
+			const int ret = (int)syscall(__NR_io_uring_enter, fd, unsubmitted, waitNum, waitNum > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (ret < 0)
+				return errno == EINTR || errno == EAGAIN || errno == EBUSY;
+			unsubmitted -= std::min((uint)ret, unsubmitted);
+			return true;
+		}
+	};
+#else
+	struct AsyncIO::Ring {};
+#endif
+
+	AsyncIO::AsyncIO() = default;
+	AsyncIO::~AsyncIO() {
+		stop();
+	}
+	AsyncIO& AsyncIO::global() {
+		static AsyncIO io;
+		return io;
+	}
+
+	void AsyncIO::start(uint threadNum, bool uring) {
+		std::lock_guard<std::mutex> state(stateMutex);
+		if (!workers.empty())
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = false;
+		}
+#ifdef ME_ASYNC_IO_URING
+		if (uring) {
+			// Kernels before 5.1, or sandboxes that filter the system calls, refuse it
+			ring.reset(new Ring());
+			if (ring->setup(std::max(1u, queueDepth))) {
+				backend = ASYNC_IO_BACKEND_URING;
+				workers.emplace_back(&AsyncIO::workRing, this);
+				running = true;
+				return;
+			}
+			ring.reset();
+		}
+#else
+		(void)uring;
+#endif
+		backend = ASYNC_IO_BACKEND_THREAD;
+		if (threadNum == 0)
+			threadNum = ASYNC_IO_DEF_THREAD_NUM;
+		for (uint i = 0; i < threadNum; i++)
+			workers.emplace_back(&AsyncIO::workThread, this);
+		running = true;
+	}
+	void AsyncIO::stop() {
+		std::lock_guard<std::mutex> state(stateMutex);
+		std::deque<Request> dropped;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+		workers.clear();
+		ring.reset();
+		backend = ASYNC_IO_BACKEND_NONE;
+
+		// Requests that never started still get their callbacks, so that no one waits for them forever.
+		// New ones are refused by [ read() ] while stopping, so the queues stay empty from here.
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& queue : queues) {
+				for (auto& request : queue)
+					dropped.push_back(std::move(request));
+				queue.clear();
+			}
+		}
+		for (auto& request : dropped) {
+			Result result;
+			result.path = request.path;
+			complete(request, result);
+		}
+		running = false;
+		idle.notify_all();
+	}
+
+	void AsyncIO::read(const std::string& path, int priority, Callback callback) {
+		if (!running)
+			start();
+		priority = std::min(std::max(priority, 0), ASYNC_IO_PRIORITY_NUM - 1);
+		Request request = { path, std::move(callback) };
+		bool refused;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			refused = stopping;
+			if (!refused)
+				queues[priority].push_back(std::move(request));
+			outstanding++;
+		}
+		requestNum++;
+		if (refused) {
+			// Fails as [ stop() ] fails requests that have not started
+			Result result;
+			result.path = path;
+			complete(request, result);
+			return;
+		}
+		condition.notify_one();
+	}
+	std::future<AsyncIO::Result> AsyncIO::read(const std::string& path, int priority) {
+		auto promise = std::make_shared<std::promise<Result>>();
+		read(path, priority, [promise](Result& result) { promise->set_value(std::move(result)); });
+		return promise->get_future();
+	}
+	void AsyncIO::wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]() { return outstanding == 0; });
+	}
+
+	bool AsyncIO::pop(Request& request, bool block) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto queued = [this]() {
+			for (const auto& queue : queues)
+				if (!queue.empty())
+					return true;
+			return false;
+		};
+		if (block)
+			condition.wait(lock, [this, &queued]() { return stopping || queued(); });
+		if (stopping)
+			return false;
+		for (auto& queue : queues)
+			if (!queue.empty()) {
+				request = std::move(queue.front());
+				queue.pop_front();
+				return true;
+			}
+		return false;
+	}
+	void AsyncIO::complete(Request& request, Result& result) {
+		if (result.valid)
+			readBytes += result.data.size();
+		else
+			failedNum++;
+		if (request.callback)
+			request.callback(result);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			outstanding--;
+		}
+		idle.notify_all();
+	}
+
+	void AsyncIO::workThread() {
+		Request request;
+		while (pop(request, true)) {
+			Result result;
+			result.path = request.path;
+			result.valid = IO::read_binary(request.path, result.data);
+			complete(request, result);
+		}
+	}
+	void AsyncIO::workRing() {
+#ifdef ME_ASYNC_IO_URING
+		Ring& r = *ring;
+		auto finish = [this, &r](uint slot, bool valid) {
+			Ring::Slot& s = r.slots[slot];
+			close(s.file);
+			s.file = -1;
+			s.result.valid = valid;
+			if (!valid)
+				s.result.data.clear();
+			r.freeSlots.push_back(slot);
+			r.inflight--;
+			complete(s.request, s.result);
+			s.request = Request();
+			s.result = Result();
+		};
+		while (true) {
+			// 1. Open files into free slots, highest priority first. Sizes are known up front, so each file
+			// is read into a buffer of its own size in as few reads as the kernel allows.
+			bool drained = false;
+			while (!r.freeSlots.empty()) {
+				Request request;
+				if (!pop(request, r.inflight == 0)) {
+					drained = true;
+					break;
+				}
+				Result result;
+				result.path = request.path;
+				const int file = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+				struct stat st;
+				std::memset(&st, 0, sizeof(st));
+				const bool regular = (file >= 0 && fstat(file, &st) == 0 && S_ISREG(st.st_mode));
+				if (!regular || st.st_size == 0) {
+					result.valid = regular;		// Empty file
+					if (file >= 0)
+						close(file);
+					complete(request, result);
+					continue;
+				}
+				const uint slot = r.freeSlots.back();
+				r.freeSlots.pop_back();
+				Ring::Slot& s = r.slots[slot];
+				s.request = std::move(request);
+				s.result = std::move(result);
+				s.result.data.resize((size_t)st.st_size);
+				s.file = file;
+				s.offset = 0;
+				r.inflight++;
+				r.push(slot);
+			}
+			if (r.inflight == 0) {
+				bool stop;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stop = stopping;
+				}
+				if (stop)
+					break;
+				continue;
+			}
+
+			// 2. Submit in one call, and only wait for a completion if there is nothing else to start
+			const uint waitNum = (drained || r.freeSlots.empty()) ? 1 : 0;
+			submitNum++;
+			if (!r.enter(waitNum)) {
+				// Only fails like this if the ring itself cannot be used any more. Finish what is in it with
+				// blocking reads, and serve the rest as the fallback does.
+				for (uint i = 0; i < r.slots.size(); i++) {
+					Ring::Slot& s = r.slots[i];
+					if (s.file < 0)
+						continue;
+					while (s.offset < s.result.data.size()) {
+						const ssize_t n = pread(s.file, s.result.data.data() + s.offset, s.result.data.size() - s.offset, (off_t)s.offset);
+						if (n < 0 && errno == EINTR)
+							continue;
+						if (n <= 0)
+							break;
+						s.offset += (size_t)n;
+					}
+					finish(i, s.offset == s.result.data.size());
+				}
+				workThread();
+				return;
+			}
+
+			// 3. Reap completions, and read the rest of files that came back short
+			unsigned head = *r.cqHead;
+			while (head != __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE)) {
+				const io_uring_cqe& cqe = r.cqes[head & *r.cqMask];
+				const uint slot = (uint)cqe.user_data;
+				const int res = cqe.res;
+				head++;
+				__atomic_store_n(r.cqHead, head, __ATOMIC_RELEASE);
+
+				Ring::Slot& s = r.slots[slot];
+				if (res == -EINTR || res == -EAGAIN)
+					r.push(slot);
+				else if (res < 0)
+					finish(slot, false);
+				else if (res == 0) {
+					// File shrank since it was opened
+					s.result.data.resize(s.offset);
+					finish(slot, true);
+				}
+				else {
+					s.offset += (size_t)res;
+					if (s.offset < s.result.data.size())
+						r.push(slot);
+					else
+						finish(slot, true);
+				}
+			}
+		}
+#endif
+	}
+
+	std::string AsyncIO::getReport() const {
+		std::ostringstream ss;
+		ss << (backend == ASYNC_IO_BACKEND_URING ? "io_uring" : (backend == ASYNC_IO_BACKEND_THREAD ? "thread pool" : "stopped")) << ", " <<
+			requestNum << " reads, " << failedNum << " failed, " << readBytes / 1024 << " KiB";
+		if (backend == ASYNC_IO_BACKEND_URING)
+			ss << " in " << submitNum << " submissions";
+		return ss.str();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_ASYNC_IO_H__
+#define __ME_ASYNC_IO_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Priority classes, every queued request of a class is started before any of the next one
+#define ASYNC_IO_PRIORITY_VISIBLE		0		// Needed to draw what is in view
+#define ASYNC_IO_PRIORITY_NORMAL		1
+#define ASYNC_IO_PRIORITY_BACKGROUND	2		// Nothing on screen waits for it, e.g. demotion
+#define ASYNC_IO_PRIORITY_NUM			3
+
+#define ASYNC_IO_BACKEND_NONE			0
+#define ASYNC_IO_BACKEND_URING			1
+#define ASYNC_IO_BACKEND_THREAD			2
+
+#define ASYNC_IO_DEF_QUEUE_DEPTH		64		// Reads in flight at once on io_uring
+#define ASYNC_IO_DEF_THREAD_NUM			4		// Reading threads of the fallback, they wait on disk rather than compute
+
+namespace ME {
+	// Reads whole files off the calling thread. On Linux, reads are batched through io_uring so that many of them
+	// are in flight at once with few system calls. Elsewhere, or if the kernel refuses io_uring, a few threads
+	// read them with blocking calls. Callbacks run on the reading thread, and should hand heavy work such as
+	// decoding over to another thread, or reads behind them wait.
+	class AsyncIO {
+	public:
+		struct Result {
+			std::string path;
+			std::vector<char> data;
+			bool valid = false;				// False if the file could not be read
+		};
+		using Callback = std::function<void(Result&)>;
+	private:
+		struct Request {
+			std::string path;
+			Callback callback;
+		};
+		struct Ring;						// io_uring state, only defined where it is supported
+
+		std::mutex stateMutex;				// Held while starting or stopping, so that concurrent first reads start once
+		std::atomic<bool> running{ false };
+		std::mutex mutex;
+		std::condition_variable condition;	// Request queued, or stopping
+		std::condition_variable idle;		// Request completed
+		std::deque<Request> queues[ASYNC_IO_PRIORITY_NUM];
+		uint outstanding = 0;				// Requests queued or in flight
+		bool stopping = false;
+
+		int backend = ASYNC_IO_BACKEND_NONE;
+		uint queueDepth = ASYNC_IO_DEF_QUEUE_DEPTH;
+		std::unique_ptr<Ring> ring;
+		std::vector<std::thread> workers;
+
+		std::atomic<uint> requestNum{ 0 };
+		std::atomic<uint> failedNum{ 0 };
+		std::atomic<uint> submitNum{ 0 };	// io_uring_enter() calls
+		std::atomic<size_t> readBytes{ 0 };
+
+		// Take the request of highest priority into [ request ]. If none is queued, wait for one if [ block ],
+		// otherwise return false. Also false once stopping.
+		bool pop(Request& request, bool block);
+		void complete(Request& request, Result& result);
+		void workThread();
+		void workRing();
+	public:
+		AsyncIO();
+		AsyncIO(const AsyncIO&) = delete;
+		AsyncIO& operator=(const AsyncIO&) = delete;
+		~AsyncIO();
+
+		static AsyncIO& global();
+		// @threadNum : Reading threads of the fallback, 0 for [ ASYNC_IO_DEF_THREAD_NUM ]
+		// @uring : Use io_uring where it is supported
+		void start(uint threadNum = 0, bool uring = true);
+		// Wait for requests in flight. The ones that have not started, and any made while stopping, complete as
+		// failed reads, i.e. their callbacks get a [ Result ] that is not valid.
+		void stop();
+
+		// Read the file at [ path ] and call [ callback ] with its bytes. Starts with default backend if not started yet.
+		// Safe to call from any thread, including callbacks.
+		// @priority : ASYNC_IO_PRIORITY_*
+		void read(const std::string& path, int priority, Callback callback);
+		std::future<Result> read(const std::string& path, int priority = ASYNC_IO_PRIORITY_NORMAL);
+		// Block until every request so far has completed
+		void wait();
+
+		// Takes effect on next [ start() ]
+		inline void setQueueDepth(uint depth) noexcept {
+			queueDepth = depth;
+		}
+		inline int getBackend() const noexcept {
+			return backend;
+		}
+		inline uint getRequestNum() const noexcept {
+			return requestNum;
+		}
+		inline uint getFailedNum() const noexcept {
+			return failedNum;
+		}
+		inline size_t getReadBytes() const noexcept {
+			return readBytes;
+		}
+		std::string getReport() const;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+// Loads every file in a directory with blocking reads, then through [ AsyncIO ] on each of its backends, once with
+// files evicted from page cache ( cold ) and once right after ( warm ). Each file is hashed on a [ ThreadPool ] as it
+// arrives, standing in for decoding, so async runs show how much of disk latency they hide behind it.
+//
+// Usage : Benchmark_async_io [ directory ] [ repeat ]
+// Build with IO.cpp, AsyncIO.cpp, ThreadPool.cpp and Timer.cpp. Files are only evicted on Linux, elsewhere
+// cold runs are cold only on the first run after the files were written or the machine started.
+
+#include "../IO.h"
+#include "../AsyncIO.h"
+#include "../ThreadPool.h"
+#include "../Timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define MODE_BLOCKING	0
+#define MODE_THREAD		1
+#define MODE_URING		2
+
+std::vector<std::string> listFiles(const std::string& dir) {
+	std::vector<std::string> files;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((dir + "/*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+		return files;
+	do {
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			files.push_back(dir + "/" + data.cFileName);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (d == nullptr)
+		return files;
+	while (dirent* entry = readdir(d)) {
+		const std::string path = dir + "/" + entry->d_name;
+		struct stat st;
+		if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			files.push_back(path);
+	}
+	closedir(d);
+#endif
+	return files;
+}
+
+// Drop [ files ] from page cache, so that the next read goes to disk
+void evict(const std::vector<std::string>& files) {
+#if defined(__linux__)
+	for (const auto& file : files) {
+		const int fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)files;
+#endif
+}
+
+// FNV-1a, in place of decoding
+std::uint64_t process(const std::vector<char>& data) {
+	std::uint64_t hash = 14695981039346656037ull;
+	for (char c : data) {
+		hash ^= (unsigned char)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Seconds to load and process every file in [ files ]
+double run(const std::vector<std::string>& files, int mode, size_t& bytes) {
+	std::atomic<std::uint64_t> checksum{ 0 };
+	std::atomic<size_t> total{ 0 };
+	ME::Timer timer;
+	if (mode == MODE_BLOCKING) {
+		timer.setBeg();
+		for (const auto& file : files) {
+			std::vector<char> data;
+			if (ME::IO::read_binary(file, data)) {
+				total += data.size();
+				checksum ^= process(data);
+			}
+		}
+		timer.setEnd();
+	}
+	else {
+		ME::AsyncIO io;
+		io.start(0, mode == MODE_URING);
+		if (mode == MODE_URING && io.getBackend() != ASYNC_IO_BACKEND_URING) {
+			bytes = 0;
+			return -1.0;
+		}
+		ME::ThreadPool pool;
+		pool.start();
+		std::atomic<uint> processed{ 0 };
+
+		timer.setBeg();
+		for (const auto& file : files)
+			io.read(file, ASYNC_IO_PRIORITY_NORMAL, [&](ME::AsyncIO::Result& result) {
+				auto data = std::make_shared<std::vector<char>>(std::move(result.data));
+				total += data->size();
+				pool.push([&, data]() {
+					checksum ^= process(*data);
+					processed++;
+				});
+			});
+		io.wait();
+		while (processed < files.size())		// Failed reads are processed as empty
+			std::this_thread::yield();
+		timer.setEnd();
+	}
+	bytes = total;
+	return timer.getElapsedTime();
+}
+
+int main(int argc, char** argv) {
+	const std::string dir = (argc > 1 ? argv[1] : "Shader/glsl/330");
+	const int repeat = (argc > 2 ? std::max(1, std::atoi(argv[2])) : 3);
+	const auto files = listFiles(dir);
+	if (files.empty()) {
+		std::cout << "[BENCHMARK] : No files in " << dir << std::endl;
+		return 1;
+	}
+	std::cout << "[BENCHMARK] : " << files.size() << " files in " << dir << ", best of " << repeat << std::endl;
+
+	const char* names[3] = { "blocking", "thread pool", "io_uring" };
+	for (int mode = MODE_BLOCKING; mode <= MODE_URING; mode++) {
+		double best[2] = { 1e30, 1e30 };		// Cold, warm
+		size_t bytes = 0;
+		for (int r = 0; r < repeat; r++) {
+			evict(files);
+			best[0] = std::min(best[0], run(files, mode, bytes));
+			best[1] = std::min(best[1], run(files, mode, bytes));
+		}
+		if (best[0] < 0.0) {
+			std::cout << "    " << names[mode] << " : Not supported" << std::endl;
+			continue;
+		}
+		const double mib = (double)bytes / (1024.0 * 1024.0);
+		std::cout << "    " << names[mode] << " : cold " << best[0] * 1000.0 << " msec ( " << mib / best[0] << " MiB/s ), warm " <<
+			best[1] * 1000.0 << " msec ( " << mib / best[1] << " MiB/s )" << std::endl;
+	}
+	return 0;
+}
\ No newline at end of file
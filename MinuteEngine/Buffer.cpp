@@ -0,0 +1,403 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "Buffer.h"
+#include "Residency.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ME {
+	// FreeList
+	FreeList FreeList::create(size_t capacity) {
+		FreeList list;
+		list.capacity = capacity;
+		list.freeSize = capacity;
+		if (capacity > 0)
+			list.freeBlocks.insert({ 0, capacity });
+		return list;
+	}
+	bool FreeList::allocate(size_t size, size_t& offset) {
+		if (size == 0) {
+			offset = 0;
+			return true;
+		}
+		if (size > freeSize)
+			return false;
+
+		auto best = freeBlocks.end();
+		for (auto it = freeBlocks.begin(); it != freeBlocks.end(); it++) {
+			if (it->second < size)
+				continue;
+			if (best == freeBlocks.end() || it->second < best->second)
+				best = it;
+			if (best->second == size)
+				break;
+		}
+		if (best == freeBlocks.end())
+			return false;
+
+		offset = best->first;
+		size_t remain = best->second - size;
+		freeBlocks.erase(best);
+		if (remain > 0)
+			freeBlocks.insert({ offset + size, remain });
+		freeSize -= size;
+		return true;
+	}
+	void FreeList::free(size_t offset, size_t size) {
+		if (size == 0)
+			return;
+		freeSize += size;
+
+		// Merge with next block
+		auto next = freeBlocks.lower_bound(offset);
+		if (next != freeBlocks.end() && offset + size == next->first) {
+			size += next->second;
+			next = freeBlocks.erase(next);
+		}
+		// Merge with previous block
+		if (next != freeBlocks.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == offset) {
+				prev->second += size;
+				return;
+			}
+		}
+		freeBlocks.insert({ offset, size });
+	}
+	void FreeList::reset(size_t used) {
+		freeBlocks.clear();
+		freeSize = capacity - used;
+		if (freeSize > 0)
+			freeBlocks.insert({ used, freeSize });
+	}
+	void FreeList::grow(size_t capacity) {
+		if (capacity <= this->capacity)
+			return;
+		const size_t old = this->capacity;
+		this->capacity = capacity;
+		free(old, capacity - old);		// Merges with the free block at the end, if any
+	}
+	size_t FreeList::getLargestFreeBlock() const noexcept {
+		size_t largest = 0;
+		for (const auto& block : freeBlocks)
+			largest = std::max(largest, block.second);
+		return largest;
+	}
+	float FreeList::fragmentation() const noexcept {
+		if (freeSize == 0)
+			return 0.0f;
+		return 1.0f - (float)getLargestFreeBlock() / (float)freeSize;
+	}
+
+	// BufferArena
+	BufferArena& BufferArena::global() {
+		static BufferArena arena;
+		return arena;
+	}
+	int BufferArena::createPool(size_t vertexSize, size_t vertexNum, size_t indexNum) {
+		Pool pool;
+		pool.vertexSize = vertexSize;
+		pool.vertexList = FreeList::create(vertexNum);
+		pool.indexList = FreeList::create(indexNum);
+
+		glGenVertexArrays(1, &pool.vao);
+		glBindVertexArray(pool.vao);
+
+		// 1. VBO
+		glGenBuffers(1, &pool.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertexSize * vertexNum, NULL, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		ResidencyManager::global().setBufferBytes(pool.vbo, vertexSize * vertexNum);
+
+		// 2. EBO
+		glGenBuffers(1, &pool.ebo);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.ebo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * indexNum, NULL, GL_STATIC_DRAW);
+		ResidencyManager::global().setBufferBytes(pool.ebo, sizeof(GLuint) * indexNum);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+
+		pools.push_back(pool);
+		return (int)pools.size() - 1;
+	}
+	BufferArena::RangePtr BufferArena::allocate(const void* vertices, size_t vertexSize, size_t vertexNum, const uint* indices, size_t indexNum) {
+		RangePtr range = std::make_shared<Range>();
+		range->vertexNum = vertexNum;
+		range->indexNum = indexNum;
+
+		// Find a pool of the same vertex format with enough room, growing it if needed, or create a new one.
+		int id = -1;
+		for (int i = 0; i < (int)pools.size() && id == -1; i++) {
+			auto& pool = pools[i];
+			if (pool.vertexSize != vertexSize)
+				continue;
+			if (!reserve(pool, vertexNum, indexNum))
+				continue;
+			if (!pool.vertexList.allocate(vertexNum, range->vertexOffset))
+				continue;
+			if (!pool.indexList.allocate(indexNum, range->indexOffset)) {
+				pool.vertexList.free(range->vertexOffset, vertexNum);
+				continue;
+			}
+			id = i;
+		}
+		if (id == -1) {
+			id = createPool(vertexSize,
+				std::max(vertexNum, (size_t)ARENA_DEF_POOL_VERTEX_NUM),
+				std::max(indexNum, (size_t)ARENA_DEF_POOL_INDEX_NUM));
+			pools[id].vertexList.allocate(vertexNum, range->vertexOffset);
+			pools[id].indexList.allocate(indexNum, range->indexOffset);
+		}
+		range->pool = id;
+
+		// Upload through COPY_WRITE target, so that EBO binding of the current VAO is not touched.
+		auto& pool = pools[id];
+		glBindBuffer(GL_COPY_WRITE_BUFFER, pool.vbo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, vertexSize * range->vertexOffset, vertexSize * vertexNum, vertices);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(GLuint) * range->indexOffset, sizeof(GLuint) * indexNum, indices);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		pool.ranges.push_back(range);
+		return range;
+	}
+	void BufferArena::free(const RangePtr& range) {
+		if (range == nullptr || range->pool < 0)
+			return;		// Already freed by another copy of the [ Render ]
+
+		auto& pool = pools.at(range->pool);
+		pool.vertexList.free(range->vertexOffset, range->vertexNum);
+		pool.indexList.free(range->indexOffset, range->indexNum);
+		pool.ranges.erase(std::remove(pool.ranges.begin(), pool.ranges.end(), range), pool.ranges.end());
+
+		int id = range->pool;
+		range->pool = -1;
+
+		// Compact only when the free memory is both scattered and large enough to matter.
+		bool vertexFragmented = pool.vertexList.fragmentation() > compactThreshold &&
+			pool.vertexList.getFreeSize() * 8 > pool.vertexList.getCapacity();
+		bool indexFragmented = pool.indexList.fragmentation() > compactThreshold &&
+			pool.indexList.getFreeSize() * 8 > pool.indexList.getCapacity();
+		if (vertexFragmented || indexFragmented)
+			compact(id);
+	}
+	bool BufferArena::reserve(Pool& pool, size_t vertexNum, size_t indexNum) {
+		auto grown = [](const FreeList& list, size_t num) -> size_t {
+			if (list.getLargestFreeBlock() >= num)
+				return list.getCapacity();
+			return std::max(list.getCapacity() * 2, list.getCapacity() + num);
+		};
+		const size_t vertexCapacity = grown(pool.vertexList, vertexNum);
+		const size_t indexCapacity = grown(pool.indexList, indexNum);
+		if ((vertexCapacity > pool.vertexList.getCapacity() && vertexCapacity > ARENA_MAX_POOL_VERTEX_NUM) ||
+			(indexCapacity > pool.indexList.getCapacity() && indexCapacity > ARENA_MAX_POOL_INDEX_NUM))
+			return false;
+		growList(pool, true, vertexCapacity);
+		growList(pool, false, indexCapacity);
+		return true;
+	}
+	void BufferArena::growList(Pool& pool, bool vertex, size_t capacity) {
+		auto& list = vertex ? pool.vertexList : pool.indexList;
+		if (capacity <= list.getCapacity())
+			return;
+		const size_t unitSize = vertex ? pool.vertexSize : sizeof(GLuint);
+		const uint buffer = vertex ? pool.vbo : pool.ebo;
+		const size_t oldSize = unitSize * list.getCapacity();
+
+		// New storage for the same buffer name, so VAO keeps it. Contents go through a scratch buffer.
+		uint scratch;
+		glGenBuffers(1, &scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, oldSize, NULL, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		glBufferData(GL_COPY_READ_BUFFER, unitSize * capacity, NULL, GL_STATIC_DRAW);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &scratch);
+
+		list.grow(capacity);
+		ResidencyManager::global().setBufferBytes(buffer, unitSize * capacity);
+	}
+	void BufferArena::compactList(Pool& pool, bool vertex) {
+		const size_t unitSize = vertex ? pool.vertexSize : sizeof(GLuint);
+		const uint buffer = vertex ? pool.vbo : pool.ebo;
+		auto& list = vertex ? pool.vertexList : pool.indexList;
+		auto offsetOf = [vertex](const RangePtr& r) -> size_t& { return vertex ? r->vertexOffset : r->indexOffset; };
+		auto sizeOf = [vertex](const RangePtr& r) { return vertex ? r->vertexNum : r->indexNum; };
+
+		std::vector<RangePtr> ranges = pool.ranges;
+		std::sort(ranges.begin(), ranges.end(), [&](const RangePtr& a, const RangePtr& b) {
+			return offsetOf(a) < offsetOf(b);
+		});
+
+		size_t used = 0;
+		for (const auto& r : ranges)
+			used += sizeOf(r);
+		if (used == 0) {
+			list.reset(0);
+			return;
+		}
+
+		// Overlapping copies inside a single buffer are not allowed, so pack into a scratch buffer first.
+		uint scratch;
+		glGenBuffers(1, &scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+		glBufferData(GL_COPY_WRITE_BUFFER, unitSize * used, NULL, GL_STREAM_COPY);
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+		size_t cursor = 0;
+		for (const auto& r : ranges) {
+			size_t& offset = offsetOf(r);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, unitSize * offset, unitSize * cursor, unitSize * sizeOf(r));
+			offset = cursor;
+			cursor += sizeOf(r);
+		}
+
+		glBindBuffer(GL_COPY_READ_BUFFER, scratch);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, unitSize * used);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		glDeleteBuffers(1, &scratch);
+
+		list.reset(used);
+	}
+	void BufferArena::compact(int id) {
+		auto& pool = pools.at(id);
+		compactList(pool, true);
+		compactList(pool, false);
+	}
+	void BufferArena::read(const RangePtr& range, void* vertices, uint* indices) const {
+		const auto& pool = pools.at(range->pool);
+		glBindBuffer(GL_COPY_READ_BUFFER, pool.vbo);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, pool.vertexSize * range->vertexOffset, pool.vertexSize * range->vertexNum, vertices);
+		glBindBuffer(GL_COPY_READ_BUFFER, pool.ebo);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, sizeof(GLuint) * range->indexOffset, sizeof(GLuint) * range->indexNum, indices);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	void BufferArena::destroy() {
+		for (auto& pool : pools) {
+			for (auto& range : pool.ranges)
+				range->pool = -1;
+			glDeleteVertexArrays(1, &pool.vao);
+			glDeleteBuffers(1, &pool.vbo);
+			glDeleteBuffers(1, &pool.ebo);
+			ResidencyManager::global().eraseBuffer(pool.vbo);
+			ResidencyManager::global().eraseBuffer(pool.ebo);
+		}
+		pools.clear();
+	}
+
+	// StreamBuffer
+	bool StreamBuffer::persistentSupported() {
+		static const bool support = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+		return support;
+	}
+	StreamBuffer StreamBuffer::create(size_t segmentSize) {
+		StreamBuffer stream;
+		stream.segmentSize = segmentSize;
+		stream.persistent = persistentSupported();
+
+		const size_t size = segmentSize * STREAM_SEGMENT_NUM;
+		glGenBuffers(1, &stream.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+		if (stream.persistent) {
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+			stream.mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+			if (stream.mapped == nullptr)
+				throw(std::runtime_error("[STREAM BUFFER ERROR] : Persistent mapping failed"));
+		}
+		else
+			glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		ResidencyManager::global().setBufferBytes(stream.buffer, size);
+		return stream;
+	}
+	void StreamBuffer::destroy() {
+		for (auto& fence : fences) {
+			if (fence != nullptr)
+				glDeleteSync((GLsync)fence);
+			fence = nullptr;
+		}
+		if (persistent && mapped != nullptr) {
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+		ResidencyManager::global().eraseBuffer(buffer);
+		buffer = 0;
+		mapped = nullptr;
+	}
+	void StreamBuffer::waitFence(int id) {
+		if (fences[id] == nullptr)
+			return;
+		GLsync fence = (GLsync)fences[id];
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			stallNum++;
+			do {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);	// 1ms
+			} while (result == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		fences[id] = nullptr;
+	}
+	void StreamBuffer::nextFrame() {
+		if (cursor > 0) {
+			if (fences[segment] != nullptr)
+				glDeleteSync((GLsync)fences[segment]);
+			fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		segment = (segment + 1) % STREAM_SEGMENT_NUM;
+		cursor = 0;
+
+		// Placed [ STREAM_SEGMENT_NUM ] frames ago, so it is usually signaled already.
+		waitFence(segment);
+	}
+	void* StreamBuffer::map(size_t size, size_t alignment, size_t& offset) {
+		size_t begin = cursor;
+		if (alignment > 1)
+			begin = (begin + alignment - 1) / alignment * alignment;
+		if (begin + size > segmentSize)
+			return nullptr;
+		cursor = begin + size;
+		offset = segmentSize * segment + begin;
+
+		if (persistent)
+			return mapped + offset;
+
+		// The segment is not in use by the GPU ( fenced ), so synchronization can be skipped.
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return mapped;
+	}
+	void StreamBuffer::unmap() {
+		if (persistent)
+			return;		// Coherent mapping, writes are visible to following draw calls
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		mapped = nullptr;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,182 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_BUFFER_H__
+#define __ME_BUFFER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+#define ARENA_DEF_POOL_VERTEX_NUM	(1 << 14)	// 1MB with [ Render::Vertex ], pools start at this size
+#define ARENA_DEF_POOL_INDEX_NUM	(1 << 16)	// 256KB
+#define ARENA_MAX_POOL_VERTEX_NUM	(1 << 20)	// 64MB, pools double until this size, then a new pool is made
+#define ARENA_MAX_POOL_INDEX_NUM	(1 << 22)	// 16MB
+#define ARENA_DEF_COMPACT_THRESHOLD	0.5f
+
+#define STREAM_SEGMENT_NUM			3		// Triple buffering : CPU writes one segment while GPU reads the other two
+
+namespace ME {
+	// Free-list sub-allocator that hands out [ offset, offset + size ) ranges of a fixed capacity.
+	// Sizes and offsets are given in units (vertices, indices), not in bytes.
+	class FreeList {
+	private:
+		std::map<size_t, size_t> freeBlocks;	// Offset -> size, sorted by offset so neighbors can be merged
+		size_t capacity = 0;
+		size_t freeSize = 0;
+	public:
+		static FreeList create(size_t capacity);
+
+		// Best-fit allocation. Return false if there is no free block large enough.
+		bool allocate(size_t size, size_t& offset);
+		void free(size_t offset, size_t size);
+
+		// Mark [ 0, used ) as allocated and the rest as a single free block ( after compaction ).
+		void reset(size_t used);
+		// Extend capacity to [ capacity ], the new part being free
+		void grow(size_t capacity);
+
+		inline size_t getCapacity() const noexcept {
+			return capacity;
+		}
+		inline size_t getFreeSize() const noexcept {
+			return freeSize;
+		}
+		size_t getLargestFreeBlock() const noexcept;
+
+		// 0.0 : All free memory is contiguous
+		// 1.0 : Free memory is scattered into tiny blocks
+		float fragmentation() const noexcept;
+	};
+
+	// Engine-wide vertex / index memory. Geometry of every [ Render ] lives in a few pools, and renders of
+	// one vertex format share the pool's VAO, VBO and EBO. Pools start small and double when they are full,
+	// keeping their buffer names so that VAOs and draws that refer to them stay valid.
+	class BufferArena {
+	public:
+		// Part of a pool owned by a single [ Render ]. Offsets are updated in place by compaction,
+		// so every copy of the [ Render ] sees the new location.
+		struct Range {
+			int pool = -1;				// -1 if freed
+			size_t vertexOffset = 0;	// Used as base vertex
+			size_t vertexNum = 0;
+			size_t indexOffset = 0;		// Used as first index
+			size_t indexNum = 0;
+		};
+		using RangePtr = std::shared_ptr<Range>;
+
+		struct Pool {
+			uint vao = 0;
+			uint vbo = 0;
+			uint ebo = 0;
+			size_t vertexSize = 0;		// Vertex format ( stride in bytes )
+			FreeList vertexList;
+			FreeList indexList;
+			std::vector<RangePtr> ranges;
+		};
+	private:
+		std::vector<Pool> pools;
+		float compactThreshold = ARENA_DEF_COMPACT_THRESHOLD;
+
+		BufferArena() = default;
+
+		int createPool(size_t vertexSize, size_t vertexNum, size_t indexNum);
+		void compactList(Pool& pool, bool vertex);
+		// Grow [ pool ] so that [ vertexNum ] vertices and [ indexNum ] indices fit in it.
+		// Return false if it would grow past ARENA_MAX_POOL_*.
+		bool reserve(Pool& pool, size_t vertexNum, size_t indexNum);
+		void growList(Pool& pool, bool vertex, size_t capacity);
+	public:
+		static BufferArena& global();
+
+		// Copy given geometry into a pool of matching vertex format.
+		// @indices : Local to [ vertices ], i.e. starts from 0.
+		RangePtr allocate(const void* vertices, size_t vertexSize, size_t vertexNum, const uint* indices, size_t indexNum);
+		void free(const RangePtr& range);
+
+		// Move live ranges to the front of their pool so free memory becomes one block.
+		void compact(int pool);
+
+		// Copy geometry of [ range ] back to CPU. Indices are local to the range, i.e. start from 0.
+		// @vertices : At least [ range->vertexNum ] vertices of the pool's format
+		// @indices : At least [ range->indexNum ] indices
+		void read(const RangePtr& range, void* vertices, uint* indices) const;
+
+		inline const Pool& getPool(int id) const {
+			return pools.at(id);
+		}
+		inline int poolNum() const noexcept {
+			return (int)pools.size();
+		}
+		inline void setCompactThreshold(float threshold) noexcept {
+			compactThreshold = threshold;
+		}
+		inline float getCompactThreshold() const noexcept {
+			return compactThreshold;
+		}
+
+		void destroy();
+	};
+
+	// Ring buffer for geometry that changes every frame. The buffer is split into [ STREAM_SEGMENT_NUM ]
+	// segments, and each frame writes into its own segment while the GPU may still read the older ones.
+	// A fence is placed on a segment when the frame using it ends, and is only waited on when the ring
+	// comes back to that segment, so there is no stall unless the GPU is more than two frames behind.
+	class StreamBuffer {
+	private:
+		uint buffer = 0;
+		size_t segmentSize = 0;		// In bytes
+		int segment = 0;			// Segment of the current frame
+		size_t cursor = 0;			// Write position in the current segment
+		bool persistent = false;	// glBufferStorage() with persistent, coherent mapping
+		char* mapped = nullptr;		// Whole buffer in persistent mode, current write otherwise
+		void* fences[STREAM_SEGMENT_NUM] = { nullptr };
+		size_t stallNum = 0;
+
+		void waitFence(int id);
+	public:
+		// True if context supports persistent mapping. Otherwise unsynchronized glMapBufferRange() is used.
+		static bool persistentSupported();
+
+		// @segmentSize : Bytes that can be written in a single frame
+		static StreamBuffer create(size_t segmentSize);
+		void destroy();
+
+		// Finish writing of the current frame : fence its segment and move to the next one.
+		// Call once per frame, after draw calls that read this frame's data are issued.
+		void nextFrame();
+
+		// Reserve [ size ] bytes in the current segment, aligned to [ alignment ].
+		// @offset : Byte offset of the reserved memory in the whole buffer, to be used in draw calls.
+		// Return nullptr if the segment does not have enough room.
+		void* map(size_t size, size_t alignment, size_t& offset);
+		// Must be called after writing to the pointer returned by [ map() ].
+		void unmap();
+
+		inline uint getBuffer() const noexcept {
+			return buffer;
+		}
+		inline size_t getSegmentSize() const noexcept {
+			return segmentSize;
+		}
+		inline bool isPersistent() const noexcept {
+			return persistent;
+		}
+		// Number of times [ nextFrame() ] had to wait for the GPU
+		inline size_t getStallNum() const noexcept {
+			return stallNum;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
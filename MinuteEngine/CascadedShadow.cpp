@@ -0,0 +1,108 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "CascadedShadow.h"
+#include "Camera.h"
+#include "Residency.h"
+#include "glm/geometric.hpp"
+#include "glm/matrix.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+
+namespace ME {
+	static uint revisionNum = 0;		// Last revision given to any [ CascadedShadow ]
+
+	CascadedShadow CascadedShadow::create(int cascadeNum, uint mapSize) {
+		CascadedShadow csm;
+		csm.cascadeNum = std::max(1, std::min(cascadeNum, CSM_MAX_CASCADE_NUM));
+		csm.mapSize = mapSize;
+		csm.revision = ++revisionNum;
+
+		glGenFramebuffers(1, &csm.fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, csm.fbo);
+
+		glGenTextures(1, &csm.depthMap);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, csm.depthMap);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, csm.cascadeNum, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		ResidencyManager::global().setTargetBytes(csm.depthMap, (size_t)mapSize * mapSize * csm.cascadeNum * 4);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);	// Bilinear PCF by shadow samplers
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, csm.depthMap, 0, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);	// Since we do not use color buffer, just set these to GL_NONE
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		return csm;
+	}
+	void CascadedShadow::destroy() {
+		ResidencyManager::global().eraseTarget(depthMap);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &depthMap);
+		fbo = 0;
+		depthMap = 0;
+	}
+	void CascadedShadow::update(const Camera& camera, const glm::vec3& lightDirection) {
+		const float nPlane = camera.getNPlane();
+		const float fPlane = std::min(camera.getFPlane(), maxDistance);
+		const float aspect = camera.getWindowWidth() / (float)camera.getWindowHeight();
+		const float tanY = std::tan(glm::radians(camera.getFovy()) * 0.5f);
+		const float tanX = tanY * aspect;
+		const glm::mat4 invViewMat = glm::inverse(camera.getViewMatC());
+
+		// Light view with origin at world origin, cascades are placed by offsetting its ortho box.
+		const glm::vec3 dir = glm::normalize(lightDirection);
+		const glm::vec3 up = (std::abs(dir.y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0));
+		const glm::mat4 lightViewMat = glm::lookAt(glm::vec3(0.0f), dir, up);
+
+		float begin = nPlane;
+		for (int i = 0; i < cascadeNum; i++) {
+			// Practical split scheme : blend of logarithmic and uniform splits
+			float ratio = (i + 1) / (float)cascadeNum;
+			float logSplit = nPlane * std::pow(fPlane / nPlane, ratio);
+			float uniSplit = nPlane + (fPlane - nPlane) * ratio;
+			float end = splitLambda * logSplit + (1.0f - splitLambda) * uniSplit;
+			splits[i] = end;
+
+			// Bounding sphere of the frustum slice [ begin, end ], in view space it lies on -z axis.
+			// Center is chosen to minimize radius : z = ( n + f ) / 2 * ( 1 + k ), k = tan^2 of the corner angle.
+			float k = tanX * tanX + tanY * tanY;
+			float centerZ = std::min(0.5f * (begin + end) * (1.0f + k), end);
+			float radiusNear = std::sqrt((begin * begin) * k + (centerZ - begin) * (centerZ - begin));
+			float radiusFar = std::sqrt((end * end) * k + (end - centerZ) * (end - centerZ));
+			float radius = std::max(radiusNear, radiusFar);
+			radius = std::ceil(radius * 16.0f) / 16.0f;		// Quantize so that it is stable against float noise
+
+			glm::vec3 center = glm::vec3(invViewMat * glm::vec4(0.0f, 0.0f, -centerZ, 1.0f));
+
+			// Snap center to the texel grid of the shadow map in light space.
+			glm::vec3 lightCenter = glm::vec3(lightViewMat * glm::vec4(center, 1.0f));
+			float texelSize = 2.0f * radius / (float)mapSize;
+			lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+			lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+			// Casters behind the slice ( toward the light ) must be inside of the box too.
+			glm::mat4 projMat = glm::ortho(
+				lightCenter.x - radius, lightCenter.x + radius,
+				lightCenter.y - radius, lightCenter.y + radius,
+				-lightCenter.z - radius - maxDistance, -lightCenter.z + radius);
+			shadowMats[i] = projMat * lightViewMat;
+
+			begin = end;
+		}
+	}
+}
\ No newline at end of file
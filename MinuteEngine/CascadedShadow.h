@@ -0,0 +1,103 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_CASCADED_SHADOW_H__
+#define __ME_CASCADED_SHADOW_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
+
+#define CSM_MAX_CASCADE_NUM		4
+#define CSM_DEF_MAP_SIZE		2048
+#define CSM_DEF_MAX_DISTANCE	100.0f		// Shadows are drawn up to this distance from camera
+#define CSM_DEF_SPLIT_LAMBDA	0.75f		// 0.0 : Uniform splits, 1.0 : Logarithmic splits
+#define CSM_DEF_BLEND_RATIO		0.1f		// Last part of each cascade that is blended into the next one
+
+namespace ME {
+	class Camera;
+
+	// Shadow of a directional light, made of several orthographic maps that cover consecutive slices
+	// of camera frustum. Each slice is fitted with its bounding sphere, so the size of a map in world
+	// space does not change while camera rotates, and is snapped to the texel grid to prevent shimmering.
+	class CascadedShadow {
+	private:
+		bool valid = false;
+		int cascadeNum = CSM_MAX_CASCADE_NUM;
+		float maxDistance = CSM_DEF_MAX_DISTANCE;
+		float splitLambda = CSM_DEF_SPLIT_LAMBDA;
+		float blendRatio = CSM_DEF_BLEND_RATIO;
+
+		uint fbo = 0;
+		uint depthMap = 0;				// 2D array texture, a layer per cascade
+		uint mapSize = CSM_DEF_MAP_SIZE;
+		uint revision = 0;				// Unique to each allocation of [ depthMap ], so that caches never mistake a new map for an old one
+
+		float splits[CSM_MAX_CASCADE_NUM] = { 0.0f };		// View space far distance of each cascade
+		glm::mat4 shadowMats[CSM_MAX_CASCADE_NUM];			// Light space projection * view of each cascade
+	public:
+		static CascadedShadow create(int cascadeNum = CSM_MAX_CASCADE_NUM, uint mapSize = CSM_DEF_MAP_SIZE);
+		void destroy();
+
+		// Split frustum of [ camera ] and fit a shadow map to each slice.
+		void update(const Camera& camera, const glm::vec3& lightDirection);
+
+		inline uint getFBO() const noexcept {
+			return fbo;
+		}
+		inline uint getDepthMap() const noexcept {
+			return depthMap;
+		}
+		inline uint getMapSize() const noexcept {
+			return mapSize;
+		}
+		inline uint getRevision() const noexcept {
+			return revision;
+		}
+		inline int getCascadeNum() const noexcept {
+			return cascadeNum;
+		}
+		inline float getSplit(int cascade) const {
+			return splits[cascade];
+		}
+		inline const glm::mat4& getShadowMat(int cascade) const {
+			return shadowMats[cascade];
+		}
+		inline bool getValid() const noexcept {
+			return valid;
+		}
+		inline float getMaxDistance() const noexcept {
+			return maxDistance;
+		}
+		inline float getSplitLambda() const noexcept {
+			return splitLambda;
+		}
+		inline float getBlendRatio() const noexcept {
+			return blendRatio;
+		}
+
+		inline void setValid(bool valid) noexcept {
+			this->valid = valid;
+		}
+		inline void setMaxDistance(float distance) noexcept {
+			maxDistance = distance;
+		}
+		inline void setSplitLambda(float lambda) noexcept {
+			splitLambda = lambda;
+		}
+		inline void setBlendRatio(float ratio) noexcept {
+			blendRatio = ratio;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
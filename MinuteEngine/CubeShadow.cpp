@@ -0,0 +1,71 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "CubeShadow.h"
+#include "Residency.h"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+
+namespace ME {
+	bool CubeShadow::supported() {
+		return GLEW_VERSION_3_2;
+	}
+	static uint revisionNum = 0;		// Last revision given to any [ CubeShadow ]
+
+	CubeShadow CubeShadow::create(uint mapSize) {
+		CubeShadow cs;
+		cs.mapSize = mapSize;
+		cs.revision = ++revisionNum;
+
+		glGenTextures(1, &cs.depthMap);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, cs.depthMap);
+		for (int i = 0; i < CUBE_SHADOW_FACE_NUM; i++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT24, mapSize, mapSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		ResidencyManager::global().setTargetBytes(cs.depthMap, (size_t)mapSize * mapSize * CUBE_SHADOW_FACE_NUM * 4);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);	// Bilinear PCF by shadow samplers
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+		glGenFramebuffers(1, &cs.fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, cs.fbo);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cs.depthMap, 0);	// Layered, face is chosen by gl_Layer
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);	// Since we do not use color buffer, just set these to GL_NONE
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		return cs;
+	}
+	void CubeShadow::destroy() {
+		ResidencyManager::global().eraseTarget(depthMap);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &depthMap);
+		fbo = 0;
+		depthMap = 0;
+	}
+	void CubeShadow::update(const glm::vec3& position) {
+		// Directions and up vectors of [ GL_TEXTURE_CUBE_MAP_POSITIVE_X ] ... [ GL_TEXTURE_CUBE_MAP_NEGATIVE_Z ]
+		static const glm::vec3 dirs[CUBE_SHADOW_FACE_NUM] = {
+			{ 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+		};
+		static const glm::vec3 ups[CUBE_SHADOW_FACE_NUM] = {
+			{ 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 }
+		};
+
+		this->position = position;
+		const glm::mat4 projMat = glm::perspective(glm::radians(90.0f), 1.0f, nPlane, fPlane);
+		for (int i = 0; i < CUBE_SHADOW_FACE_NUM; i++)
+			faceMats[i] = projMat * glm::lookAt(position, position + dirs[i], ups[i]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_CUBE_SHADOW_H__
+#define __ME_CUBE_SHADOW_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
+
+#define CUBE_SHADOW_FACE_NUM		6
+#define CUBE_SHADOW_DEF_MAP_SIZE	1024
+#define CUBE_SHADOW_DEF_NEAR		0.1f
+#define CUBE_SHADOW_DEF_FAR			25.0f		// Casters and receivers farther than this from the light are not shadowed
+
+namespace ME {
+	// Shadow of a point light in every direction. Depth map is a cube map that stores distance from the light
+	// divided by [ far ], and all 6 faces are rendered in a single pass by layered rendering.
+	class CubeShadow {
+	private:
+		bool valid = false;
+		uint fbo = 0;
+		uint depthMap = 0;				// Cube map texture, attached to [ fbo ] as a layered image
+		uint mapSize = CUBE_SHADOW_DEF_MAP_SIZE;
+		uint revision = 0;				// Unique to each allocation of [ depthMap ], so that caches never mistake a new map for an old one
+		float nPlane = CUBE_SHADOW_DEF_NEAR;
+		float fPlane = CUBE_SHADOW_DEF_FAR;
+
+		glm::vec3 position = glm::vec3(0.0f);
+		glm::mat4 faceMats[CUBE_SHADOW_FACE_NUM];		// Projection * view of each face, in GL cube map face order
+	public:
+		// Layered rendering needs geometry shader
+		static bool supported();
+		static CubeShadow create(uint mapSize = CUBE_SHADOW_DEF_MAP_SIZE);
+		void destroy();
+
+		// Place the cube at [ position ] of the light.
+		void update(const glm::vec3& position);
+
+		inline uint getFBO() const noexcept {
+			return fbo;
+		}
+		inline uint getDepthMap() const noexcept {
+			return depthMap;
+		}
+		inline uint getMapSize() const noexcept {
+			return mapSize;
+		}
+		inline uint getRevision() const noexcept {
+			return revision;
+		}
+		inline const glm::vec3& getPosition() const noexcept {
+			return position;
+		}
+		inline const glm::mat4& getFaceMat(int face) const {
+			return faceMats[face];
+		}
+		inline float getNPlane() const noexcept {
+			return nPlane;
+		}
+		inline float getFPlane() const noexcept {
+			return fPlane;
+		}
+		inline bool getValid() const noexcept {
+			return valid;
+		}
+
+		inline void setValid(bool valid) noexcept {
+			this->valid = valid;
+		}
+		inline void setNPlane(float n) noexcept {
+			nPlane = n;
+		}
+		inline void setFPlane(float f) noexcept {
+			fPlane = f;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "DebugDraw.h"
+#include "glm/geometric.hpp"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace ME {
+	DebugDraw DebugDraw::create(size_t maxVertexNum) {
+		DebugDraw dd;
+		dd.capacity = maxVertexNum;
+		return dd;
+	}
+	DebugDraw& DebugDraw::global() {
+		static DebugDraw dd = create();
+		return dd;
+	}
+	void DebugDraw::destroy() {
+		if (vao != 0) {
+			glDeleteVertexArrays(1, &vao);
+			stream.destroy();
+		}
+		vao = 0;
+		clear();
+		calls.clear();
+	}
+	float DebugDraw::widthSize(int width) {
+		static const float size[DEBUG_WIDTH_NUM] = { 1.0f, 2.0f, 4.0f };
+		return size[width];
+	}
+	void DebugDraw::push(int type, int width, const glm::vec3& position, const Color& color) {
+		Vertex v;
+		v.position = position;
+		v.color = color;
+		batches[type][width].push_back(v);
+	}
+	void DebugDraw::addPoint(const glm::vec3& p, const Color& color, int width) {
+		push(DEBUG_POINT_TYPE, width, p, color);
+	}
+	void DebugDraw::addLine(const glm::vec3& a, const glm::vec3& b, const Color& color, int width) {
+		push(DEBUG_LINE_TYPE, width, a, color);
+		push(DEBUG_LINE_TYPE, width, b, color);
+	}
+	void DebugDraw::addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const Color& color) {
+		// Width does not matter for filled triangles, keep them in a single batch.
+		push(DEBUG_TRI_TYPE, DEBUG_WIDTH_NORMAL, a, color);
+		push(DEBUG_TRI_TYPE, DEBUG_WIDTH_NORMAL, b, color);
+		push(DEBUG_TRI_TYPE, DEBUG_WIDTH_NORMAL, c, color);
+	}
+	void DebugDraw::addBox(const glm::vec3& min, const glm::vec3& max, const Color& color, int width) {
+		addBox(glm::mat4(1.0f), min, max, color, width);
+	}
+	void DebugDraw::addBox(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, const Color& color, int width) {
+		glm::vec3 corner[8];
+		for (int i = 0; i < 8; i++) {
+			glm::vec4 c((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, 1.0f);
+			corner[i] = glm::vec3(transform * c);
+		}
+		// Each edge connects two corners that differ in exactly one axis bit.
+		for (int i = 0; i < 8; i++)
+			for (int bit = 1; bit < 8; bit <<= 1)
+				if ((i & bit) == 0)
+					addLine(corner[i], corner[i | bit], color, width);
+	}
+	void DebugDraw::addCircle(const glm::vec3& center, const glm::vec3& normal, float radius, const Color& color, int width, int segments) {
+		glm::vec3 n = glm::normalize(normal);
+		glm::vec3 t = (std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0));
+		glm::vec3 u = glm::normalize(glm::cross(n, t));
+		glm::vec3 v = glm::cross(n, u);
+
+		const float step = 2.0f * 3.14159265f / segments;
+		glm::vec3 prev = center + radius * u;
+		for (int i = 1; i <= segments; i++) {
+			float angle = step * i;
+			glm::vec3 cur = center + radius * (std::cos(angle) * u + std::sin(angle) * v);
+			addLine(prev, cur, color, width);
+			prev = cur;
+		}
+	}
+	void DebugDraw::addSphereWire(const glm::vec3& center, float radius, const Color& color, int width, int segments) {
+		addCircle(center, { 1, 0, 0 }, radius, color, width, segments);
+		addCircle(center, { 0, 1, 0 }, radius, color, width, segments);
+		addCircle(center, { 0, 0, 1 }, radius, color, width, segments);
+	}
+	void DebugDraw::addAxes(const glm::mat4& transform, float size, int width) {
+		glm::vec3 origin(transform[3]);
+		addLine(origin, origin + size * glm::vec3(transform[0]), Color::red(), width);
+		addLine(origin, origin + size * glm::vec3(transform[1]), Color::green(), width);
+		addLine(origin, origin + size * glm::vec3(transform[2]), Color::blue(), width);
+	}
+	size_t DebugDraw::vertexNum() const noexcept {
+		size_t num = 0;
+		for (int i = 0; i < DEBUG_TYPE_NUM; i++)
+			for (int j = 0; j < DEBUG_WIDTH_NUM; j++)
+				num += batches[i][j].size();
+		return num;
+	}
+	void DebugDraw::flush() {
+		const auto vertMemSize = Vertex::memSize();
+		const size_t num = vertexNum();
+		calls.clear();
+
+		// 1. Ready GL objects, grow stream buffer if this frame does not fit
+		if (vao == 0 || num > capacity) {
+			if (vao != 0)
+				stream.destroy();
+			else
+				glGenVertexArrays(1, &vao);
+			capacity = std::max(num, capacity);
+			stream = StreamBuffer::create(vertMemSize * capacity);
+		}
+		else
+			stream.nextFrame();
+		if (num == 0)
+			return;
+
+		// 2. Copy every batch into one range of the stream buffer
+		size_t offset;
+		char* data = (char*)stream.map(vertMemSize * num, vertMemSize, offset);
+		size_t first = offset / vertMemSize;
+		for (int i = 0; i < DEBUG_TYPE_NUM; i++) {
+			for (int j = 0; j < DEBUG_WIDTH_NUM; j++) {
+				auto& batch = batches[i][j];
+				if (batch.empty())
+					continue;
+				memcpy(data, batch.data(), vertMemSize * batch.size());
+				data += vertMemSize * batch.size();
+
+				Call call;
+				call.type = i;
+				call.width = j;
+				call.first = first;
+				call.count = batch.size();
+				calls.push_back(call);
+
+				first += batch.size();
+				batch.clear();
+			}
+		}
+		stream.unmap();
+	}
+	void DebugDraw::clear() {
+		for (int i = 0; i < DEBUG_TYPE_NUM; i++)
+			for (int j = 0; j < DEBUG_WIDTH_NUM; j++)
+				batches[i][j].clear();
+	}
+}
\ No newline at end of file
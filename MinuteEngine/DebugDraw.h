@@ -0,0 +1,115 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_DEBUG_DRAW_H__
+#define __ME_DEBUG_DRAW_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "Color.h"
+#include "Buffer.h"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/mat4x4.hpp"
+#include <vector>
+
+#define DEBUG_POINT_TYPE		0
+#define DEBUG_LINE_TYPE			1
+#define DEBUG_TRI_TYPE			2
+#define DEBUG_TYPE_NUM			3
+
+#define DEBUG_WIDTH_THIN		0
+#define DEBUG_WIDTH_NORMAL		1
+#define DEBUG_WIDTH_THICK		2
+#define DEBUG_WIDTH_NUM			3
+
+#define DEBUG_DEF_MAX_VERTEX_NUM	(1 << 18)	// Initial capacity of a frame, grows if needed
+
+namespace ME {
+	// Immediate-mode builder for points, lines and triangles used in debugging ( normals, bounds, paths ).
+	// Primitives are accumulated on CPU during a frame, uploaded at once through a [ StreamBuffer ],
+	// and drawn with a single call per ( primitive type, width class ).
+	class DebugDraw {
+	public:
+		struct Vertex {
+			glm::vec3 position;
+			glm::vec4 color;
+
+			static inline auto memSize() {
+				static const auto size = sizeof(position) + sizeof(color);
+				return size;
+			}
+			static inline auto positionOffset() {
+				return 0;
+			}
+			static inline auto colorOffset() {
+				static const auto size = sizeof(position);
+				return size;
+			}
+		};
+		// Draw call made by [ flush() ], for the vertices of a single batch.
+		struct Call {
+			int type = DEBUG_POINT_TYPE;
+			int width = DEBUG_WIDTH_NORMAL;
+			size_t first = 0;		// First vertex in the stream buffer
+			size_t count = 0;
+		};
+	private:
+		std::vector<Vertex> batches[DEBUG_TYPE_NUM][DEBUG_WIDTH_NUM];
+		std::vector<Call> calls;
+
+		uint vao = 0;
+		StreamBuffer stream;
+		size_t capacity = 0;	// Max vertex number of a frame
+
+		void push(int type, int width, const glm::vec3& position, const Color& color);
+	public:
+		// GL objects are made lazily on the first [ flush() ].
+		static DebugDraw create(size_t maxVertexNum = DEBUG_DEF_MAX_VERTEX_NUM);
+		static DebugDraw& global();
+		void destroy();
+
+		// Point size and line width of each width class, in pixels
+		static float widthSize(int width);
+
+		void addPoint(const glm::vec3& p, const Color& color, int width = DEBUG_WIDTH_NORMAL);
+		void addLine(const glm::vec3& a, const glm::vec3& b, const Color& color, int width = DEBUG_WIDTH_NORMAL);
+		void addTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const Color& color);
+		void addBox(const glm::vec3& min, const glm::vec3& max, const Color& color, int width = DEBUG_WIDTH_NORMAL);
+		// Box of [ min, max ] in local space of [ transform ]
+		void addBox(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max, const Color& color, int width = DEBUG_WIDTH_NORMAL);
+		void addCircle(const glm::vec3& center, const glm::vec3& normal, float radius, const Color& color, int width = DEBUG_WIDTH_NORMAL, int segments = 32);
+		// Three great circles on the planes of the axes
+		void addSphereWire(const glm::vec3& center, float radius, const Color& color, int width = DEBUG_WIDTH_NORMAL, int segments = 32);
+		// X, Y, Z axes of [ transform ] in red, green, blue
+		void addAxes(const glm::mat4& transform, float size, int width = DEBUG_WIDTH_NORMAL);
+
+		// Number of vertices accumulated since the last [ flush() ]
+		size_t vertexNum() const noexcept;
+
+		// Upload accumulated primitives of this frame, build [ calls ], and clear the batches.
+		void flush();
+		// Discard accumulated primitives without drawing them
+		void clear();
+
+		inline uint getVAO() const noexcept {
+			return vao;
+		}
+		inline const StreamBuffer& getStreamC() const noexcept {
+			return stream;
+		}
+		inline const std::vector<Call>& getCallsC() const noexcept {
+			return calls;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "GBuffer.h"
+#include "Residency.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <stdexcept>
+
+namespace ME {
+	// Texture of [ width ] x [ height ] that is read by texelFetch() only
+	// @texelBytes : Size of a texel of [ internalFormat ]
+	static uint createTarget(int width, int height, GLenum internalFormat, GLenum format, GLenum type, size_t texelBytes) {
+		uint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+		ResidencyManager::global().setTargetBytes(texture, (size_t)width * height * texelBytes);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return texture;
+	}
+
+	GBuffer GBuffer::create(int width, int height) {
+		GBuffer gbuffer;
+		gbuffer.width = width;
+		gbuffer.height = height;
+		glGenFramebuffers(1, &gbuffer.fbo);
+		gbuffer.createTargets();
+		gbuffer.valid = true;
+		return gbuffer;
+	}
+	void GBuffer::destroy() {
+		destroyTargets();
+		glDeleteFramebuffers(1, &fbo);
+		fbo = 0;
+		valid = false;
+	}
+	void GBuffer::createTargets() {
+		targets[GBUFFER_EMISSION] = createTarget(width, height, GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, 4);
+		targets[GBUFFER_DIFFUSE] = createTarget(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+		targets[GBUFFER_SPECULAR] = createTarget(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+		targets[GBUFFER_AMBIENT] = createTarget(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+		targets[GBUFFER_NORMAL] = createTarget(width, height, GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 4);
+		depthMap = createTarget(width, height, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, 4);	// 24 bit depth takes 4 bytes
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		GLenum drawBuffers[GBUFFER_TARGET_NUM];
+		for (int i = 0; i < GBUFFER_TARGET_NUM; i++) {
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets[i], 0);
+			drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+		}
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+		glDrawBuffers(GBUFFER_TARGET_NUM, drawBuffers);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+			throw(std::runtime_error("[GBUFFER ERROR] : Framebuffer is not complete"));
+	}
+	void GBuffer::destroyTargets() {
+		for (auto target : targets)
+			ResidencyManager::global().eraseTarget(target);
+		ResidencyManager::global().eraseTarget(depthMap);
+		glDeleteTextures(GBUFFER_TARGET_NUM, targets);
+		glDeleteTextures(1, &depthMap);
+		for (auto& target : targets)
+			target = 0;
+		depthMap = 0;
+	}
+	void GBuffer::resize(int width, int height) {
+		if (this->width == width && this->height == height)
+			return;
+		this->width = width;
+		this->height = height;
+		destroyTargets();
+		createTargets();
+	}
+	void GBuffer::bind(uint firstUnitID) const {
+		for (int i = 0; i < GBUFFER_TARGET_NUM; i++) {
+			glActiveTexture(GL_TEXTURE0 + firstUnitID + i);
+			glBindTexture(GL_TEXTURE_2D, targets[i]);
+		}
+		glActiveTexture(GL_TEXTURE0 + firstUnitID + GBUFFER_TARGET_NUM);
+		glBindTexture(GL_TEXTURE_2D, depthMap);
+	}
+}
\ No newline at end of file
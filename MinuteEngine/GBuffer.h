@@ -0,0 +1,69 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_GBUFFER_H__
+#define __ME_GBUFFER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+
+#define GBUFFER_EMISSION		0		// R11F_G11F_B10F : Color added without lighting ( emission, unlit surfaces )
+#define GBUFFER_DIFFUSE			1		// RGBA8 : Diffuse color, encoded shininess
+#define GBUFFER_SPECULAR		2		// RGBA8 : Specular color, 1 if lit
+#define GBUFFER_AMBIENT			3		// RGBA8 : Ambient color
+#define GBUFFER_NORMAL			4		// RG16 : View space normal in octahedral encoding
+#define GBUFFER_TARGET_NUM		5
+
+namespace ME {
+	// Render targets of deferred shading. Geometry pass writes surface attributes of the nearest surface
+	// into color targets and depth, and lighting pass reads them back per pixel.
+	class GBuffer {
+	private:
+		bool valid = false;
+		int width = 0;
+		int height = 0;
+		uint fbo = 0;
+		uint targets[GBUFFER_TARGET_NUM] = { 0 };
+		uint depthMap = 0;
+
+		void createTargets();
+		void destroyTargets();
+	public:
+		static GBuffer create(int width, int height);
+		void destroy();
+
+		// Recreate targets if size is different from [ width ] x [ height ]
+		void resize(int width, int height);
+		// Bind each target to texture unit [ firstUnitID + target ], and depth to the next one
+		void bind(uint firstUnitID) const;
+
+		inline bool getValid() const noexcept {
+			return valid;
+		}
+		inline int getWidth() const noexcept {
+			return width;
+		}
+		inline int getHeight() const noexcept {
+			return height;
+		}
+		inline uint getFBO() const noexcept {
+			return fbo;
+		}
+		inline uint getTarget(int target) const {
+			return targets[target];
+		}
+		inline uint getDepthMap() const noexcept {
+			return depthMap;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
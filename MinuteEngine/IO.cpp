@@ -8,11 +8,308 @@
 
 #include "IO.h"
 
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // For image loading : https://learnopengl.com/Getting-started/Textures
 //#define STB_IMAGE_IMPLEMENTATION
 //#include "../Dependencies/stb/stb_image.h"
 
 namespace ME {
+    // View
+    bool IO::str_equal(const View& view, const char* str) {
+        const size_t
+            len = std::strlen(str);
+        return view.size == len && std::memcmp(view.data, str, len) == 0;
+    }
+    bool IO::next_line(View& text, View& line) {
+        if (text.data == nullptr || text.size == 0)
+            return false;
+        const char*
+            end = (const char*)std::memchr(text.data, '\n', text.size);
+        size_t
+            size = (end == nullptr ? text.size : (size_t)(end - text.data)),
+            next = (end == nullptr ? size : size + 1);
+        line.data = text.data;
+        line.size = (size > 0 && text.data[size - 1] == '\r' ? size - 1 : size);
+        text.data += next;
+        text.size -= next;
+        return true;
+    }
+    bool IO::next_token(View& text, View& token) {
+        size_t
+            i = 0;
+        while (i < text.size && (text.data[i] == ' ' || text.data[i] == '\t' || text.data[i] == '\r' || text.data[i] == '\n'))
+            i++;
+        if (i == text.size) {
+            text.data += i;
+            text.size = 0;
+            return false;
+        }
+        size_t
+            j = i;
+        while (j < text.size && text.data[j] != ' ' && text.data[j] != '\t' && text.data[j] != '\r' && text.data[j] != '\n')
+            j++;
+        token.data = text.data + i;
+        token.size = j - i;
+        text.data += j;
+        text.size -= j;
+        return true;
+    }
+
+    // Mapping
+    static size_t mapGranularity() {
+#ifdef _WIN32
+        // Views must start at a multiple of allocation granularity, not page size
+        SYSTEM_INFO
+            info;
+        GetSystemInfo(&info);
+        return (size_t)info.dwAllocationGranularity;
+#else
+        return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    // MappedFile
+    IO::MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+    IO::MappedFile& IO::MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data, other.data);
+            std::swap(size, other.size);
+#ifdef _WIN32
+            std::swap(file, other.file);
+            std::swap(mapping, other.mapping);
+#else
+            std::swap(fd, other.fd);
+#endif
+        }
+        return *this;
+    }
+    IO::MappedFile::~MappedFile() {
+        close();
+    }
+    bool IO::MappedFile::open(const std::string& path, int advice) {
+        close();
+#ifdef _WIN32
+        HANDLE
+            f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 
+                (advice == IO_ADVICE_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : (advice == IO_ADVICE_RANDOM ? FILE_FLAG_RANDOM_ACCESS : 0)), nullptr);
+        if (f == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER
+            fileSize;
+        if (!GetFileSizeEx(f, &fileSize)) {
+            CloseHandle(f);
+            return false;
+        }
+        file = f;
+        size = (size_t)fileSize.QuadPart;
+        if (size == 0)
+            return true;        // Cannot map an empty file, but it is a valid one
+        mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr)
+            data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat
+            st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            close();
+            return false;
+        }
+        size = (size_t)st.st_size;
+        if (size == 0)
+            return true;
+        void*
+            ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED)
+            data = (const char*)ptr;
+#endif
+        if (data == nullptr) {
+            close();
+            return false;
+        }
+        advise(advice);
+        return true;
+    }
+    void IO::MappedFile::close() {
+#ifdef _WIN32
+        if (data != nullptr)
+            UnmapViewOfFile(data);
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != nullptr)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = nullptr;
+#else
+        if (data != nullptr)
+            munmap((void*)data, size);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+    void IO::MappedFile::advise(int advice) const {
+        if (data == nullptr)
+            return;
+#ifdef _WIN32
+        // Windows takes the pattern when the file is opened
+        (void)advice;
+#else
+        madvise((void*)data, size, 
+            advice == IO_ADVICE_SEQUENTIAL ? MADV_SEQUENTIAL : (advice == IO_ADVICE_RANDOM ? MADV_RANDOM : MADV_NORMAL));
+#endif
+    }
+    void IO::MappedFile::prefetch(size_t offset, size_t size) const {
+        if (data == nullptr || offset >= this->size)
+            return;
+        size = std::min(size, this->size - offset);
+        static const size_t
+            granularity = mapGranularity();
+        const size_t
+            begin = offset / granularity * granularity;
+#ifdef _WIN32
+        // PrefetchVirtualMemory needs Windows 8, look it up so older ones still run
+        typedef BOOL(WINAPI* Prefetch)(HANDLE, ULONG_PTR, PWIN32_MEMORY_RANGE_ENTRY, ULONG);
+        static const Prefetch
+            prefetchFunc = (Prefetch)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+        if (prefetchFunc == nullptr)
+            return;
+        WIN32_MEMORY_RANGE_ENTRY
+            range;
+        range.VirtualAddress = (PVOID)(data + begin);
+        range.NumberOfBytes = offset + size - begin;
+        prefetchFunc(GetCurrentProcess(), 1, &range, 0);
+#else
+        madvise((void*)(data + begin), offset + size - begin, MADV_WILLNEED);
+#endif
+    }
+
+    // ChunkReader
+    IO::ChunkReader::~ChunkReader() {
+        close();
+    }
+    bool IO::ChunkReader::open(const std::string& path, size_t chunkSize) {
+        close();
+        this->path = path;
+        this->chunkSize = std::max<size_t>(chunkSize, 1);
+#ifdef _WIN32
+        HANDLE
+            f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (f == INVALID_HANDLE_VALUE)
+            return false;
+        file = f;
+        LARGE_INTEGER
+            size;
+        if (!GetFileSizeEx(f, &size)) {
+            close();
+            return false;
+        }
+        fileSize = (size_t)size.QuadPart;
+        if (fileSize > 0)
+            mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (fileSize > 0 && mapping == nullptr) {
+            close();
+            return false;
+        }
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat
+            st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            close();
+            return false;
+        }
+        fileSize = (size_t)st.st_size;
+#endif
+        return true;
+    }
+    void IO::ChunkReader::unmap() {
+        if (base == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap((void*)base, mappedSize);
+#endif
+        base = nullptr;
+        mappedSize = 0;
+    }
+    void IO::ChunkReader::close() {
+        unmap();
+#ifdef _WIN32
+        if (mapping != nullptr)
+            CloseHandle(mapping);
+        if (file != nullptr)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = nullptr;
+#else
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        fileSize = 0;
+        offset = 0;
+    }
+    bool IO::ChunkReader::next(View& chunk) {
+        // Drop the previous window before mapping the next one, so that at most one is mapped at a time
+        unmap();
+        if (offset >= fileSize)
+            return false;
+        static const size_t
+            granularity = mapGranularity();
+        const size_t
+            begin = offset / granularity * granularity,
+            size = std::min(chunkSize, fileSize - offset);
+        mappedSize = offset + size - begin;
+#ifdef _WIN32
+        if (mapping == nullptr)
+            return false;
+        base = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)((unsigned long long)begin >> 32), (DWORD)begin, mappedSize);
+#else
+        if (fd < 0)
+            return false;
+        void*
+            ptr = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, (off_t)begin);
+        base = (ptr == MAP_FAILED ? nullptr : (const char*)ptr);
+        if (base != nullptr)
+            madvise(ptr, mappedSize, MADV_SEQUENTIAL);
+#endif
+        if (base == nullptr) {
+            mappedSize = 0;
+            return false;
+        }
+        chunk.data = base + (offset - begin);
+        chunk.size = size;
+        offset += size;
+        return true;
+    }
+
     std::ifstream IO::open(const std::string& path) {
         std::ifstream
             ifs(path);
@@ -22,36 +319,51 @@ namespace ME {
     }
     // Text
     std::string IO::read_text(const std::string& path) {
-        std::ifstream
-            ifs = open(path);
-        std::string
-            str;
-        ifs.seekg(0, std::ios::end);
-        auto
-            size = ifs.tellg();
-        str.resize(size);
-        ifs.seekg(0, std::ios::beg);
-        ifs.read(&str[0], size);
-        ifs.close();
-        return str;
+        MappedFile
+            file;
+        if (!file.open(path))
+            throw(std::runtime_error(std::string("Cannot find ") + path));
+        return file.view().str();
     }
     std::vector<std::string> IO::read_text_lines(const std::string& path) {
-        std::ifstream
-            ifs = open(path);
-        if (!ifs.is_open()) {
-            throw std::invalid_argument("Invalid path name : " + path);
-        }
         std::vector<std::string>
             ret;
-        while (!ifs.eof()) {
-            std::string
-                line;
-            std::getline(ifs, line);
-            ret.push_back(line);
-        }
-        ifs.close();
+        for_each_line(path, [&ret](const View& line) { ret.push_back(line.str()); });
         return ret;
     }
+    // Binary
+    bool IO::read_binary(const std::string& path, std::vector<char>& data) {
+        MappedFile
+            file;
+        if (!file.open(path))
+            return false;
+        data.assign(file.getData(), file.getData() + file.getSize());
+        return true;
+    }
+    bool IO::write_binary(const std::string& path, const void* data, size_t size) {
+        const std::string
+            temp = path + ".tmp";
+        {
+            std::ofstream
+                ofs(temp, std::ios::binary | std::ios::trunc);
+            if (!ofs.is_open())
+                return false;
+            ofs.write((const char*)data, size);
+            if (!ofs) {
+                ofs.close();
+                std::remove(temp.c_str());
+                return false;
+            }
+        }
+        if (std::rename(temp.c_str(), path.c_str()) == 0)
+            return true;
+        // Windows does not rename over an existing file
+        std::remove(path.c_str());
+        if (std::rename(temp.c_str(), path.c_str()) == 0)
+            return true;
+        std::remove(temp.c_str());
+        return false;
+    }
     // Image
     //void IO::read_image(const std::string& path, unsigned char** bits, int& width, int& height) {
     //    int nr_channels;
@@ -13,17 +13,146 @@
 #pragma once
 #endif
 
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <fstream>
+#include <stdexcept>
+
+// Access pattern hints of [ MappedFile::advise() ]
+#define IO_ADVICE_NORMAL        0
+#define IO_ADVICE_SEQUENTIAL    1       // Read front to back, pages ahead are read early and pages behind dropped
+#define IO_ADVICE_RANDOM        2
+
+#define IO_DEF_CHUNK_SIZE       (64u << 20)
 
 namespace ME {
     class IO {
+    public:
+        // Bytes of a file ( or of a string ) without owning them, valid while their owner is alive.
+        struct View {
+            const char*     data = nullptr;
+            size_t          size = 0;
+
+            inline bool empty() const noexcept {
+                return size == 0;
+            }
+            inline std::string str() const {
+                return std::string(data, size);
+            }
+            inline bool operator==(const char* other) const {
+                return str_equal(*this, other);
+            }
+        };
+        static bool                         str_equal(const View& view, const char* str);
+        // Take the next line of [ text ] into [ line ], without its "\n" or "\r\n". False at the end of [ text ].
+        static bool                         next_line(View& text, View& line);
+        // Take the next token of [ text ] separated by spaces and tabs into [ token ]. False if none is left.
+        static bool                         next_token(View& text, View& token);
+
+        // Read-only mapping of a whole file. Pages are read by the OS on first access and shared with its
+        // file cache, so nothing is copied into the process until it is used.
+        class MappedFile {
+        private:
+            const char*     data = nullptr;
+            size_t          size = 0;
+#ifdef _WIN32
+            void*           file = nullptr;
+            void*           mapping = nullptr;
+#else
+            int             fd = -1;
+#endif
+        public:
+            MappedFile() = default;
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            MappedFile(MappedFile&& other) noexcept;
+            MappedFile& operator=(MappedFile&& other) noexcept;
+            ~MappedFile();
+
+            // Return false if [ path ] cannot be opened or mapped
+            bool open(const std::string& path, int advice = IO_ADVICE_SEQUENTIAL);
+            void close();
+
+            // @advice : IO_ADVICE_*
+            void advise(int advice) const;
+            // Ask OS to read [ offset, offset + size ) ahead of use
+            void prefetch(size_t offset, size_t size) const;
+
+            inline bool getValid() const noexcept {
+                return data != nullptr || size == 0;
+            }
+            inline const char* getData() const noexcept {
+                return data;
+            }
+            inline size_t getSize() const noexcept {
+                return size;
+            }
+            inline View view() const noexcept {
+                return { data, size };
+            }
+        };
+
+        // Reads a file in windows of [ chunkSize ] bytes for files too large to map at once. Each window is
+        // mapped in turn, and [ next() ] gives it without a copy until the following call.
+        class ChunkReader {
+        private:
+            std::string     path;
+            size_t          chunkSize = IO_DEF_CHUNK_SIZE;
+            size_t          fileSize = 0;
+            size_t          offset = 0;
+            const char*     base = nullptr;     // Start of the mapped window, aligned down from [ offset ]
+            size_t          mappedSize = 0;
+#ifdef _WIN32
+            void*           file = nullptr;
+            void*           mapping = nullptr;
+#else
+            int             fd = -1;
+#endif
+            void unmap();
+        public:
+            ChunkReader() = default;
+            ChunkReader(const ChunkReader&) = delete;
+            ChunkReader& operator=(const ChunkReader&) = delete;
+            ~ChunkReader();
+
+            bool open(const std::string& path, size_t chunkSize = IO_DEF_CHUNK_SIZE);
+            void close();
+            // Next [ chunkSize ] bytes ( fewer at the end ) into [ chunk ]. False at the end of file or on error.
+            bool next(View& chunk);
+
+            inline size_t getFileSize() const noexcept {
+                return fileSize;
+            }
+            inline size_t getOffset() const noexcept {
+                return offset;
+            }
+        };
+
     public:
         static std::ifstream open(const std::string& path);
 
         static std::string					read_text(const std::string& path);
         static std::vector<std::string>	    read_text_lines(const std::string& path);
+        // Call [ func ] with each line of the file at [ path ], viewed in its mapping
+        template <typename Func>
+        static void                         for_each_line(const std::string& path, Func func) {
+            MappedFile
+                file;
+            if (!file.open(path))
+                throw(std::runtime_error(std::string("Cannot find ") + path));
+            View
+                text = file.view(),
+                line;
+            while (next_line(text, line))
+                func(line);
+        }
+
+        // Binary
+        // Return false if [ path ] cannot be read, e.g. it does not exist.
+        static bool                         read_binary(const std::string& path, std::vector<char>& data);
+        // Write to a temporary file next to [ path ] and rename it, so that readers never see a partial file.
+        static bool                         write_binary(const std::string& path, const void* data, size_t size);
 
         // read image at [path] to [bits] and set [width], [height] of it.
         /*static void read_image(const std::string& path, unsigned char** bits, int& width, int& height);
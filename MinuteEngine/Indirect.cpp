@@ -0,0 +1,203 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "Indirect.h"
+#include "Residency.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <numeric>
+#include <stdexcept>
+
+namespace ME {
+	bool IndirectBatch::supported() {
+		static const bool support = GLEW_VERSION_4_3 ||
+			(GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance && GLEW_ARB_texture_buffer_object);
+		return support;
+	}
+	uint IndirectBatch::primitiveMode(const Render& render, bool triangulated) {
+		switch (render.type()) {
+		case POINT_RENDER_TYPE:
+			return GL_POINTS;
+		case LINE_RENDER_TYPE:
+			return GL_LINES;
+		case TRI_RENDER_TYPE:
+			return GL_TRIANGLES;
+		case QUAD_RENDER_TYPE:
+			return (triangulated ? GL_TRIANGLES : GL_QUADS);
+		default:
+			throw(std::runtime_error("Invalid render type for indirect draw"));
+		}
+	}
+	uint IndirectBatch::indexCount(const Render& render, bool triangulated) {
+		const auto& option = render.getOptionC();
+		switch (render.type()) {
+		case TRI_RENDER_TYPE:
+			return 3 * option.drawNum;
+		case QUAD_RENDER_TYPE:
+			return (triangulated ? 6 : 4) * option.drawNum;
+		default:
+			return option.drawNum;
+		}
+	}
+	IndirectBatch IndirectBatch::create() {
+		IndirectBatch batch;
+		glGenBuffers(1, &batch.commandBuffer);
+		glGenBuffers(1, &batch.drawIDBuffer);
+
+		glGenBuffers(1, &batch.drawDataBuffer);
+		glGenTextures(1, &batch.drawDataTexture);
+
+		glGenBuffers(1, &batch.materialBuffer);
+		glGenTextures(1, &batch.materialTexture);
+		return batch;
+	}
+	void IndirectBatch::destroy() {
+		for (auto buffer : { commandBuffer, drawIDBuffer, drawDataBuffer, materialBuffer })
+			ResidencyManager::global().eraseBuffer(buffer);
+		glDeleteBuffers(1, &commandBuffer);
+		glDeleteBuffers(1, &drawIDBuffer);
+		glDeleteBuffers(1, &drawDataBuffer);
+		glDeleteTextures(1, &drawDataTexture);
+		glDeleteBuffers(1, &materialBuffer);
+		glDeleteTextures(1, &materialTexture);
+		commandBuffer = drawIDBuffer = drawDataBuffer = drawDataTexture = materialBuffer = materialTexture = 0;
+		drawIDNum = 0;
+	}
+	void IndirectBatch::clear() {
+		drawData.clear();
+		materialData.clear();
+		materialMap.clear();
+		buckets.clear();
+		bucketMap.clear();
+		drawNum = 0;
+	}
+	bool IndirectBatch::add(const Render& render, const glm::mat4& modelMat, const Key& key, uint count, int materialIndex, uint first) {
+		const auto& range = render.getRange();
+		if (range == nullptr || range->pool < 0)
+			return false;
+
+		auto bucketKey = std::make_pair(range->pool, key);
+		auto find = bucketMap.find(bucketKey);
+		int id;
+		if (find == bucketMap.end()) {
+			Bucket bucket;
+			bucket.pool = range->pool;
+			bucket.render = &render;
+			buckets.push_back(bucket);
+			id = (int)buckets.size() - 1;
+			bucketMap.insert({ bucketKey, id });
+		}
+		else
+			id = find->second;
+
+		Command command;
+		command.count = count;
+		command.instanceCount = 1;
+		command.firstIndex = (uint)range->indexOffset + first;
+		command.baseVertex = (int)range->vertexOffset;
+		command.baseInstance = (uint)drawNum;
+		buckets[id].commands.push_back(command);
+
+		for (int i = 0; i < 4; i++)
+			drawData.push_back(modelMat[i]);
+		drawData.push_back(glm::vec4((float)materialIndex, 0.0f, 0.0f, 0.0f));
+		drawNum++;
+		return true;
+	}
+	int IndirectBatch::addMaterial(const Material& material) {
+		const glm::vec4 data[INDIRECT_MATERIAL_TEXELS] = {
+			material.getEmission(),
+			material.getAmbient(),
+			material.getDiffuse(),
+			material.getSpecular(),
+			glm::vec4(material.getShininess(), 0.0f, 0.0f, 0.0f)
+		};
+		Key key;
+		for (const auto& texel : data)
+			for (int i = 0; i < 4; i++)
+				key.push(texel[i]);
+
+		auto find = materialMap.find(key);
+		if (find != materialMap.end())
+			return find->second;
+
+		int id = (int)(materialData.size() / INDIRECT_MATERIAL_TEXELS);
+		for (const auto& texel : data)
+			materialData.push_back(texel);
+		materialMap.insert({ key, id });
+		return id;
+	}
+	void IndirectBatch::upload() {
+		// 1. Commands of every bucket in one buffer
+		std::vector<Command> commands;
+		commands.reserve(drawNum);
+		for (auto& bucket : buckets) {
+			bucket.commandOffset = commands.size();
+			commands.insert(commands.end(), bucket.commands.begin(), bucket.commands.end());
+		}
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(Command) * commands.size(), commands.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		ResidencyManager::global().setBufferBytes(commandBuffer, sizeof(Command) * commands.size());
+
+		// 2. Draw index attribute : [ 0, 1, 2, ... ], fetched at [ baseInstance ]
+		if (drawIDNum < (size_t)drawNum) {
+			drawIDNum = std::max((size_t)drawNum, drawIDNum * 2);
+			std::vector<GLint> ids(drawIDNum);
+			std::iota(ids.begin(), ids.end(), 0);
+			glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(GLint) * ids.size(), ids.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			ResidencyManager::global().setBufferBytes(drawIDBuffer, sizeof(GLint) * ids.size());
+		}
+
+		// 3. Per-draw data and materials
+		glBindBuffer(GL_TEXTURE_BUFFER, drawDataBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * drawData.size(), drawData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, materialBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * materialData.size(), materialData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		ResidencyManager::global().setBufferBytes(drawDataBuffer, sizeof(glm::vec4) * drawData.size());
+		ResidencyManager::global().setBufferBytes(materialBuffer, sizeof(glm::vec4) * materialData.size());
+
+		glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, drawDataBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, materialTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, materialBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	void IndirectBatch::bindDrawData(uint unitID) const {
+		glActiveTexture(GL_TEXTURE0 + unitID);
+		glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+	}
+	void IndirectBatch::bindMaterialData(uint unitID) const {
+		glActiveTexture(GL_TEXTURE0 + unitID);
+		glBindTexture(GL_TEXTURE_BUFFER, materialTexture);
+	}
+	void IndirectBatch::submit(const Bucket& bucket, uint mode) const {
+		if (bucket.commands.empty())
+			return;
+		const auto& pool = BufferArena::global().getPool(bucket.pool);
+
+		glBindVertexArray(pool.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, drawIDBuffer);
+		glEnableVertexAttribArray(INDIRECT_DRAW_ID_ATTR);
+		glVertexAttribIPointer(INDIRECT_DRAW_ID_ATTR, 1, GL_INT, sizeof(GLint), (void*)0);		// "in int drawID" in shaders
+		glVertexAttribDivisor(INDIRECT_DRAW_ID_ATTR, 1);
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT,
+			(void*)(sizeof(Command) * bucket.commandOffset), (GLsizei)bucket.commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		// Pool VAO is shared with per-object path, so do not leave the attribute on.
+		glDisableVertexAttribArray(INDIRECT_DRAW_ID_ATTR);
+		glBindVertexArray(0);
+	}
+}
\ No newline at end of file
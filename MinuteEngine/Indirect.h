@@ -0,0 +1,130 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_INDIRECT_H__
+#define __ME_INDIRECT_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "Render.h"
+#include "Material.h"
+#include "glm/mat4x4.hpp"
+#include <algorithm>
+#include <initializer_list>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#define INDIRECT_DRAW_ID_ATTR		5		// Per-draw attribute ( divisor 1 ) that carries draw index
+#define INDIRECT_DRAW_DATA_TEXELS	5		// 4 columns of model matrix + ( material index, 0, 0, 0 )
+#define INDIRECT_MATERIAL_TEXELS	5		// emission, ambient, diffuse, specular, ( shininess, 0, 0, 0 )
+#define INDIRECT_KEY_SIZE			32		// Most values a bucket key holds
+
+namespace ME {
+	// Collects draws of [ Render ]s that live in [ BufferArena ], and submits them with
+	// a single glMultiDrawElementsIndirect() call per ( pool, state ) bucket.
+	// Per-draw model matrix and material index are read in shaders from a texture buffer.
+	class IndirectBatch {
+	public:
+		// Same layout as DrawElementsIndirectCommand of OpenGL
+		struct Command {
+			uint count;
+			uint instanceCount;
+			uint firstIndex;
+			int baseVertex;
+			uint baseInstance;		// Index of per-draw data
+		};
+		// Fixed-size bucket key, so that building one for every draw does not allocate
+		struct Key {
+			float values[INDIRECT_KEY_SIZE];
+			uint size = 0;
+
+			Key() = default;
+			Key(std::initializer_list<float> list) {
+				push(list);
+			}
+			inline void push(float value) {
+				if (size == INDIRECT_KEY_SIZE)
+					throw(std::runtime_error("[INDIRECT ERROR] : Bucket key is too long"));
+				values[size++] = value;
+			}
+			inline void push(std::initializer_list<float> list) {
+				for (float value : list)
+					push(value);
+			}
+			inline bool operator<(const Key& other) const {
+				return std::lexicographical_compare(values, values + size, other.values, other.values + other.size);
+			}
+		};
+		struct Bucket {
+			int pool = -1;
+			const Render* render = nullptr;		// Representative render that gives bucket state
+			std::vector<Command> commands;
+			size_t commandOffset = 0;			// Location in command buffer after [ upload() ]
+		};
+	private:
+		uint commandBuffer = 0;
+		uint drawIDBuffer = 0;
+		uint drawDataBuffer = 0;
+		uint drawDataTexture = 0;
+		uint materialBuffer = 0;
+		uint materialTexture = 0;
+		size_t drawIDNum = 0;
+
+		std::vector<glm::vec4> drawData;
+		std::vector<glm::vec4> materialData;
+		std::map<Key, int> materialMap;
+		std::vector<Bucket> buckets;
+		std::map<std::pair<int, Key>, int> bucketMap;
+		int drawNum = 0;
+	public:
+		// True if current context supports multi draw indirect with base instance.
+		static bool supported();
+
+		// Primitive mode and number of indices that [ render ] draws with
+		// @triangulated : Quads are drawn as GL_TRIANGLES, from [ Render::getTriangleFirst() ]
+		static uint primitiveMode(const Render& render, bool triangulated = false);
+		static uint indexCount(const Render& render, bool triangulated = false);
+
+		static IndirectBatch create();
+		void destroy();
+
+		// Clear draws of the previous frame
+		void clear();
+
+		// @key : Draws with the same key and pool are submitted together
+		// @count : Number of indices to draw
+		// @first : First index to draw, relative to the render
+		// Return false if [ render ] is not placed in [ BufferArena ].
+		bool add(const Render& render, const glm::mat4& modelMat, const Key& key, uint count, int materialIndex = 0, uint first = 0);
+		int addMaterial(const Material& material);
+
+		// Send commands and per-draw data to GPU
+		void upload();
+
+		// Bind per-draw data texture buffers to given texture units
+		void bindDrawData(uint unitID) const;
+		void bindMaterialData(uint unitID) const;
+
+		// Issue one glMultiDrawElementsIndirect() for [ bucket ]
+		// @mode : GL_POINTS, GL_LINES, GL_TRIANGLES, GL_QUADS
+		void submit(const Bucket& bucket, uint mode) const;
+
+		inline const std::vector<Bucket>& getBucketsC() const noexcept {
+			return buckets;
+		}
+		inline int getDrawNum() const noexcept {
+			return drawNum;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -15,6 +15,10 @@
 
 #include "Color.h"
 #include "Shadow.h"
+#include "CascadedShadow.h"
+#include "CubeShadow.h"
+#include "ShadowAtlas.h"
+#include "LightCluster.h"
 #include "glm/vec3.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include <string>
@@ -35,9 +39,15 @@ namespace ME {
         Color ambient = Color::black();
         Color diffuse = Color::white();
         Color specular = Color::white();
+        float range = 0.0f;     // Point light fades out to zero at this distance, 0 means no fall off
+        bool cascadeBound = false;  // Set by [ LightManager ], only one light's cascades are drawn and bound
+
+        friend class LightManager;
     public:
         using Ptr = std::shared_ptr<Light>;
         Shadow shadow;
+        CascadedShadow csm;     // If valid, used instead of [ shadow ] ( directional light only )
+        CubeShadow cubeShadow;  // If valid, used instead of [ shadow ] ( point light only )
 
         inline void setName(const std::string& name) {
             this->name = name;
@@ -70,6 +80,9 @@ namespace ME {
         void setSpecular(const Color& v) {
             specular = v;
         }
+        inline void setRange(float range) {
+            this->range = range;
+        }
 
         inline int getType() const noexcept {
             return type;
@@ -95,7 +108,18 @@ namespace ME {
         inline Color getSpecular() const noexcept {
             return specular;
         }
+        inline float getRange() const noexcept {
+            return range;
+        }
+        // True for the one light whose [ csm ] is rendered and sampled this frame
+        inline bool getCascadeBound() const noexcept {
+            return cascadeBound;
+        }
 
+        // True if [ shadow ] is not used, because cascades or cube map are used instead
+        inline bool getShadowReplaced() const noexcept {
+            return (type == 0 && cascadeBound) || (type == 1 && cubeShadow.getValid());
+        }
         inline glm::mat4 getViewMat() const noexcept {
             return glm::lookAt(position, position + direction, up);
         }
@@ -105,10 +129,37 @@ namespace ME {
     public:
         using Ptr = std::shared_ptr<LightManager>;
         std::vector<Light> lights;
+        ShadowAtlas atlas;      // Shadow maps of every light without cascades
+        LightCluster cluster;   // Point lights with range and without shadow, binned into froxels
 
         inline void addLight(const Light light) {
             lights.push_back(light);
         }
+        // Fit shadows that depend on the view ( cascades, atlas tiles ) to [ camera ]. Call once per frame before shadow pass.
+        // @staticCasters : True if the scene has static objects, which are cached in the atlas's static layer
+        inline void updateShadows(const Camera& camera, bool staticCasters) {
+            // Only the first directional light with valid cascades uses them, the others keep their atlas tile
+            bool cascaded = false;
+            for (auto& light : lights) {
+                light.cascadeBound = !cascaded && light.getValid() && light.getType() == 0 && light.csm.getValid();
+                cascaded = cascaded || light.cascadeBound;
+            }
+            if (!atlas.getValid())
+                atlas = ShadowAtlas::create();
+            atlas.update(lights, camera, staticCasters);
+            for (auto& light : lights) {
+                if (light.getCascadeBound())
+                    light.csm.update(camera, light.getDirection());
+                if (light.getValid() && light.getType() == 1 && light.cubeShadow.getValid())
+                    light.cubeShadow.update(light.getPosition());
+            }
+        }
+        // Bin clusterable lights into froxels of [ camera ]. Call once per frame before drawing with lights.
+        inline void updateCluster(const Camera& camera) {
+            if (!cluster.getValid())
+                cluster = LightCluster::create();
+            cluster.update(lights, camera);
+        }
         inline void delLight(int index) {
             auto num = lights.size();
             if (num <= index)
@@ -0,0 +1,315 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "LightCluster.h"
+#include "Light.h"
+#include "Camera.h"
+#include "Residency.h"
+#include "glm/matrix.hpp"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ME_LIGHT_CLUSTER_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace ME {
+	LightCluster LightCluster::create(int gridX, int gridY, int gridZ) {
+		LightCluster cluster;
+		cluster.gridX = std::max(1, gridX);
+		cluster.gridY = std::max(1, gridY);
+		cluster.gridZ = std::max(1, gridZ);
+		if (cluster.gridX * cluster.gridY > 0xFFFF)
+			throw(std::runtime_error("Too many clusters in a depth slice"));	// Tile index is packed in 16 bits while binning
+
+		GLint maxSize = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxSize);
+		cluster.maxIndexNum = (uint)maxSize;
+
+		glGenBuffers(1, &cluster.lightBuffer);
+		glGenBuffers(1, &cluster.recordBuffer);
+		glGenBuffers(1, &cluster.indexBuffer);
+		glGenTextures(1, &cluster.lightTexture);
+		glGenTextures(1, &cluster.recordTexture);
+		glGenTextures(1, &cluster.indexTexture);
+
+		cluster.valid = true;
+		return cluster;
+	}
+	void LightCluster::destroy() {
+		ResidencyManager::global().eraseBuffer(lightBuffer);
+		ResidencyManager::global().eraseBuffer(recordBuffer);
+		ResidencyManager::global().eraseBuffer(indexBuffer);
+		glDeleteBuffers(1, &lightBuffer);
+		glDeleteBuffers(1, &recordBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+		glDeleteTextures(1, &lightTexture);
+		glDeleteTextures(1, &recordTexture);
+		glDeleteTextures(1, &indexTexture);
+		lightBuffer = recordBuffer = indexBuffer = 0;
+		lightTexture = recordTexture = indexTexture = 0;
+		pool = nullptr;
+		valid = false;
+	}
+	bool LightCluster::clusterable(const Light& light) {
+		return light.getValid() && light.getType() == 1 && light.getRange() > 0.0f &&
+			!light.shadow.getValid() && !light.cubeShadow.getValid();
+	}
+	void LightCluster::buildBounds(const Camera& camera) {
+		const glm::mat4 invProjMat = glm::inverse(camera.getProjMatC());
+		nearPlane = std::max(camera.getNPlane(), 1e-3f);
+		farPlane = std::max(camera.getFPlane(), nearPlane * 2.0f);
+
+		// Slice k covers view depth [ n * ( f / n ) ^ ( k / Z ), n * ( f / n ) ^ ( ( k + 1 ) / Z ) ]
+		const float logRatio = std::log(farPlane / nearPlane);
+		depthScale = gridZ / logRatio;
+		depthBias = -gridZ * std::log(nearPlane) / logRatio;
+
+		sliceStride = (gridX * gridY + 3) & ~3;
+		for (int k = 0; k < 3; k++) {
+			// Padding clusters get empty boxes, so they never overlap a light
+			boundMin[k].assign((size_t)sliceStride * gridZ, std::numeric_limits<float>::max());
+			boundMax[k].assign((size_t)sliceStride * gridZ, -std::numeric_limits<float>::max());
+		}
+
+		auto unproject = [&invProjMat](float x, float y, float z) {
+			glm::vec4 p = invProjMat * glm::vec4(x, y, z, 1.0f);
+			return glm::vec3(p) / p.w;
+		};
+		for (int y = 0; y < gridY; y++) {
+			for (int x = 0; x < gridX; x++) {
+				// Corner edges of the tile, from near plane to far plane. They are straight lines in view space
+				// for both perspective and orthographic projection.
+				glm::vec3 nearCorners[4];
+				glm::vec3 farCorners[4];
+				for (int c = 0; c < 4; c++) {
+					float ndcX = -1.0f + 2.0f * (x + (c & 1)) / gridX;
+					float ndcY = -1.0f + 2.0f * (y + (c >> 1)) / gridY;
+					nearCorners[c] = unproject(ndcX, ndcY, -1.0f);
+					farCorners[c] = unproject(ndcX, ndcY, 1.0f);
+				}
+				for (int z = 0; z < gridZ; z++) {
+					const size_t id = (size_t)z * sliceStride + y * gridX + x;
+					const float depths[2] = {
+						nearPlane * std::pow(farPlane / nearPlane, z / (float)gridZ),
+						nearPlane * std::pow(farPlane / nearPlane, (z + 1) / (float)gridZ)
+					};
+					for (float depth : depths) {
+						for (int c = 0; c < 4; c++) {
+							glm::vec3 edge = farCorners[c] - nearCorners[c];
+							float t = (-depth - nearCorners[c].z) / edge.z;
+							glm::vec3 p = nearCorners[c] + edge * t;
+							for (int k = 0; k < 3; k++) {
+								boundMin[k][id] = std::min(boundMin[k][id], p[k]);
+								boundMax[k][id] = std::max(boundMax[k][id], p[k]);
+							}
+						}
+					}
+				}
+			}
+		}
+		boundProjMat = camera.getProjMatC();
+	}
+	void LightCluster::binSlices(int first, int step, const std::vector<glm::vec4>& spheres, const std::vector<int>& sliceRanges) {
+		const int tileNum = gridX * gridY;
+		std::vector<uint> hits;			// ( tile << 16 ) | light, in ascending order of light
+		std::vector<uint> cursors(tileNum);
+		for (int z = first; z < gridZ; z += step) {
+			const size_t base = (size_t)z * sliceStride;
+			const float* minX = boundMin[0].data() + base;
+			const float* minY = boundMin[1].data() + base;
+			const float* minZ = boundMin[2].data() + base;
+			const float* maxX = boundMax[0].data() + base;
+			const float* maxY = boundMax[1].data() + base;
+			const float* maxZ = boundMax[2].data() + base;
+
+			// 1. Sphere - box tests of every light that reaches this slice
+			hits.clear();
+			for (uint l = 0; l < (uint)spheres.size(); l++) {
+				if (z < sliceRanges[2 * l] || z > sliceRanges[2 * l + 1])
+					continue;
+				const glm::vec4& s = spheres[l];
+#ifdef ME_LIGHT_CLUSTER_SSE
+				// Distance from the center to a box along each axis is max( min - c, c - max, 0 ), 4 boxes at once.
+				const __m128 cx = _mm_set1_ps(s.x);
+				const __m128 cy = _mm_set1_ps(s.y);
+				const __m128 cz = _mm_set1_ps(s.z);
+				const __m128 rr = _mm_set1_ps(s.w * s.w);
+				const __m128 zero = _mm_setzero_ps();
+				for (int t = 0; t < sliceStride; t += 4) {
+					__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX + t), cx), _mm_sub_ps(cx, _mm_loadu_ps(maxX + t))), zero);
+					__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY + t), cy), _mm_sub_ps(cy, _mm_loadu_ps(maxY + t))), zero);
+					__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minZ + t), cz), _mm_sub_ps(cz, _mm_loadu_ps(maxZ + t))), zero);
+					__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+					int mask = _mm_movemask_ps(_mm_cmple_ps(d2, rr));
+					for (int bit = 0; mask != 0; bit++, mask >>= 1) {
+						if (mask & 1)
+							hits.push_back(((uint)(t + bit) << 16) | l);
+					}
+				}
+#else
+				const float rr = s.w * s.w;
+				for (int t = 0; t < tileNum; t++) {
+					float dx = std::max(std::max(minX[t] - s.x, s.x - maxX[t]), 0.0f);
+					float dy = std::max(std::max(minY[t] - s.y, s.y - maxY[t]), 0.0f);
+					float dz = std::max(std::max(minZ[t] - s.z, s.z - maxZ[t]), 0.0f);
+					if (dx * dx + dy * dy + dz * dz <= rr)
+						hits.push_back(((uint)t << 16) | l);
+				}
+#endif
+			}
+
+			// 2. Counting sort by tile, lights of a tile stay in ascending order
+			std::fill(cursors.begin(), cursors.end(), 0);
+			for (auto hit : hits)
+				cursors[hit >> 16]++;
+			uint offset = 0;
+			for (int t = 0; t < tileNum; t++) {
+				auto& record = records[(size_t)z * tileNum + t];
+				record.offset = offset;
+				record.count = cursors[t];
+				cursors[t] = offset;
+				offset += record.count;
+			}
+			auto& list = sliceIndices[z];
+			list.resize(hits.size());
+			for (auto hit : hits)
+				list[cursors[hit >> 16]++] = hit & 0xFFFF;
+		}
+	}
+	void LightCluster::update(const std::vector<Light>& lights, const Camera& camera) {
+		if (camera.getProjMatC() != boundProjMat)
+			buildBounds(camera);
+		tileWidth = camera.getWindowWidth() / (float)gridX;
+		tileHeight = camera.getWindowHeight() / (float)gridY;
+
+		auto sliceOf = [this](float depth) {
+			int slice = (int)std::floor(std::log(depth) * depthScale + depthBias);
+			return std::max(0, std::min(slice, gridZ - 1));
+		};
+
+		// 1. View space bounding spheres and shading data of clustered lights
+		const glm::mat4& viewMat = camera.getViewMatC();
+		std::vector<glm::vec4> spheres;
+		std::vector<int> sliceRanges;		// ( first, last ) slice of each light, empty if out of depth range
+		lightData.clear();
+		for (const auto& light : lights) {
+			if (!clusterable(light))
+				continue;
+			if (spheres.size() == LIGHT_CLUSTER_MAX_LIGHT_NUM)
+				break;
+			const glm::vec3 center = glm::vec3(viewMat * glm::vec4(light.getPosition(), 1.0f));
+			const float range = light.getRange();
+			spheres.push_back(glm::vec4(center, range));
+			lightData.push_back(glm::vec4(center, range));
+			lightData.push_back(glm::vec4(glm::vec3(light.getAmbient()), 0.0f));
+			lightData.push_back(glm::vec4(glm::vec3(light.getDiffuse()), 0.0f));
+			lightData.push_back(glm::vec4(glm::vec3(light.getSpecular()), 0.0f));
+
+			const float minDepth = -center.z - range;
+			const float maxDepth = -center.z + range;
+			if (maxDepth < nearPlane || minDepth > farPlane) {
+				sliceRanges.push_back(0);
+				sliceRanges.push_back(-1);
+			}
+			else {
+				sliceRanges.push_back(sliceOf(std::max(minDepth, nearPlane)));
+				sliceRanges.push_back(sliceOf(std::min(maxDepth, farPlane)));
+			}
+		}
+		lightNum = (uint)spheres.size();
+
+		// 2. Bin lights slice by slice. Slices are interleaved between threads, since near slices are thinner.
+		records.assign((size_t)gridX * gridY * gridZ, Record());
+		sliceIndices.resize(gridZ);
+		uint workerNum = (threadNum == 0 ? std::thread::hardware_concurrency() : threadNum);
+		workerNum = std::max(1u, std::min(workerNum, (uint)gridZ));
+		if (lightNum < LIGHT_CLUSTER_PARALLEL_THRESHOLD)
+			workerNum = 1;
+
+		if (workerNum > 1 && (pool == nullptr || pool->getThreadNum() != workerNum - 1)) {
+			pool = std::make_shared<ThreadPool>();
+			pool->start(workerNum - 1);
+		}
+		std::vector<std::future<void>> done;
+		for (uint i = 1; i < workerNum; i++) {
+			auto task = std::make_shared<std::packaged_task<void()>>(
+				std::bind(&LightCluster::binSlices, this, (int)i, (int)workerNum, std::cref(spheres), std::cref(sliceRanges)));
+			done.push_back(task->get_future());
+			pool->push([task]() { (*task)(); });
+		}
+		binSlices(0, (int)workerNum, spheres, sliceRanges);
+		for (auto& slice : done)
+			slice.get();
+
+		// 3. Concatenate slices into a single index list
+		const int tileNum = gridX * gridY;
+		indices.clear();
+		for (int z = 0; z < gridZ; z++) {
+			const auto& list = sliceIndices[z];
+			for (int t = 0; t < tileNum; t++) {
+				auto& record = records[(size_t)z * tileNum + t];
+				const uint begin = record.offset;
+				record.offset = (uint)indices.size();
+				record.count = std::min(record.count, maxIndexNum - (uint)indices.size());		// Drop what does not fit
+				indices.insert(indices.end(), list.begin() + begin, list.begin() + begin + record.count);
+			}
+		}
+		indexNum = (uint)indices.size();
+
+		upload();
+	}
+	void LightCluster::upload() {
+		// Texture buffers can not be empty
+		if (lightData.empty())
+			lightData.push_back(glm::vec4(0.0f));
+		if (indices.empty())
+			indices.push_back(0);
+
+		glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4) * lightData.size(), lightData.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, recordBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(Record) * records.size(), records.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(uint) * indices.size(), indices.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		auto& residency = ResidencyManager::global();
+		residency.setBufferBytes(lightBuffer, sizeof(glm::vec4) * lightData.size());
+		residency.setBufferBytes(recordBuffer, sizeof(Record) * records.size());
+		residency.setBufferBytes(indexBuffer, sizeof(uint) * indices.size());
+
+		glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, recordBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, indexBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	void LightCluster::bindLightData(uint unitID) const {
+		glActiveTexture(GL_TEXTURE0 + unitID);
+		glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+	}
+	void LightCluster::bindRecords(uint unitID) const {
+		glActiveTexture(GL_TEXTURE0 + unitID);
+		glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+	}
+	void LightCluster::bindIndices(uint unitID) const {
+		glActiveTexture(GL_TEXTURE0 + unitID);
+		glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+	}
+}
\ No newline at end of file
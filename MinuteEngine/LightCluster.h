@@ -0,0 +1,138 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_LIGHT_CLUSTER_H__
+#define __ME_LIGHT_CLUSTER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "ThreadPool.h"
+#include "glm/vec4.hpp"
+#include "glm/mat4x4.hpp"
+#include <memory>
+#include <vector>
+
+#define LIGHT_CLUSTER_DEF_GRID_X			16
+#define LIGHT_CLUSTER_DEF_GRID_Y			9
+#define LIGHT_CLUSTER_DEF_GRID_Z			24		// Exponential depth slices
+#define LIGHT_CLUSTER_MAX_LIGHT_NUM			4096
+#define LIGHT_CLUSTER_LIGHT_TEXELS			4		// ( view position, range ), ambient, diffuse, specular
+#define LIGHT_CLUSTER_PARALLEL_THRESHOLD	64		// Bin on the calling thread below this number of lights
+
+namespace ME {
+	class Light;
+	class Camera;
+
+	// Froxel grid over the camera frustum : screen is split into [ gridX ] x [ gridY ] tiles, and depth into
+	// [ gridZ ] exponential slices. Point lights with finite range are binned into clusters on CPU, and shaders
+	// read the light list of the cluster a fragment falls into from texture buffers.
+	class LightCluster {
+	public:
+		// Light indices of a cluster are [ offset, offset + count ) of the index buffer
+		struct Record {
+			uint offset = 0;
+			uint count = 0;
+		};
+	private:
+		bool valid = false;
+		int gridX = LIGHT_CLUSTER_DEF_GRID_X;
+		int gridY = LIGHT_CLUSTER_DEF_GRID_Y;
+		int gridZ = LIGHT_CLUSTER_DEF_GRID_Z;
+		int sliceStride = 0;				// Clusters of a slice in bounds, padded to a multiple of 4
+		uint threadNum = 0;					// 0 : Use every hardware thread
+		std::shared_ptr<ThreadPool> pool;	// Workers that bin slices besides the calling thread, kept across frames
+
+		// View space bounding box of each cluster, component by component so that 4 clusters are tested at once.
+		std::vector<float> boundMin[3];
+		std::vector<float> boundMax[3];
+		glm::mat4 boundProjMat = glm::mat4(0.0f);	// Projection that bounds were built for
+		float nearPlane = 0.0f;
+		float farPlane = 0.0f;
+		float depthScale = 0.0f;			// slice = log( view depth ) * depthScale + depthBias
+		float depthBias = 0.0f;
+		float tileWidth = 0.0f;				// Screen size of a cluster in pixels
+		float tileHeight = 0.0f;
+
+		// Binning results
+		std::vector<glm::vec4> lightData;
+		std::vector<Record> records;
+		std::vector<uint> indices;
+		std::vector<std::vector<uint>> sliceIndices;	// Indices of each slice, offsets of [ records ] are local to the slice
+		uint lightNum = 0;
+		uint indexNum = 0;
+		uint maxIndexNum = 0;				// GL_MAX_TEXTURE_BUFFER_SIZE
+
+		uint lightBuffer = 0;
+		uint lightTexture = 0;
+		uint recordBuffer = 0;
+		uint recordTexture = 0;
+		uint indexBuffer = 0;
+		uint indexTexture = 0;
+
+		void buildBounds(const Camera& camera);
+		void binSlices(int first, int step, const std::vector<glm::vec4>& spheres, const std::vector<int>& sliceRanges);
+		void upload();
+	public:
+		static LightCluster create(int gridX = LIGHT_CLUSTER_DEF_GRID_X, int gridY = LIGHT_CLUSTER_DEF_GRID_Y, int gridZ = LIGHT_CLUSTER_DEF_GRID_Z);
+		void destroy();
+
+		// True if [ light ] is shaded through clusters : a valid point light with finite range and without shadow.
+		static bool clusterable(const Light& light);
+		// Bin clusterable [ lights ] into clusters of [ camera ] and upload the result. Call once per frame.
+		void update(const std::vector<Light>& lights, const Camera& camera);
+
+		void bindLightData(uint unitID) const;
+		void bindRecords(uint unitID) const;
+		void bindIndices(uint unitID) const;
+
+		inline bool getValid() const noexcept {
+			return valid;
+		}
+		inline int getGridX() const noexcept {
+			return gridX;
+		}
+		inline int getGridY() const noexcept {
+			return gridY;
+		}
+		inline int getGridZ() const noexcept {
+			return gridZ;
+		}
+		inline float getDepthScale() const noexcept {
+			return depthScale;
+		}
+		inline float getDepthBias() const noexcept {
+			return depthBias;
+		}
+		inline float getTileWidth() const noexcept {
+			return tileWidth;
+		}
+		inline float getTileHeight() const noexcept {
+			return tileHeight;
+		}
+		inline uint getLightNum() const noexcept {
+			return lightNum;
+		}
+		inline uint getIndexNum() const noexcept {
+			return indexNum;
+		}
+		inline uint getThreadNum() const noexcept {
+			return threadNum;
+		}
+		inline const std::vector<Record>& getRecordsC() const noexcept {
+			return records;
+		}
+		inline void setThreadNum(uint num) noexcept {
+			threadNum = num;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
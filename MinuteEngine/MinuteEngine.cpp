@@ -17,12 +17,20 @@
 #include "Shader/StandardShader.h"
 #include "Shader/ShadowmapShader.h"
 #include "Shader/SkyboxShader.h"
+#include "Shader/DebugShader.h"
+#include "Shader/MomentShader.h"
+#include "Shader/DeferredShader.h"
+#include "Shader/DepthShader.h"
 #include "Camera.h"
 #include "Mouse.h"
 #include "Geometry.h"
 #include "Render.h"
 #include "Scene.h"
 #include "Timer.h"
+#include "TextureStream.h"
+#include "TextureManager.h"
+#include "Residency.h"
+#include "AsyncIO.h"
 #include "UI.h"
 
 // ImGui
@@ -39,6 +47,7 @@ int wnd_width = 640, wnd_height = 480;
 ME::Camera camera = ME::Camera::create(wnd_width, wnd_height);
 ME::Mouse mouse;
 ME::Scene scene = ME::Scene::create();
+bool debugMode = false;     // World axes and light directions, toggled by F1
 
 void resize(int width, int height) {
     wnd_width = width;
@@ -118,6 +127,9 @@ void keyboardEvent(const SDL_Event& e, bool& done) {
         else if (e.key.keysym.scancode == SDL_SCANCODE_D) {
             camera.moveLeftRight(1, 1.0f);
         }
+        else if (e.key.keysym.scancode == SDL_SCANCODE_F1) {
+            debugMode = !debugMode;
+        }
     }
 }
 
@@ -131,18 +143,22 @@ void lightSetting() {
     directionalLight.setUp({ 0, 1, 0 });
     directionalLight.shadow = ME::Shadow::create();
     directionalLight.shadow.setValid(true);
+    directionalLight.csm = ME::CascadedShadow::create();
+    directionalLight.csm.setValid(true);
 
-    /*pointLight.setType(1);
+    pointLight.setType(1);
     pointLight.setDiffuse(ME::Color::green());
     pointLight.setSpecular(ME::Color::green());
     pointLight.setPosition({ 5, 1, 5 });
     pointLight.setDirection({ -5, -1, -5 });
     pointLight.setUp({ 0, 1, 0 });
     pointLight.shadow = ME::Shadow::create();
-    pointLight.shadow.setValid(true);*/
+    pointLight.shadow.setValid(true);
+    pointLight.cubeShadow = ME::CubeShadow::create();
+    pointLight.cubeShadow.setValid(true);
     
     scene.getLightManager().addLight(directionalLight);
-    //scene.getLightManager().addLight(pointLight);
+    scene.getLightManager().addLight(pointLight);
 }
 
 void floorSetting() {
@@ -164,12 +180,13 @@ void floorSetting() {
     vertices[3].texcoord = { 0, 5, 0, 0 };
 
     auto render = ME::QuadRender::createQuadPtr(vertices);
-    render->getOption().diffuseMap.texture = ME::Texture2D::create("./resources/textures/parquet/diffuse.jpg");
-    render->getOption().diffuseMap.valid = true;
-    render->getOption().specularMap.texture = ME::Texture2D::create("./resources/textures/parquet/specular.jpg");
+    // Specular goes into alpha of diffuse map ( BC3 ), so both are read with one fetch
+    auto& textures = ME::TextureManager::global();
+    render->getOption().diffuseMap.set(textures.loadPacked("./resources/textures/parquet/diffuse.jpg",
+        "./resources/textures/parquet/specular.jpg", 3, TEXTURE_COMPRESSION_COLOR, true, ME::Color::create(0.5f, 0.5f, 0.5f, 0.5f)));
     render->getOption().specularMap.valid = true;
-    render->getOption().normalMap.texture = ME::Texture2D::create("./resources/textures/parquet/normal.jpg");
-    render->getOption().normalMap.valid = true;
+    render->getOption().specularPacked = true;
+    render->getOption().normalMap.set(textures.load("./resources/textures/parquet/normal.jpg", TEXTURE_COMPRESSION_NORMAL, true, ME::Color::create(0.5f, 0.5f, 1.0f)));
     /*render->option.parallaxMap.texture = ME::Texture2D::create("./resources/textures/parquet/parallax.jpg");
     render->option.parallaxMap.valid = true;*/
 
@@ -218,6 +235,27 @@ void cubeSetting() {
     scene.addObject(object);
 }
 
+// Pillars share one option, so [ Scene::bake() ] merges them into a single draw
+void pillarSetting() {
+    for (int i = 0; i < 8; i++) {
+        auto object = ME::Object::createPtr("Pillar");
+
+        ME::Render::Vertex min, max;
+        float x = -7.0f + 2.0f * i;
+        min.position = { x - 0.25f, -1, 7.75f };
+        max.position = { x + 0.25f, 3, 8.25f };
+        auto render = ME::QuadRender::createCubePtr(min, max);
+        render->getOption().shadeMode = 1;
+        render->getOption().drawEdge = false;
+
+        auto prop = ME::Property::createPtr(render);
+        prop->setName("Render");
+        object->addProperty(prop);
+        object->setStatic(true);
+        scene.addObject(object);
+    }
+}
+
 void skyboxSetting() {
     std::string path[6];
     path[0] = std::string("./resources/textures/skybox3/right.jpg");
@@ -226,7 +264,7 @@ void skyboxSetting() {
     path[3] = std::string("./resources/textures/skybox3/bottom.jpg");
     path[4] = std::string("./resources/textures/skybox3/front.jpg");
     path[5] = std::string("./resources/textures/skybox3/back.jpg");
-    scene.getSkybox() = ME::Scene::Skybox::create(path);
+    scene.getSkybox() = ME::Scene::Skybox::create(path, true);
     scene.getSkybox().valid = true;
 }
 
@@ -235,7 +273,9 @@ void sceneSetting() {
     floorSetting();
     sphereSetting();
     cubeSetting();
+    pillarSetting();
     skyboxSetting();
+    scene.bake();
 }
 
 int main()
@@ -276,6 +316,9 @@ int main()
         exit(-1);
     }
 
+    // Keep textures within 3 / 4 of video memory, if the driver reports it
+    ME::ResidencyManager::global().setBudgetRatio();
+
     // Disable v-sync.
     if (SDL_GL_SetSwapInterval(0) < 0)
         std::cerr << "[ SDL_GL_SetSwapInterval ] failed : %s" << SDL_GetError() << std::endl;
@@ -306,9 +349,27 @@ int main()
     ImGui_ImplSDL2_InitForOpenGL(window, glc);
     ImGui_ImplOpenGL3_Init(IMGUI_GLSL_VERSION);
     // ==================================================================================
+    // Startup time of shaders, compare runs with and without program binaries in Shader/cache
+    ME::Timer shaderTimer;
+    shaderTimer.setBeg();
+    // Read every source at once, so that compiling one overlaps reading the rest
+    ME::Shader::preloadSources({
+        "Shader/glsl/330/standard.vert", "Shader/glsl/330/standard.frag", "Shader/glsl/330/deferred.vert",
+        "Shader/glsl/330/shadowmap.vert", "Shader/glsl/330/shadowmap.frag",
+        "Shader/glsl/330/cubeshadow.vert", "Shader/glsl/330/cubeshadow.geom", "Shader/glsl/330/cubeshadow.frag",
+        "Shader/glsl/330/skybox.vert", "Shader/glsl/330/skybox.frag", "Shader/glsl/330/debug.vert", "Shader/glsl/330/debug.frag",
+        "Shader/glsl/330/moment.vert", "Shader/glsl/330/moment.frag", "Shader/glsl/330/depth.vert", "Shader/glsl/330/depth.frag" });
     ME::StandardShader standardShader = ME::StandardShader::create("Shader/glsl/330/standard.vert", "Shader/glsl/330/standard.frag");
     ME::ShadowmapShader shadowmapShader = ME::ShadowmapShader::create("Shader/glsl/330/shadowmap.vert", "Shader/glsl/330/shadowmap.frag");
+    shadowmapShader.createCubeProgram("Shader/glsl/330/cubeshadow.vert", "Shader/glsl/330/cubeshadow.geom", "Shader/glsl/330/cubeshadow.frag");
     ME::SkyboxShader skyboxShader = ME::SkyboxShader::create("Shader/glsl/330/skybox.vert", "Shader/glsl/330/skybox.frag");
+    ME::DebugShader debugShader = ME::DebugShader::create("Shader/glsl/330/debug.vert", "Shader/glsl/330/debug.frag");
+    ME::MomentShader momentShader = ME::MomentShader::create("Shader/glsl/330/moment.vert", "Shader/glsl/330/moment.frag");
+    ME::DeferredShader deferredShader = ME::DeferredShader::create("Shader/glsl/330/standard.vert", "Shader/glsl/330/standard.frag", "Shader/glsl/330/deferred.vert");
+    ME::DepthShader depthShader = ME::DepthShader::create("Shader/glsl/330/depth.vert", "Shader/glsl/330/depth.frag");
+    shaderTimer.setEnd();
+    std::cout << "[SHADER] : Created in " << shaderTimer.getElapsedTime() * 1000.0 << " msec, " <<
+        ME::Shader::getProgramCacheHitNum() << " programs from cache, " << ME::Shader::getProgramCacheMissNum() << " compiled" << std::endl;
     scene = ME::Scene::create();
 
     sceneSetting();
@@ -319,6 +380,7 @@ int main()
 
     ME::Timer timer;
     timer.setBeg();
+    bool variantsFinished = false;
     loop = [&]
     {
         // Poll and handle events (inputs, window resize, etc.)
@@ -354,10 +416,16 @@ int main()
         // Clear the screen to black
         ImGui::Render();
         {
+            // Textures that finished decoding replace their placeholders
+            ME::TextureStreamer::global().update();
+
             camera.drawBG();
 
             // 1st pass : Render to shadow map
+            scene.getLightManager().updateShadows(camera, scene.hasStaticObject());
+            scene.getLightManager().updateCluster(camera);
             shadowmapShader.draw(scene);
+            momentShader.draw(scene.getLightManagerC(), shadowmapShader);
 
             // 2nd pass : Render to screen
             glViewport(0, 0, camera.getWindowWidth(), camera.getWindowHeight());
@@ -368,16 +436,54 @@ int main()
             skyboxShader.setUnifMat4(skyboxShader.uProjMat(), camera.getProjMatC());
             skyboxShader.draw(scene);
             
-            standardShader.setUnifMat4(standardShader.uViewMat(), camera.getViewMatC());
-            standardShader.setUnifMat4(standardShader.uProjMat(), camera.getProjMatC());
-            standardShader.setUnifVec3(standardShader.uCameraPosition(), camera.getEye());
-            standardShader.draw(scene);
+            scene.getStaticBatch().cull(camera.getProjMatC() * camera.getViewMatC());
+            if (scene.getDeferred())
+                deferredShader.draw(scene, camera);
+            else {
+                // Depth pre-pass while overdraw is high, otherwise the main pass is measured
+                const bool prepass = depthShader.draw(scene, camera);
+                standardShader.setDepthPrepass(prepass);
+                standardShader.setUnifCamera(camera);
+                if (!prepass)
+                    depthShader.beginMeasure();
+                standardShader.draw(scene);
+                depthShader.endMeasure();
+            }
+
+            // Debug primitives : world axes and light directions
+            auto& debugDraw = ME::DebugDraw::global();
+            if (debugMode) {
+                debugDraw.addAxes(glm::mat4(1.0f), 1.0f, DEBUG_WIDTH_THICK);
+                for (const auto& light : scene.getLightManagerC().lights)
+                    debugDraw.addLine(light.getPosition(), light.getPosition() + light.getDirection(), ME::Color::yellow());
+            }
+            debugShader.setUnifMat4(debugShader.uViewMat(), camera.getViewMatC());
+            debugShader.setUnifMat4(debugShader.uProjMat(), camera.getProjMatC());
+            debugShader.draw(debugDraw);
         }
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         SDL_GL_SwapWindow(window);
+        ME::ResidencyManager::global().update();
+
+        // The first frame asked for the variants of the whole scene. Without parallel compile they are only
+        // linked here, a single stall at startup in place of a loading screen.
+        if (!variantsFinished && !ME::Shader::parallelCompileSupported()) {
+            standardShader.finishVariants();
+            deferredShader.finishVariants();
+        }
+        variantsFinished = true;
     };
     while (!done)
         main_loop();
+    std::cout << "[STANDARD SHADER] : " << standardShader.getVariantReport() << std::endl;
+    std::cout << "[DEFERRED SHADER] : " << deferredShader.getVariantReport() << std::endl;
+    std::cout << "[TEXTURE COMPRESS] : " << ME::TextureCompressor::getCacheHitNum() << " textures from cache, " <<
+        ME::TextureCompressor::getCacheMissNum() << " encoded" << std::endl;
+    std::cout << "[TEXTURE MANAGER] : " << ME::TextureManager::global().getReport() << std::endl;
+    std::cout << "[RESIDENCY] : " << ME::ResidencyManager::global().getReport() << std::endl;
+    std::cout << "[ASYNC IO] : " << ME::AsyncIO::global().getReport() << std::endl;
+    ME::TextureManager::global().destroy();
+    ME::TextureStreamer::global().destroy();
     SDL_GL_DeleteContext(glc);
     SDL_DestroyWindow(window);
     SDL_Quit();
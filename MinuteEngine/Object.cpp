@@ -35,6 +35,19 @@ namespace ME {
     void Object::rotate(const glm::vec3& axis, float angle) {
         transform.rotate(axis, angle);
     }
+    uint Object::staticRevision = 0;
+
+    void Object::setStatic(bool isStatic) noexcept {
+        if (this->isStatic != isStatic)
+            staticRevision++;
+        this->isStatic = isStatic;
+    }
+    bool Object::getStatic() const noexcept {
+        return isStatic;
+    }
+    uint Object::getStaticRevision() noexcept {
+        return staticRevision;
+    }
     int Object::propertySize() const noexcept {
         return (int)properties.size();
     }
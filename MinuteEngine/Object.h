@@ -33,6 +33,9 @@ namespace ME {
         int             nID = 0;        // ID for the next property to be added.
         Transform       transform;
         PropList        properties;
+        bool            isStatic = false;   // Static objects never move, and can be merged by [ Scene::bake() ].
+
+        static uint     staticRevision;     // Increased whenever any object becomes static or dynamic
 
         Object() = default;
     public:
@@ -50,6 +53,10 @@ namespace ME {
         void translate(const glm::vec3& v);
         void rotate(const glm::vec3& axis, float angle);
 
+        void setStatic(bool isStatic) noexcept;
+        bool getStatic() const noexcept;
+        static uint getStaticRevision() noexcept;
+
         int propertySize() const noexcept;
         bool addProperty(const Property::Ptr& property);
         bool delProperty(int id);
@@ -14,8 +14,9 @@
 #include <SDL_opengl.h>
 #include <vector>
 #include <map>
-
-#define BUFFER_DATA_USAGE GL_STATIC_DRAW
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 namespace ME {
 	// Render
@@ -38,6 +39,39 @@ namespace ME {
 		btan[1] = (-du2 * aVec[1] + du1 * bVec[1]) / det;
 		btan[2] = (-du2 * aVec[2] + du1 * bVec[2]) / det;
 	}
+	void Render::upload(const Vertex* vertices, size_t vertexNum, const uint* indices, size_t indexNum) {
+		range = BufferArena::global().allocate(vertices, Vertex::memSize(), vertexNum, indices, indexNum);
+
+		const auto& pool = BufferArena::global().getPool(range->pool);
+		vao = pool.vao;
+		vbo = pool.vbo;
+		ebo = pool.ebo;
+		triangleFirst = 0;
+		revision++;
+	}
+	void Render::uploadQuads(const Vertex* vertices, size_t vertexNum, const uint* indices, size_t indexNum) {
+		std::vector<uint> all(indexNum + indexNum / 4 * 6);
+		std::copy(indices, indices + indexNum, all.begin());
+		triangulateQuads(indices, indexNum, all.data() + indexNum);
+		upload(vertices, vertexNum, all.data(), all.size());
+		triangleFirst = indexNum;
+	}
+	void Render::triangulateQuads(const uint* quads, size_t indexNum, uint* triangles) {
+		for (size_t i = 0; i + 3 < indexNum; i += 4) {
+			const uint* q = quads + i;
+			const uint triangle[6] = { q[0], q[1], q[2], q[0], q[2], q[3] };
+			std::copy(triangle, triangle + 6, triangles);
+			triangles += 6;
+		}
+	}
+	void Render::drawElements(uint mode, int count, size_t first) const {
+		if (range != nullptr) {
+			auto indexOffset = (void*)(sizeof(GLuint) * (range->indexOffset + first));
+			glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_INT, indexOffset, (GLint)range->vertexOffset);
+		}
+		else
+			glDrawElements(mode, count, GL_UNSIGNED_INT, (void*)(sizeof(GLuint) * first));
+	}
 	void Render::drawUI(bool update) {
 		ImGui::Text("Render Options");
 
@@ -96,26 +130,8 @@ namespace ME {
 	PointRender PointRender::create(const Vertex& vert) {
 		PointRender render;
 
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
-
-		auto vertMemSize = Vertex::memSize();
-
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize, &vert, BUFFER_DATA_USAGE);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// 2. EBO
 		GLuint index[] = { 0 };
-
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.upload(&vert, 1, index, 1);
 
 		render.option.drawNum = 1;
 
@@ -130,26 +146,8 @@ namespace ME {
 	LineRender LineRender::create(const Vertex vert[2]) {
 		LineRender render;
 
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
-
-		auto vertMemSize = Vertex::memSize();
-
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize * 2, vert, BUFFER_DATA_USAGE);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// 2. EBO
 		GLuint index[] = { 0, 1 };
-
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.upload(vert, 2, index, 2);
 
 		render.option.drawNum = 2;
 
@@ -162,13 +160,6 @@ namespace ME {
 
 	// TriRender
 	TriRender TriRender::createTriangle(const Vertex vert[3], bool computeNormal, bool computeTangentSpace) noexcept {
-		auto vertMemSize = Vertex::memSize();
-		auto pOffset = Vertex::positionOffset();
-		auto nOffset = Vertex::normalOffset();
-		auto tOffset = Vertex::texcoordOffset();
-		auto tanOffset = Vertex::tangentOffset();
-		auto bOffset = Vertex::bitangentOffset();
-
 		Vertex copy[3] = { vert[0], vert[1], vert[2] };
 
 		if (computeNormal) {
@@ -195,35 +186,10 @@ namespace ME {
 		}
 
 		TriRender render;
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
 
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize * 3, copy, BUFFER_DATA_USAGE);
-
-		/*glEnableVertexAttribArray(Vertex::aPosition);
-		glVertexAttribPointer(Vertex::aPosition, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)pOffset);
-		glEnableVertexAttribArray(Vertex::aNormal);
-		glVertexAttribPointer(Vertex::aNormal, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)nOffset);
-		glEnableVertexAttribArray(Vertex::aTexcoord);
-		glVertexAttribPointer(Vertex::aTexcoord, 4, GL_FLOAT, GL_FALSE, vertMemSize, (void*)tOffset);
-		glEnableVertexAttribArray(Vertex::aTangent);
-		glVertexAttribPointer(Vertex::aTangent, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)tanOffset);
-		glEnableVertexAttribArray(Vertex::aBitangent);
-		glVertexAttribPointer(Vertex::aBitangent, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)bOffset);*/
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// 2. EBO
 		GLuint index[] = { 0, 1, 2 };
 
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.upload(copy, 3, index, sizeof(index) / sizeof(GLuint));
 
 		// 3. faceNum
 		render.option.drawNum = 1;
@@ -231,13 +197,6 @@ namespace ME {
 		return render;
 	}
 	TriRender TriRender::createQuad(const Vertex vert[4], bool computeNormal, bool computeTangentSpace) noexcept {
-		auto vertMemSize = Vertex::memSize();
-		auto pOffset = Vertex::positionOffset();
-		auto nOffset = Vertex::normalOffset();
-		auto tOffset = Vertex::texcoordOffset();
-		auto tanOffset = Vertex::tangentOffset();
-		auto bOffset = Vertex::bitangentOffset();
-
 		Vertex nvertices[6];
 		nvertices[0] = vert[0];
 		nvertices[1] = vert[1];
@@ -289,35 +248,10 @@ namespace ME {
 		}
 		
 		TriRender render;
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
-
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize * 6, nvertices, BUFFER_DATA_USAGE);
-
-		/*glEnableVertexAttribArray(Vertex::aPosition);
-		glVertexAttribPointer(Vertex::aPosition, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)pOffset);
-		glEnableVertexAttribArray(Vertex::aNormal);
-		glVertexAttribPointer(Vertex::aNormal, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)nOffset);
-		glEnableVertexAttribArray(Vertex::aTexcoord);
-		glVertexAttribPointer(Vertex::aTexcoord, 4, GL_FLOAT, GL_FALSE, vertMemSize, (void*)tOffset);
-		glEnableVertexAttribArray(Vertex::aTangent);
-		glVertexAttribPointer(Vertex::aTangent, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)tanOffset);
-		glEnableVertexAttribArray(Vertex::aBitangent);
-		glVertexAttribPointer(Vertex::aBitangent, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)bOffset);*/
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-		// 2. EBO
 		GLuint index[] = { 0, 1, 2, 3, 4, 5 };
 
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.upload(nvertices, 6, index, sizeof(index) / sizeof(GLuint));
 
 		// 3. faceNum
 		render.option.drawNum = 2;
@@ -333,6 +267,15 @@ namespace ME {
 		TriRender t = createQuad(vert, computeNormal);
 		return std::make_shared<TriRender>(t);
 	}
+	TriRender TriRender::createMesh(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept {
+		TriRender render;
+		render.upload(vertices.data(), vertices.size(), indices.data(), indices.size());
+		render.option.drawNum = (int)(indices.size() / 3);
+		return render;
+	}
+	TriRender::Ptr TriRender::createMeshPtr(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept {
+		return std::make_shared<TriRender>(createMesh(vertices, indices));
+	}
 
 	/*
 	TriRender TriRender::createCube(const glm::vec3& min, const glm::vec3& max) noexcept {
@@ -408,7 +351,8 @@ namespace ME {
 		// 1. VBO
 		glGenBuffers(1, &render.vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * 24, vertices, BUFFER_DATA_USAGE);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * 24, vertices, GL_STATIC_DRAW);
+		ResidencyManager::global().setBufferBytes(render.vbo, sizeof(Vertex) * 24);
 		glEnableVertexAttribArray(SHADER_POSITION_ATTR);
 		glVertexAttribPointer(SHADER_POSITION_ATTR, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
 		glEnableVertexAttribArray(SHADER_NORMAL_ATTR);
@@ -439,7 +383,8 @@ namespace ME {
 
 		glGenBuffers(1, &render.ebo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, GL_STATIC_DRAW);
+		ResidencyManager::global().setBufferBytes(render.ebo, sizeof(index));
 
 		glBindVertexArray(0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
@@ -547,7 +492,8 @@ namespace ME {
 		// 1. VBO
 		glGenBuffers(1, &render.vbo);
 		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize * vertices.size(), vertices.data(), BUFFER_DATA_USAGE);
+		glBufferData(GL_ARRAY_BUFFER, vertMemSize * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		ResidencyManager::global().setBufferBytes(render.vbo, vertMemSize * vertices.size());
 		glEnableVertexAttribArray(SHADER_POSITION_ATTR);
 		glVertexAttribPointer(SHADER_POSITION_ATTR, 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)pOffset);
 		glEnableVertexAttribArray(SHADER_NORMAL_ATTR);
@@ -561,7 +507,8 @@ namespace ME {
 
 		glGenBuffers(1, &render.ebo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * triangles.size() * 3, index, BUFFER_DATA_USAGE);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * triangles.size() * 3, index, GL_STATIC_DRAW);
+		ResidencyManager::global().setBufferBytes(render.ebo, sizeof(GLuint) * triangles.size() * 3);
 
 		glBindVertexArray(0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
@@ -592,13 +539,6 @@ namespace ME {
 
 	// QuadRender
 	QuadRender QuadRender::createQuad(const Vertex vertices[4]) noexcept {
-		const static auto vertMemSize = vertices[0].memSize();
-		const static auto pOffset = vertices[0].positionOffset();
-		const static auto nOffset = vertices[0].normalOffset();
-		const static auto tOffset = vertices[0].texcoordOffset();
-		const static auto tanOffset = vertices[0].tangentOffset();
-		const static auto bOffset = vertices[0].bitangentOffset();
-
 		glm::vec3 tangent, bitangent;
 		computeTangentSpace(
 			vertices[1].position - vertices[0].position,
@@ -615,24 +555,9 @@ namespace ME {
 		}
 		
 		QuadRender render;
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
-
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize * 4, copy, BUFFER_DATA_USAGE);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// 2. EBO
 		GLuint index[] = { 0, 1, 2, 3 };
 
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.uploadQuads(copy, 4, index, sizeof(index) / sizeof(GLuint));
 
 		// 3. faceNum
 		render.option.drawNum = 1;
@@ -640,13 +565,6 @@ namespace ME {
 		return render;
 	}
 	QuadRender QuadRender::createCube(const Vertex& min, const Vertex& max) noexcept {
-		const static auto vertMemSize = Vertex::memSize();
-		const static auto pOffset = Vertex::positionOffset();
-		const static auto nOffset = Vertex::normalOffset();
-		const static auto tOffset = Vertex::texcoordOffset();
-		const static auto tanOffset = Vertex::tangentOffset();
-		const static auto bOffset = Vertex::bitangentOffset();
-
 		auto minpX = min.position[0];
 		auto minpY = min.position[1];
 		auto minpZ = min.position[2];
@@ -716,44 +634,20 @@ namespace ME {
 		vert[23].normal = glm::vec3(0, 0, -1);
 
 		QuadRender render;
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
-
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, vertMemSize * 24, vert, BUFFER_DATA_USAGE);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// 2. EBO
 		GLuint index[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23 };
 
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index), index, BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.uploadQuads(vert, 24, index, sizeof(index) / sizeof(GLuint));
 
 		// 3. faceNum
-		render.option.drawNum = 24;
+		render.option.drawNum = 6;
 
 		return render;
 	}
 	QuadRender QuadRender::createSurface(const VertexMap& vertexMap) noexcept {
 		QuadRender render;
-		glGenVertexArrays(1, &render.vao);
-		glBindVertexArray(render.vao);
 
 		auto vertexArray = vertexMap.toArray();
 
-		// 1. VBO
-		glGenBuffers(1, &render.vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, render.vbo);
-		glBufferData(GL_ARRAY_BUFFER, Vertex::memSize() * vertexArray.size(), vertexArray.data(), BUFFER_DATA_USAGE);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-		// 2. EBO
 		int rowNum = vertexMap.row();
 		int colNum = vertexMap.col();
 
@@ -771,12 +665,7 @@ namespace ME {
 			}
 		}
 
-		glGenBuffers(1, &render.ebo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * index.size(), index.data(), BUFFER_DATA_USAGE);
-
-		glBindVertexArray(0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+		render.uploadQuads(vertexArray.data(), vertexArray.size(), index.data(), index.size());
 
 		// 3. faceNum
 		render.option.drawNum = (rowNum - 1) * (colNum - 1);
@@ -792,5 +681,96 @@ namespace ME {
 	QuadRender::Ptr QuadRender::createSurfacePtr(const VertexMap& vertexMap) noexcept {
 		return std::make_shared<QuadRender>(createSurface(vertexMap));
 	}
+	QuadRender QuadRender::createMesh(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept {
+		QuadRender render;
+		render.uploadQuads(vertices.data(), vertices.size(), indices.data(), indices.size());
+		render.option.drawNum = (int)(indices.size() / 4);
+		return render;
+	}
+	QuadRender::Ptr QuadRender::createMeshPtr(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept {
+		return std::make_shared<QuadRender>(createMesh(vertices, indices));
+	}
 	
+
+	// DynamicRender
+	DynamicRender DynamicRender::create(int type, size_t maxVertexNum, size_t maxIndexNum) {
+		if (type < POINT_RENDER_TYPE || type > QUAD_RENDER_TYPE)
+			throw(std::runtime_error("[DYNAMIC RENDER ERROR] : Invalid render type"));
+
+		DynamicRender render;
+		render.primitiveType = type;
+		render.vertexStream = std::make_shared<StreamBuffer>(StreamBuffer::create(Vertex::memSize() * maxVertexNum));
+		// Quads are followed by their triangles, see [ Render::uploadQuads() ]
+		const size_t indexCapacity = (type == QUAD_RENDER_TYPE ? maxIndexNum + maxIndexNum / 4 * 6 : maxIndexNum);
+		render.indexStream = std::make_shared<StreamBuffer>(StreamBuffer::create(sizeof(GLuint) * indexCapacity));
+		render.option.drawNum = 0;
+
+		// Attribute pointers are set by shaders, VAO only has to remember EBO.
+		glGenVertexArrays(1, &render.vao);
+		glBindVertexArray(render.vao);
+		render.vbo = render.vertexStream->getBuffer();
+		render.ebo = render.indexStream->getBuffer();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.ebo);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);	// @WARNING : EBO must be unbound after VAO is unbounded.
+
+		return render;
+	}
+	DynamicRender::Ptr DynamicRender::createPtr(int type, size_t maxVertexNum, size_t maxIndexNum) {
+		DynamicRender d = create(type, maxVertexNum, maxIndexNum);
+		return std::make_shared<DynamicRender>(d);
+	}
+	void DynamicRender::write(const Vertex* vertices, size_t vertexNum, const uint* indices, size_t indexNum) {
+		// Previous frame's draw calls are issued by now, so its segments can be fenced.
+		vertexStream->nextFrame();
+		indexStream->nextFrame();
+
+		const auto vertMemSize = Vertex::memSize();
+		const size_t triangleNum = (primitiveType == QUAD_RENDER_TYPE ? indexNum / 4 * 6 : 0);
+		size_t vertexOffset, indexOffset;
+		void* vertexPtr = vertexStream->map(vertMemSize * vertexNum, vertMemSize, vertexOffset);
+		void* indexPtr = indexStream->map(sizeof(GLuint) * (indexNum + triangleNum), sizeof(GLuint), indexOffset);
+		if (vertexPtr == nullptr || indexPtr == nullptr) {
+			if (vertexPtr != nullptr)
+				vertexStream->unmap();
+			if (indexPtr != nullptr)
+				indexStream->unmap();
+			throw(std::runtime_error("[DYNAMIC RENDER ERROR] : Geometry is larger than the stream buffer"));
+		}
+		memcpy(vertexPtr, vertices, vertMemSize * vertexNum);
+		memcpy(indexPtr, indices, sizeof(GLuint) * indexNum);
+		if (triangleNum > 0)
+			triangulateQuads(indices, indexNum, (uint*)indexPtr + indexNum);
+		vertexStream->unmap();
+		indexStream->unmap();
+
+		baseVertex = vertexOffset / vertMemSize;
+		firstIndex = indexOffset / sizeof(GLuint);
+		triangleFirst = (triangleNum > 0 ? indexNum : 0);
+		revision++;
+
+		// [ drawNum ] counts primitives for faces, and indices for points and lines.
+		if (primitiveType == TRI_RENDER_TYPE)
+			option.drawNum = (int)(indexNum / 3);
+		else if (primitiveType == QUAD_RENDER_TYPE)
+			option.drawNum = (int)(indexNum / 4);
+		else
+			option.drawNum = (int)indexNum;
+	}
+	void DynamicRender::destroy() {
+		releaseTextures();
+		// Other copies of this render share the streams, so only the first destroy() releases them.
+		if (vertexStream != nullptr && vertexStream->getBuffer() != 0) {
+			vertexStream->destroy();
+			indexStream->destroy();
+			glDeleteVertexArrays(1, &vao);
+		}
+		vao = 0;
+		vbo = 0;
+		ebo = 0;
+	}
+	void DynamicRender::drawElements(uint mode, int count, size_t first) const {
+		auto indexOffset = (void*)(sizeof(GLuint) * (firstIndex + first));
+		glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_INT, indexOffset, (GLint)baseVertex);
+	}
 }
\ No newline at end of file
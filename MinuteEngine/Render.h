@@ -14,10 +14,12 @@
 #endif
 
 #include "Utils.h"
+#include "Buffer.h"
 #include "Color.h"
 #include "Geometry.h"
 #include "Material.h"
 #include "Texture.h"
+#include "Residency.h"
 #include "glm/vec3.hpp"
 #include "glm/mat4x4.hpp"
 #include <memory>
@@ -105,6 +107,21 @@ namespace ME {
 		struct Texture2D {
 			ME::Texture2D texture;
 			bool valid = false;
+			std::shared_ptr<const ME::Texture2D> handle;	// Keeps [ texture ] alive if it comes from [ TextureManager ]
+
+			inline void set(const std::shared_ptr<const ME::Texture2D>& handle) {
+				this->handle = handle;
+				texture = *handle;
+				valid = true;
+			}
+			inline void release() {
+				handle.reset();
+				valid = false;
+			}
+
+			// Sampling, see [ ME::Texture2D::sampler() ]
+			int filter = TEXTURE_FILTER_TRILINEAR;
+			float anisotropy = TEXTURE_DEF_ANISOTROPY;
 		};
 
 		struct Option {
@@ -131,6 +148,10 @@ namespace ME {
 			Texture2D specularMap;
 			Texture2D normalMap;
 			Texture2D parallaxMap;
+			// Packed maps, see [ ME::Texture2D::createPacked() ] : specular comes from alpha of [ diffuseMap ],
+			// height from blue of [ normalMap ]. Their own maps still need to be valid, but are not bound.
+			bool specularPacked = false;
+			bool parallaxPacked = false;
 
 			// Parallax mapping
 			int pmMode = 1;				// 0 : Single sampling
@@ -150,17 +171,45 @@ namespace ME {
 		uint vao = 0;
 		uint vbo = 0;
 		uint ebo = 0;
+		BufferArena::RangePtr range = nullptr;	// Location in [ BufferArena ], nullptr if this render owns its buffers
 		Option option;
+		uint revision = 0;						// Increased whenever geometry is replaced
+		size_t triangleFirst = 0;				// Quads only : first index of the same quads split into triangles, 0 if there are none
+
+		// Copy geometry into [ BufferArena ] and share the pool's VAO, VBO and EBO.
+		void upload(const Vertex* vertices, size_t vertexNum, const uint* indices, size_t indexNum);
+		// Same as [ upload() ] for quads, 4 indices per quad. Each quad is also uploaded as 2 triangles after them,
+		// for passes that take triangles only such as geometry shaders.
+		void uploadQuads(const Vertex* vertices, size_t vertexNum, const uint* indices, size_t indexNum);
+		// Write 6 indices into [ triangles ] for every 4 indices of [ quads ]
+		static void triangulateQuads(const uint* quads, size_t indexNum, uint* triangles);
 	public:
 		// Return type of this [ Render ]
 		inline virtual int type() const {
 			return DEF_RENDER_TYPE;
 		}
 
-		inline void destroy() {
-			glDeleteVertexArrays(1, &vao);
-			glDeleteBuffers(1, &vbo);
-			glDeleteBuffers(1, &ebo);
+		// Give back textures from [ TextureManager ], which deletes them once no render uses them
+		inline void releaseTextures() {
+			option.diffuseMap.release();
+			option.specularMap.release();
+			option.normalMap.release();
+			option.parallaxMap.release();
+		}
+		inline virtual void destroy() {
+			releaseTextures();
+			if (range != nullptr) {
+				// Pool buffers are shared, only give back our part of them.
+				BufferArena::global().free(range);
+				range = nullptr;
+			}
+			else {
+				glDeleteVertexArrays(1, &vao);
+				glDeleteBuffers(1, &vbo);
+				glDeleteBuffers(1, &ebo);
+				ResidencyManager::global().eraseBuffer(vbo);
+				ResidencyManager::global().eraseBuffer(ebo);
+			}
 			vao = 0;
 			vbo = 0;
 			ebo = 0;
@@ -176,6 +225,19 @@ namespace ME {
 			return ebo;
 		}
 
+		inline const BufferArena::RangePtr& getRange() const noexcept {
+			return range;
+		}
+
+		inline uint getRevision() const noexcept {
+			return revision;
+		}
+		// Index to give to [ drawElements() ] to draw quads as GL_TRIANGLES, 6 indices per quad.
+		// 0 if this render has no triangles for its quads.
+		inline size_t getTriangleFirst() const noexcept {
+			return triangleFirst;
+		}
+
 		inline void setVAO(uint vao) noexcept {
 			this->vao = vao;
 		}
@@ -201,6 +263,11 @@ namespace ME {
 			const glm::vec2& aTVec, const glm::vec2& bTVec,
 			glm::vec3& tan, glm::vec3& btan);
 
+		// Issue glDrawElements() for [ count ] indices of this render, wherever its geometry lives.
+		// @mode : GL_POINTS, GL_LINES, GL_TRIANGLES, GL_QUADS
+		// @first : First index to draw, relative to the render
+		virtual void drawElements(uint mode, int count, size_t first = 0) const;
+
 		virtual void drawUI(bool update);
 	};
 
@@ -245,6 +312,10 @@ namespace ME {
 
 		static Ptr createTrianglePtr(const Vertex vert[3], bool computeNormal = true, bool computeTangentSpace = true) noexcept;
 		static Ptr createQuadPtr(const Vertex vert[4], bool computeNormal = true, bool computeTangentSpace = true) noexcept;
+
+		// Triangle list given as is, 3 indices per triangle.
+		static TriRender createMesh(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept;
+		static Ptr createMeshPtr(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept;
 	};
 
 	class QuadRender : public Render {
@@ -262,6 +333,47 @@ namespace ME {
 		static Ptr createQuadPtr(const Vertex vertices[4]) noexcept;
 		static Ptr createCubePtr(const Vertex& min, const Vertex& max) noexcept;
 		static Ptr createSurfacePtr(const VertexMap& vertexMap) noexcept;
+
+		// Quad list given as is, 4 indices per quad.
+		static QuadRender createMesh(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept;
+		static Ptr createMeshPtr(const std::vector<Vertex>& vertices, const std::vector<uint>& indices) noexcept;
+	};
+
+	// Render whose geometry is rewritten every frame, such as deforming surfaces or debug geometry.
+	// Vertices and indices are streamed through [ StreamBuffer ]s instead of living in [ BufferArena ].
+	class DynamicRender : public Render {
+	private:
+		int primitiveType = TRI_RENDER_TYPE;
+		std::shared_ptr<StreamBuffer> vertexStream = nullptr;
+		std::shared_ptr<StreamBuffer> indexStream = nullptr;
+		size_t baseVertex = 0;
+		size_t firstIndex = 0;
+
+		DynamicRender() = default;
+	public:
+		using Ptr = std::shared_ptr<DynamicRender>;
+
+		inline virtual int type() const {
+			return primitiveType;
+		}
+		// @type : One of POINT_RENDER_TYPE, LINE_RENDER_TYPE, TRI_RENDER_TYPE, QUAD_RENDER_TYPE
+		// @maxVertexNum, maxIndexNum : Maximum size of geometry written in a single frame
+		static DynamicRender create(int type, size_t maxVertexNum, size_t maxIndexNum);
+		static Ptr createPtr(int type, size_t maxVertexNum, size_t maxIndexNum);
+
+		// Replace geometry of this render. Call at most once per frame, before it is drawn.
+		// @indices : Local to [ vertices ], i.e. starts from 0.
+		void write(const Vertex* vertices, size_t vertexNum, const uint* indices, size_t indexNum);
+
+		inline const StreamBuffer& getVertexStreamC() const noexcept {
+			return *vertexStream;
+		}
+		inline const StreamBuffer& getIndexStreamC() const noexcept {
+			return *indexStream;
+		}
+
+		virtual void destroy();
+		virtual void drawElements(uint mode, int count, size_t first = 0) const;
 	};
 }
 #endif
\ No newline at end of file
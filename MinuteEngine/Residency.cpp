@@ -0,0 +1,99 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "Residency.h"
+#include "Texture.h"
+#include "TextureManager.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+
+#include <sstream>
+
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX		0x9047
+#endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI					0x87FC
+#endif
+
+namespace ME {
+	ResidencyManager& ResidencyManager::global() {
+		static ResidencyManager manager;
+		return manager;
+	}
+	size_t ResidencyManager::detectMemory() {
+		// Both report kilobytes
+		if (GLEW_NVX_gpu_memory_info) {
+			GLint kb = 0;
+			glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &kb);
+			return (size_t)kb * 1024;
+		}
+		if (GLEW_ATI_meminfo) {
+			// There is no query for total memory, add back what this process holds to the free memory
+			GLint info[4] = { 0 };		// Total free, largest free block, total auxiliary free, largest auxiliary free
+			glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info);
+			return (size_t)info[0] * 1024 + global().getTotalBytes();
+		}
+		return 0;
+	}
+
+	void ResidencyManager::setBufferBytes(uint buffer, size_t bytes) {
+		auto& b = bufferBytes[buffer];
+		totalBufferBytes = totalBufferBytes - b + bytes;
+		b = bytes;
+	}
+	void ResidencyManager::eraseBuffer(uint buffer) {
+		auto it = bufferBytes.find(buffer);
+		if (it == bufferBytes.end())
+			return;
+		totalBufferBytes -= it->second;
+		bufferBytes.erase(it);
+	}
+	void ResidencyManager::setTargetBytes(uint texture, size_t bytes) {
+		auto& t = targetBytes[texture];
+		totalTargetBytes = totalTargetBytes - t + bytes;
+		t = bytes;
+	}
+	void ResidencyManager::eraseTarget(uint texture) {
+		auto it = targetBytes.find(texture);
+		if (it == targetBytes.end())
+			return;
+		totalTargetBytes -= it->second;
+		targetBytes.erase(it);
+	}
+	size_t ResidencyManager::getTextureBytes() const {
+		return Texture2D::getTotalBytes();
+	}
+
+	void ResidencyManager::update() {
+		if (budget > 0) {
+			// Textures being demoted are counted at their new size, so that they are not trimmed twice
+			auto& textures = TextureManager::global();
+			const size_t managedBytes = textures.getResidentBytes();
+			const size_t total = Texture2D::getTotalBytes() - managedBytes + textures.getExpectedBytes() + totalTargetBytes + totalBufferBytes;
+			if (total > budget) {
+				overBudgetFrameNum++;
+				if (frame > graceFrames)
+					trimmedBytes += textures.trim(total - budget, frame - graceFrames);
+			}
+		}
+		frame++;
+	}
+	std::string ResidencyManager::getReport() const {
+		std::ostringstream ss;
+		ss << getTextureBytes() / 1024 << " KiB textures, " << totalTargetBytes / 1024 << " KiB render targets, " <<
+			totalBufferBytes / 1024 << " KiB buffers";
+		if (budget > 0)
+			ss << " of " << budget / 1024 << " KiB budget, over it in " << overBudgetFrameNum << " frames, " <<
+				trimmedBytes / 1024 << " KiB trimmed";
+		else
+			ss << ", no budget";
+		return ss.str();
+	}
+}
\ No newline at end of file
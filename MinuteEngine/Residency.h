@@ -0,0 +1,100 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_RESIDENCY_H__
+#define __ME_RESIDENCY_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include <string>
+#include <unordered_map>
+
+#define RESIDENCY_DEF_GRACE_FRAMES		60		// Resources drawn within this many frames are never demoted or evicted
+#define RESIDENCY_DEF_BUDGET_RATIO		0.75f	// Default budget, of the detected video memory
+
+namespace ME {
+	// GPU memory of textures, render targets and buffers, kept under a budget. Every texture upload, render target
+	// and buffer allocation is counted here. When the total is over budget, textures of [ TextureManager ] that have not
+	// been drawn for a while are demoted to smaller mip levels, then evicted to their placeholders, least recently
+	// drawn first. Drawing them again streams them back in at full size. Render targets and buffers count toward
+	// the budget but are not evicted, since they have no source to load them again from.
+	class ResidencyManager {
+	private:
+		size_t budget = 0;				// In bytes, 0 for no limit
+		uint frame = 1;
+		uint graceFrames = RESIDENCY_DEF_GRACE_FRAMES;
+
+		std::unordered_map<uint, size_t> bufferBytes;
+		size_t totalBufferBytes = 0;
+		std::unordered_map<uint, size_t> targetBytes;
+		size_t totalTargetBytes = 0;
+
+		size_t trimmedBytes = 0;
+		uint overBudgetFrameNum = 0;
+	public:
+		static ResidencyManager& global();
+		// Video memory in bytes : dedicated memory from NVX_gpu_memory_info, or from ATI_meminfo, which only reports
+		// free memory, the free texture memory plus what is counted here already. Call it early, so that the latter
+		// is close to the memory this process can use. 0 if neither is supported.
+		static size_t detectMemory();
+
+		inline void setBudget(size_t bytes) noexcept {
+			budget = bytes;
+		}
+		inline size_t getBudget() const noexcept {
+			return budget;
+		}
+		// Budget of [ ratio ] of [ detectMemory() ], or no limit if it is unknown
+		inline void setBudgetRatio(float ratio = RESIDENCY_DEF_BUDGET_RATIO) {
+			budget = (size_t)((double)detectMemory() * ratio);
+		}
+		inline void setGraceFrames(uint frames) noexcept {
+			graceFrames = frames;
+		}
+		inline uint getFrame() const noexcept {
+			return frame;
+		}
+
+		// Buffers
+		// Count [ bytes ] for GL [ buffer ], replacing what was counted for it before
+		void setBufferBytes(uint buffer, size_t bytes);
+		void eraseBuffer(uint buffer);
+		inline size_t getBufferBytes() const noexcept {
+			return totalBufferBytes;
+		}
+		size_t getTextureBytes() const;
+
+		// Render targets : textures drawn into, which [ Texture2D ] does not count
+		// Count [ bytes ] for GL [ texture ] with every level and layer, replacing what was counted for it before
+		void setTargetBytes(uint texture, size_t bytes);
+		void eraseTarget(uint texture);
+		inline size_t getTargetBytes() const noexcept {
+			return totalTargetBytes;
+		}
+
+		inline size_t getTotalBytes() const {
+			return getTextureBytes() + totalTargetBytes + totalBufferBytes;
+		}
+
+		// Trim textures if over budget, and start a new frame. Call once per frame on GL thread, after drawing.
+		void update();
+
+		inline size_t getTrimmedBytes() const noexcept {
+			return trimmedBytes;
+		}
+		inline uint getOverBudgetFrameNum() const noexcept {
+			return overBudgetFrameNum;
+		}
+		std::string getReport() const;
+	};
+}
+
+#endif
\ No newline at end of file
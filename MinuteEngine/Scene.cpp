@@ -60,6 +60,10 @@ namespace ME {
             }
         }
         graph.clear();
+        staticBatch.destroy();
+        staticNum = 0;
+        if (lightManager.atlas.getValid())
+            lightManager.atlas.destroy();
     }
     Scene::Graph& Scene::getGraph() noexcept {
         return graph;
@@ -79,6 +83,27 @@ namespace ME {
     const Scene::Skybox& Scene::getSkyboxC() const noexcept {
         return skybox;
     }
+    void Scene::bake() {
+        staticBatch.bake(*this);
+        countStaticObjects();
+    }
+    bool Scene::hasStaticObject() const noexcept {
+        return staticNum > 0;
+    }
+    void Scene::countStaticObjects() {
+        staticNum = 0;
+        for (const auto& node : graph) {
+            if (node.second.getObjectC()->getStatic())
+                staticNum++;
+        }
+        staticRevision = Object::getStaticRevision();
+    }
+    StaticBatch& Scene::getStaticBatch() noexcept {
+        return staticBatch;
+    }
+    const StaticBatch& Scene::getStaticBatchC() const noexcept {
+        return staticBatch;
+    }
 
     Scene::Node& Scene::getNode(int id) {
         return graph.at(id);
@@ -104,8 +129,13 @@ namespace ME {
         }
 
         // Delete from graph
+        bool isStatic = node.getObjectC()->getStatic();
         delObjectProperties(id);
         graph.erase(id);
+        if (staticRevision != Object::getStaticRevision())
+            countStaticObjects();
+        else if (isStatic)
+            staticNum--;
     }
     void Scene::connect(int childID, int parentID) {
         Node& node = graph.at(childID);
@@ -128,6 +158,10 @@ namespace ME {
         else
             connect(id, parent);
 
+        if (staticRevision != Object::getStaticRevision())
+            countStaticObjects();
+        else if (object->getStatic())
+            staticNum++;
         return id;
     }
     void Scene::addObjectProperty(int id, const std::shared_ptr<Property>& property) {
@@ -138,10 +172,21 @@ namespace ME {
     void Scene::delObjectProperty(const Object::Ptr& object, int propertyID) {
         auto prop = object->getProperty(propertyID);
         auto render = prop->getRender();
-        bool memDuplicate = checkDuplicateMemory(render->getVAO(), render->getVBO(), render->getEBO());
+        if (render == nullptr) {
+            object->delProperty(propertyID);
+            return;
+        }
+        bool memDuplicate = (render->getRange() != nullptr) ?
+            checkDuplicateMemory(render) :
+            checkDuplicateMemory(render->getVAO(), render->getVBO(), render->getEBO());
+        bool merged = staticBatch.contains(*render);
         if (!memDuplicate)
             render->destroy();
         object->delProperty(propertyID);
+
+        // Merged geometry still holds the deleted render
+        if (merged)
+            bake();
     }
     void Scene::delObjectProperty(int objectID, int propertyID) {
         auto& node = graph.at(objectID);
@@ -170,10 +215,28 @@ namespace ME {
         }
         return false;
     }
+    bool Scene::checkDuplicateMemory(const Render::Ptr& render) {
+        for (auto node : graph) {
+            auto& props = node.second.getObjectC()->getPropertiesC();
+            for (auto prop : props) {
+                auto renderPtr = prop.second->getRenderC();
+                if (renderPtr == nullptr || renderPtr == render)
+                    continue;
+                if (renderPtr->getRange() == render->getRange())
+                    return true;
+            }
+        }
+        return false;
+    }
     void Scene::update(double deltaTime) {
         for (auto node : graph) {
             auto& object = node.second.getObject();
             object->update(deltaTime);
         }
+        // An object became static or dynamic since the last bake
+        if (staticBatch.outdated())
+            bake();
+        else if (staticRevision != Object::getStaticRevision())
+            countStaticObjects();
     }
 }
\ No newline at end of file
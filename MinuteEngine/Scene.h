@@ -17,6 +17,7 @@
 #include "Object.h"
 #include "Light.h"
 #include "Texture.h"
+#include "StaticBatch.h"
 
 namespace ME {
 	class Scene {
@@ -47,13 +48,14 @@ namespace ME {
             TextureCube texture;
             bool valid = false;
 
-            inline static Skybox create(const std::string path[6]) {
+            // @stream : Load cube map through [ TextureStreamer ]
+            inline static Skybox create(const std::string path[6], bool stream = false) {
                 Skybox skybox;
                 Render::Vertex min, max;
                 min.position = { -1, -1, -1 };
                 max.position = { 1, 1, 1 };
                 skybox.cube = QuadRender::createCubePtr(min, max);
-                skybox.texture = TextureCube::create(path);
+                skybox.texture = (stream ? TextureCube::createAsync(path) : TextureCube::create(path));
                 return skybox;
             }
         };
@@ -64,6 +66,10 @@ namespace ME {
         int root = -1;
         LightManager lightManager;
         Skybox skybox;
+        StaticBatch staticBatch;
+        int staticNum = 0;          // Number of static objects in [ graph ]
+        uint staticRevision = 0;    // [ Object::getStaticRevision() ] when [ staticNum ] was counted
+        bool deferred = false;      // Draw with deferred shading instead of forward shading
         Scene() = default;
     public:
         static Scene create();
@@ -82,6 +88,22 @@ namespace ME {
         Skybox& getSkybox() noexcept;
         const Skybox& getSkyboxC() const noexcept;
 
+        // Merge renders of static objects to reduce draw calls.
+        // Once baked, [ update() ] bakes again when an object becomes static or dynamic, and deleting a merged property bakes again at once.
+        void bake();
+        // True if any object is static. Kept by adding and deleting nodes, [ setStatic() ] is caught by [ update() ] and [ bake() ].
+        bool hasStaticObject() const noexcept;
+        StaticBatch& getStaticBatch() noexcept;
+        const StaticBatch& getStaticBatchC() const noexcept;
+
+        // Deferred shading pays lighting once per pixel, better for scenes with much overdraw and many lights.
+        inline void setDeferred(bool deferred) noexcept {
+            this->deferred = deferred;
+        }
+        inline bool getDeferred() const noexcept {
+            return deferred;
+        }
+
         Node& getNode(int id);
         const Node& getNodeC(int id) const;
         void delNode(int id);
@@ -94,10 +116,17 @@ namespace ME {
         void delObjectProperty(const Object::Ptr& object, int propertyID);
         void delObjectProperty(int objectID, int propertyID);
         void delObjectProperties(int objectID);
+    private:
+        // Count static objects again, when any of them became static or dynamic
+        void countStaticObjects();
+    public:
 
         // For all the [ Render ]s in this scene, check if any of them has same memory as given arguments.
         // If not, we can safely destroy those memories.
         bool checkDuplicateMemory(uint vao, uint vbo, uint ebo);
+        // Same as above for [ Render ]s placed in [ BufferArena ] : their buffers are always shared,
+        // so check if any other [ Render ] holds the same range of the arena.
+        bool checkDuplicateMemory(const Render::Ptr& render);
 
         void update(double deltaTime);
 	};
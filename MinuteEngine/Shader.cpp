@@ -8,13 +8,311 @@
 
 #include "Shader.h"
 #include "IO.h"
+#include "AsyncIO.h"
 #include "glm/gtc/type_ptr.hpp"
 
 #include <iostream>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <unordered_map>
+#include <vector>
 #include <GL/glew.h>
 #include <SDL_opengl.h>
 
 namespace ME {
+    // Insert [ header ] after #version line, which must stay the first directive of [ source ]
+    static std::string insertHeader(const std::string& source, const std::string& header) {
+        if (header.empty())
+            return source;
+        size_t pos = source.find("#version");
+        if (pos == std::string::npos)
+            return header + source;
+        pos = source.find('\n', pos);
+        if (pos == std::string::npos)
+            return source + "\n" + header;
+        return source.substr(0, pos + 1) + header + source.substr(pos + 1);
+    }
+
+    // Source preload
+    static std::unordered_map<std::string, std::shared_future<AsyncIO::Result>> preloadedSources;
+
+    void Shader::preloadSources(const std::vector<std::string>& paths) {
+        for (const auto& path : paths)
+            if (preloadedSources.find(path) == preloadedSources.end())
+                preloadedSources[path] = AsyncIO::global().read(path, ASYNC_IO_PRIORITY_VISIBLE).share();
+    }
+    std::string Shader::readSource(const std::string& path) {
+        auto
+            it = preloadedSources.find(path);
+        if (it == preloadedSources.end())
+            return IO::read_text(path);
+        const AsyncIO::Result&
+            result = it->second.get();
+        if (!result.valid)
+            throw(std::runtime_error(std::string("Cannot find ") + path));
+        return std::string(result.data.data(), result.data.size());
+    }
+
+    // Program binary cache
+    static std::string programCacheDir = "Shader/cache/";
+    static uint programCacheHitNum = 0;
+    static uint programCacheMissNum = 0;
+
+    struct ProgramBinaryHeader {
+        char            magic[4];       // "MEPB"
+        std::uint32_t   version;
+        std::uint64_t   key;
+        std::uint32_t   format;
+        std::uint32_t   size;
+    };
+    static const std::uint32_t programBinaryVersion = 1;
+
+    // FNV-1a
+    static void hashString(std::uint64_t& hash, const std::string& str) {
+        for (unsigned char c : str) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xff;       // Separator, so that ( "ab", "c" ) and ( "a", "bc" ) differ
+        hash *= 1099511628211ull;
+    }
+    static std::string glString(GLenum name) {
+        const GLubyte* str = glGetString(name);
+        return (str == nullptr ? std::string() : std::string((const char*)str));
+    }
+    // Compile status is not queried here, so that driver can compile in the background
+    static uint issueCompile(GLenum type, const std::string& source) {
+        const GLchar
+            * glshader = source.c_str();
+        GLuint
+            id = glCreateShader(type);
+        glShaderSource(id, 1, &glshader, NULL);
+        glCompileShader(id);
+        return id;
+    }
+    static void checkCompile(uint id, GLenum type) {
+        int
+            success;
+        char
+            infoLog[512];
+        glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(id, 512, NULL, infoLog);
+            throw(std::runtime_error(std::string("[SHADER ERROR] : ") +
+                (type == GL_VERTEX_SHADER ? "Vertex" : (type == GL_GEOMETRY_SHADER ? "Geometry" : "Fragment")) +
+                std::string(" shader compilation failed\n") +
+                std::string("[COMPILATION ERROR MESSAGE] : \n") +
+                std::string(infoLog)));
+        }
+    }
+    // Program from [ data ] saved by [ saveProgramBinary() ], 0 if it does not match [ key ] or driver rejects it
+    static uint loadProgramBinary(const std::vector<char>& data, std::uint64_t key) {
+        ProgramBinaryHeader header;
+        if (data.size() < sizeof(header))
+            return 0;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, "MEPB", 4) != 0 || header.version != programBinaryVersion || header.key != key ||
+            data.size() != sizeof(header) + header.size)
+            return 0;
+
+        GLuint
+            p = glCreateProgram();
+        glProgramBinary(p, header.format, data.data() + sizeof(header), (GLsizei)header.size);
+        int
+            success;
+        glGetProgramiv(p, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(p);
+            return 0;
+        }
+        return p;
+    }
+    static void saveProgramBinary(const std::string& path, uint program, std::uint64_t key) {
+        GLint
+            size = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+        if (size <= 0)
+            return;
+        ProgramBinaryHeader header;
+        std::memcpy(header.magic, "MEPB", 4);
+        header.version = programBinaryVersion;
+        header.key = key;
+
+        std::vector<char>
+            data(sizeof(header) + size);
+        GLsizei
+            length = 0;
+        GLenum
+            format = 0;
+        glGetProgramBinary(program, size, &length, &format, data.data() + sizeof(header));
+        if (length <= 0)
+            return;
+        header.format = format;
+        header.size = (std::uint32_t)length;
+        std::memcpy(data.data(), &header, sizeof(header));
+        data.resize(sizeof(header) + length);
+        IO::write_binary(path, data.data(), data.size());
+    }
+
+    void Shader::setProgramCacheDir(const std::string& dir) {
+        programCacheDir = dir;
+        if (!programCacheDir.empty() && programCacheDir.back() != '/' && programCacheDir.back() != '\\')
+            programCacheDir += '/';
+    }
+    const std::string& Shader::getProgramCacheDir() noexcept {
+        return programCacheDir;
+    }
+    bool Shader::programBinarySupported() {
+        if (!GLEW_ARB_get_program_binary)
+            return false;
+        GLint
+            num = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num);
+        return num > 0;
+    }
+    uint Shader::getProgramCacheHitNum() noexcept {
+        return programCacheHitNum;
+    }
+    uint Shader::getProgramCacheMissNum() noexcept {
+        return programCacheMissNum;
+    }
+    uint Shader::createCachedProgram(const std::string& vpath, const std::string& fpath, const std::string& vheader, const std::string& fheader) {
+        AsyncProgram
+            async = createProgramAsync(vpath, fpath, vheader, fheader);
+        finishProgram(async);
+        return async.program;
+    }
+    uint Shader::createCachedGeomProgram(const std::string& vpath, const std::string& gpath, const std::string& fpath) {
+        AsyncProgram
+            async = issueProgram(readSource(vpath), readSource(gpath), readSource(fpath));
+        finishProgram(async);
+        return async.program;
+    }
+
+    // Asynchronous compile
+    bool Shader::parallelCompileSupported() {
+        static bool
+            init = false,
+            supported = false;
+        if (!init) {
+            init = true;
+            if (GLEW_KHR_parallel_shader_compile) {
+                glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);      // As many threads as driver likes
+                supported = true;
+            }
+            else if (GLEW_ARB_parallel_shader_compile) {
+                glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+                supported = true;
+            }
+        }
+        return supported;
+    }
+    Shader::AsyncProgram Shader::createProgramAsync(const std::string& vpath, const std::string& fpath, const std::string& vheader, const std::string& fheader) {
+        return issueProgram(insertHeader(readSource(vpath), vheader), "", insertHeader(readSource(fpath), fheader));
+    }
+    Shader::AsyncProgram Shader::issueProgram(const std::string& vsource, const std::string& gsource, const std::string& fsource) {
+        AsyncProgram
+            async;
+
+        // Binaries are only valid for the driver that made them
+        async.save = !programCacheDir.empty() && programBinarySupported();
+        if (async.save) {
+            std::uint64_t
+                key = 14695981039346656037ull;
+            hashString(key, glString(GL_VENDOR));
+            hashString(key, glString(GL_RENDERER));
+            hashString(key, glString(GL_VERSION));
+            hashString(key, vsource);
+            if (!gsource.empty())
+                hashString(key, gsource);
+            hashString(key, fsource);
+
+            char
+                name[32];
+            std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+            async.key = key;
+            async.path = programCacheDir + name;
+
+            std::vector<char>
+                data;
+            if (IO::read_binary(async.path, data)) {
+                async.program = loadProgramBinary(data, key);
+                if (async.program != 0) {
+                    programCacheHitNum++;
+                    async.ready = true;
+                    return async;
+                }
+            }
+            programCacheMissNum++;
+        }
+
+        parallelCompileSupported();
+        async.vert = issueCompile(GL_VERTEX_SHADER, vsource);
+        if (!gsource.empty())
+            async.geom = issueCompile(GL_GEOMETRY_SHADER, gsource);
+        async.frag = issueCompile(GL_FRAGMENT_SHADER, fsource);
+        async.program = glCreateProgram();
+        if (async.save)
+            glProgramParameteri(async.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(async.program, async.vert);
+        if (async.geom != 0)
+            glAttachShader(async.program, async.geom);
+        glAttachShader(async.program, async.frag);
+        glLinkProgram(async.program);
+        return async;
+    }
+    bool Shader::pollProgram(AsyncProgram& async) {
+        if (async.ready)
+            return true;
+        // GL_LINK_STATUS would wait for the link, so only [ finishProgram() ] queries it
+        if (!parallelCompileSupported())
+            return false;
+        GLint
+            done = GL_FALSE;
+        glGetProgramiv(async.program, GL_COMPLETION_STATUS_KHR, &done);
+        if (!done)
+            return false;
+        finishProgram(async);
+        return true;
+    }
+    void Shader::finishProgram(AsyncProgram& async) {
+        if (async.ready)
+            return;
+        int
+            success;
+        char
+            infoLog[512];
+        glGetProgramiv(async.program, GL_LINK_STATUS, &success);
+        if (!success) {
+            // Compile errors tell more than link error
+            checkCompile(async.vert, GL_VERTEX_SHADER);
+            if (async.geom != 0)
+                checkCompile(async.geom, GL_GEOMETRY_SHADER);
+            checkCompile(async.frag, GL_FRAGMENT_SHADER);
+            glGetProgramInfoLog(async.program, 512, NULL, infoLog);
+            throw(std::runtime_error(std::string("[SHADER ERROR] : Shader program linkage failed\n") +
+                std::string("[LINKAGE ERROR MESSAGE] : \n") +
+                std::string(infoLog)));
+        }
+        glDetachShader(async.program, async.vert);
+        glDetachShader(async.program, async.frag);
+        glDeleteShader(async.vert);
+        glDeleteShader(async.frag);
+        if (async.geom != 0) {
+            glDetachShader(async.program, async.geom);
+            glDeleteShader(async.geom);
+        }
+        async.vert = 0;
+        async.geom = 0;
+        async.frag = 0;
+        if (async.save)
+            saveProgramBinary(async.path, async.program, async.key);
+        async.ready = true;
+    }
+
     Shader Shader::create(const std::string& vpath, const std::string& fpath) {
         Shader s;
         s.vertShader = createVertShader(vpath);
@@ -23,15 +321,20 @@ namespace ME {
         return s;
     }
     void Shader::destroy(Shader& shader) {
-        glDetachShader(shader.getProgram(), shader.getVertShader());
-        glDetachShader(shader.getProgram(), shader.getFragShader());
-        glDeleteShader(shader.getVertShader());
-        glDeleteShader(shader.getFragShader());
+        // Programs from [ createCachedProgram() ] have no shader objects
+        if (shader.getVertShader() != 0) {
+            glDetachShader(shader.getProgram(), shader.getVertShader());
+            glDeleteShader(shader.getVertShader());
+        }
+        if (shader.getFragShader() != 0) {
+            glDetachShader(shader.getProgram(), shader.getFragShader());
+            glDeleteShader(shader.getFragShader());
+        }
         glDeleteProgram(shader.getProgram());
     }
 
     // Create ( Compile )
-    uint Shader::createVertShader(const std::string& path) {
+    uint Shader::createVertShader(const std::string& path, const std::string& header) {
         int
             success;
         char
@@ -39,7 +342,7 @@ namespace ME {
         GLuint
             id;
         std::string
-            shader = IO::read_text(path);
+            shader = insertHeader(readSource(path), header);
         const GLchar
             * glshader = shader.c_str();
         id = glCreateShader(GL_VERTEX_SHADER);
@@ -57,7 +360,7 @@ namespace ME {
         }
         return id;
     }
-    uint Shader::createFragShader(const std::string& path) {
+    uint Shader::createFragShader(const std::string& path, const std::string& header) {
         int
             success;
         char
@@ -65,7 +368,7 @@ namespace ME {
         GLuint
             id;
         std::string
-            shader = IO::read_text(path);
+            shader = insertHeader(readSource(path), header);
         const GLchar
             * glshader = shader.c_str();
         id = glCreateShader(GL_FRAGMENT_SHADER);
@@ -83,6 +386,32 @@ namespace ME {
         }
         return id;
     }
+    uint Shader::createGeomShader(const std::string& path, const std::string& header) {
+        int
+            success;
+        char
+            infoLog[512];
+        GLuint
+            id;
+        std::string
+            shader = insertHeader(readSource(path), header);
+        const GLchar
+            * glshader = shader.c_str();
+        id = glCreateShader(GL_GEOMETRY_SHADER);
+        glShaderSource(id, 1, &glshader, NULL);
+        glCompileShader(id);
+
+        glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+
+        if (!success)
+        {
+            glGetShaderInfoLog(id, 512, NULL, infoLog);
+            throw(std::runtime_error(std::string("[SHADER ERROR] : Geometry shader compilation failed\n") +
+                std::string("[COMPILATION ERROR MESSAGE] : \n") +
+                std::string(infoLog)));
+        }
+        return id;
+    }
     uint Shader::createProgram(uint vert, uint frag) {
         GLuint
             p = glCreateProgram();
@@ -102,6 +431,26 @@ namespace ME {
         }
         return p;
     }
+    uint Shader::createProgram(uint vert, uint geom, uint frag) {
+        GLuint
+            p = glCreateProgram();
+        glAttachShader(p, vert);
+        glAttachShader(p, geom);
+        glAttachShader(p, frag);
+        glLinkProgram(p);
+        int
+            success;
+        char
+            infoLog[512];
+        glGetProgramiv(p, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(p, 512, NULL, infoLog);
+            throw(std::runtime_error(std::string("[SHADER ERROR] : Shader program linkage failed\n") +
+                std::string("[LINKAGE ERROR MESSAGE] : \n") +
+                std::string(infoLog)));
+        }
+        return p;
+    }
     
     // Get
     uint Shader::getProgram() const noexcept {
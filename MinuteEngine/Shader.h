@@ -19,6 +19,8 @@
 #include "glm/vec3.hpp"
 #include "glm/mat4x4.hpp"
 #include <string>
+#include <cstdint>
+#include <vector>
 
 namespace ME {
     class Shader {
@@ -30,9 +32,60 @@ namespace ME {
         static Shader create(const std::string& vpath, const std::string& fpath);
         static void destroy(Shader& shader);
 
-        static uint createVertShader(const std::string& path);
-        static uint createFragShader(const std::string& path);
+        // @header : Lines inserted right after #version line of the source, such as #define directives
+        static uint createVertShader(const std::string& path, const std::string& header = "");
+        static uint createFragShader(const std::string& path, const std::string& header = "");
+        static uint createGeomShader(const std::string& path, const std::string& header = "");     // Needs OpenGL 3.2
+        // Source preload
+        // Start reading sources at [ paths ] through [ AsyncIO ], so that creating shaders from them later does not
+        // wait on disk one file at a time. Preloaded sources are kept, for variants that compile them again.
+        static void preloadSources(const std::vector<std::string>& paths);
+        // Source at [ path ], preloaded or read now. Throws if it cannot be read.
+        static std::string readSource(const std::string& path);
+
         static uint createProgram(uint vert, uint frag);
+        static uint createProgram(uint vert, uint geom, uint frag);
+
+        // Program binary cache
+        // Programs made by [ createCachedProgram() ] are saved in [ dir ] after linking, and loaded from there instead
+        // of compiling while their sources, headers and driver stay the same. Empty [ dir ] turns the cache off.
+        static void setProgramCacheDir(const std::string& dir);
+        static const std::string& getProgramCacheDir() noexcept;
+        static bool programBinarySupported();
+        // Program of vertex shader at [ vpath ] and fragment shader at [ fpath ], with headers as in [ createVertShader() ].
+        // Shader objects are deleted after linking, and not made at all when the program comes from the cache.
+        static uint createCachedProgram(const std::string& vpath, const std::string& fpath, const std::string& vheader = "", const std::string& fheader = "");
+        // Same as [ createCachedProgram() ], with geometry shader at [ gpath ].
+        static uint createCachedGeomProgram(const std::string& vpath, const std::string& gpath, const std::string& fpath);
+        static uint getProgramCacheHitNum() noexcept;
+        static uint getProgramCacheMissNum() noexcept;
+
+        // Asynchronous compile
+        // Program whose compile and link are issued, but not waited for.
+        struct AsyncProgram {
+            uint            program = 0;
+            uint            vert = 0;
+            uint            geom = 0;           // 0 if there is no geometry shader
+            uint            frag = 0;
+            bool            ready = false;      // Linked, [ program ] can be used
+            bool            save = false;       // Save binary to [ path ] once linked
+            std::uint64_t   key = 0;
+            std::string     path;
+        };
+        // True if GL_KHR_parallel_shader_compile ( or ARB ) is supported, then driver compiles on its own threads.
+        static bool parallelCompileSupported();
+        // Same as [ createCachedProgram() ], but returns without waiting for compile and link.
+        static AsyncProgram createProgramAsync(const std::string& vpath, const std::string& fpath, const std::string& vheader = "", const std::string& fheader = "");
+        // Return true if [ async ] is ready, never blocking. Completion is asked with GL_COMPLETION_STATUS_KHR.
+        // @LIMITATION : Without parallel compile, there is no way to ask the driver without waiting for the link,
+        // so this returns false until [ finishProgram() ] is called where a stall is acceptable, such as a loading screen.
+        static bool pollProgram(AsyncProgram& async);
+        // Wait until [ async ] is ready. Throws if compile or link failed.
+        static void finishProgram(AsyncProgram& async);
+    protected:
+        // Issue compile and link of given sources, or load the program from the cache. Empty [ gsource ] means no geometry shader.
+        static AsyncProgram issueProgram(const std::string& vsource, const std::string& gsource, const std::string& fsource);
+    public:
 
         uint getProgram() const noexcept;
         uint getVertShader() const noexcept;
@@ -0,0 +1,90 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_DEBUG_SHADER_H__
+#define __ME_DEBUG_SHADER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include "../Shader.h"
+#include "../DebugDraw.h"
+#include "glm/gtc/type_ptr.hpp"
+
+namespace ME {
+	class DebugShader : public Shader {
+	public:
+		inline static DebugShader create(const std::string& vpath, const std::string& fpath) {
+			DebugShader s;
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.program = createCachedProgram(vpath, fpath);
+			return s;
+		}
+		// Shader uniform variable names
+		inline static std::string uViewMat() noexcept {
+			return "viewMat";
+		}
+		inline static std::string uProjMat() noexcept {
+			return "projMat";
+		}
+		// Shader attributes
+		inline static uint aPosition() noexcept {
+			return 0;
+		}
+		inline static uint aColor() noexcept {
+			return 1;
+		}
+		inline static void setAttributes(const DebugDraw& dd) {
+			glBindVertexArray(dd.getVAO());
+			glBindBuffer(GL_ARRAY_BUFFER, dd.getStreamC().getBuffer());
+
+			const static auto vertMemSize = DebugDraw::Vertex::memSize();
+			const static auto pOffset = DebugDraw::Vertex::positionOffset();
+			const static auto cOffset = DebugDraw::Vertex::colorOffset();
+
+			glEnableVertexAttribArray(aPosition());
+			glVertexAttribPointer(aPosition(), 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)pOffset);
+			glEnableVertexAttribArray(aColor());
+			glVertexAttribPointer(aColor(), 4, GL_FLOAT, GL_FALSE, vertMemSize, (void*)cOffset);
+		}
+
+		// Draw
+		// Upload primitives accumulated in [ dd ] during this frame and draw them.
+		inline bool draw(DebugDraw& dd) {
+			dd.flush();
+			if (dd.getCallsC().empty())
+				return true;
+
+			enable();
+			setAttributes(dd);
+			for (const auto& call : dd.getCallsC()) {
+				const auto size = DebugDraw::widthSize(call.width);
+				if (call.type == DEBUG_POINT_TYPE) {
+					glPointSize(size);
+					glDrawArrays(GL_POINTS, (GLint)call.first, (GLsizei)call.count);
+				}
+				else if (call.type == DEBUG_LINE_TYPE) {
+					glLineWidth(size);
+					glDrawArrays(GL_LINES, (GLint)call.first, (GLsizei)call.count);
+				}
+				else if (call.type == DEBUG_TRI_TYPE) {
+					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+					glDrawArrays(GL_TRIANGLES, (GLint)call.first, (GLsizei)call.count);
+				}
+			}
+			glBindVertexArray(0);
+			return true;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
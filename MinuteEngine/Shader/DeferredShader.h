@@ -0,0 +1,140 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_DEFERRED_SHADER_H__
+#define __ME_DEFERRED_SHADER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include "StandardShader.h"
+#include "../Camera.h"
+#include "../GBuffer.h"
+#include "glm/matrix.hpp"
+
+namespace ME {
+	// Deferred version of [ StandardShader ], built from the same fragment shader. Geometry pass draws objects
+	// into [ GBuffer ] without lighting, then lighting pass shades each pixel once with a full screen triangle,
+	// using the same lights, shadows and clusters. Surfaces are opaque : alpha is not blended, and MSAA of the
+	// target framebuffer does not apply to shading.
+	class DeferredShader : public StandardShader {
+	private:
+		uint geometryProgram = 0;
+		uint lightingProgram = 0;
+		uint vao = 0;					// Empty, vertices are made from gl_VertexID
+		GBuffer gbuffer;
+	public:
+		// @vpath, fpath : Same shaders as [ StandardShader ]
+		// @lvpath : Vertex shader of lighting pass
+		inline static DeferredShader create(const std::string& vpath, const std::string& fpath, const std::string& lvpath) {
+			DeferredShader s;
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.geometryProgram = createCachedProgram(vpath, fpath, "", "#define DEFERRED_GEOMETRY_PASS\n");
+			s.lightingProgram = createCachedProgram(lvpath, fpath, "", "#define DEFERRED_LIGHTING_PASS\n");
+
+			s.program = s.lightingProgram;
+			s.setSamplerUnits();
+			for (int i = 0; i < GBUFFER_TARGET_NUM; i++)
+				s.setUnifInt(uGBuffer(i), tGBuffer(i));
+			s.setUnifInt(uGBufferDepth(), tGBufferDepth());
+
+			s.program = s.geometryProgram;
+			s.setSamplerUnits();
+			s.setVariantSource(vpath, fpath, "#define DEFERRED_GEOMETRY_PASS\n");
+
+			glGenVertexArrays(1, &s.vao);
+			return s;
+		}
+		// Shader uniform variable names
+		inline static std::string uGBuffer(int target) {
+			static const char* names[GBUFFER_TARGET_NUM] = {
+				"gbufferEmission", "gbufferDiffuse", "gbufferSpecular", "gbufferAmbient", "gbufferNormal"
+			};
+			return names[target];
+		}
+		inline static std::string uGBufferDepth() {
+			return "gbufferDepth";
+		}
+		inline static std::string uInvProjMat() {
+			return "invProjMat";
+		}
+		inline static std::string uInvViewMat() {
+			return "invViewMat";
+		}
+		// Shader texture unit
+		inline static uint tGBuffer(int target) {
+			return tClusterIndices() + 1 + target;
+		}
+		inline static uint tGBufferDepth() {
+			return tGBuffer(GBUFFER_TARGET_NUM);
+		}
+
+		inline const GBuffer& getGBufferC() const noexcept {
+			return gbuffer;
+		}
+
+		// Draw
+		// Objects of [ scene ] go to G-buffer, and lit pixels to the framebuffer bound now, with their depth.
+		// Pixels that no object covers are left as they are ( skybox ).
+		inline bool draw(const Scene& scene, const Camera& camera) {
+			const int width = camera.getWindowWidth();
+			const int height = camera.getWindowHeight();
+			if (!gbuffer.getValid())
+				gbuffer = GBuffer::create(width, height);
+			else
+				gbuffer.resize(width, height);
+
+			GLint target = 0;
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+			const GLboolean blend = glIsEnabled(GL_BLEND);
+			glDisable(GL_BLEND);
+
+			// 1. Geometry pass
+			program = geometryProgram;
+			setUnifCamera(camera);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.getFBO());
+			glViewport(0, 0, width, height);
+			const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int i = 0; i < GBUFFER_TARGET_NUM; i++)
+				glClearBufferfv(GL_COLOR, i, zero);
+			glClear(GL_DEPTH_BUFFER_BIT);
+
+			StandardShader::draw(scene.getSkyboxC());
+			bool ret = drawObjects(scene);
+
+			// 2. Lighting pass
+			program = lightingProgram;
+			glBindFramebuffer(GL_FRAMEBUFFER, target);
+			setUnifMat4(uViewMat(), camera.getViewMatC());
+			setUnifMat4(uInvViewMat(), glm::inverse(camera.getViewMatC()));
+			setUnifMat4(uInvProjMat(), glm::inverse(camera.getProjMatC()));
+			if (!StandardShader::draw(scene.getLightManagerC()))
+				ret = false;
+			gbuffer.bind(tGBuffer(0));
+
+			glDepthFunc(GL_ALWAYS);		// Depth comes from G-buffer
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			glBindVertexArray(vao);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindVertexArray(0);
+			glDepthFunc(GL_LESS);
+
+			if (blend)
+				glEnable(GL_BLEND);
+			program = geometryProgram;
+			return ret;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,294 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_DEPTH_SHADER_H__
+#define __ME_DEPTH_SHADER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include "../Shader.h"
+#include "../Scene.h"
+#include "../Camera.h"
+#include "../Indirect.h"
+#include "glm/matrix.hpp"
+#include <algorithm>
+
+#define DEPTH_PREPASS_OFF		0
+#define DEPTH_PREPASS_ON		1
+#define DEPTH_PREPASS_AUTO		2		// On while measured overdraw is high
+
+#define DEPTH_PREPASS_DEF_ON_OVERDRAW	2.0f	// Auto mode turns pre-pass on above this overdraw,
+#define DEPTH_PREPASS_DEF_OFF_OVERDRAW	1.5f	// and off again below this one
+
+namespace ME {
+	// Depth-only pre-pass over opaque faces with camera matrices. Afterwards [ StandardShader ] shades those faces
+	// with GL_EQUAL depth test and without depth writes, so each pixel runs the expensive fragment shader once.
+	// Overdraw is measured with occlusion queries : samples that passed depth test in a pass, over samples of
+	// the screen. Results are read a frame later so that CPU never waits for GPU.
+	class DepthShader : public Shader {
+	private:
+		// Indirect draw
+		IndirectBatch batch;
+		bool batchValid = false;
+		bool indirectMode = true;		// Use multi draw indirect when context supports it
+
+		int mode = DEPTH_PREPASS_AUTO;
+		bool active = false;			// Pre-pass is drawn in the current frame
+		float onOverdraw = DEPTH_PREPASS_DEF_ON_OVERDRAW;
+		float offOverdraw = DEPTH_PREPASS_DEF_OFF_OVERDRAW;
+
+		// Overdraw measurement
+		uint query = 0;
+		bool queryPending = false;		// Result of [ query ] is not read yet
+		bool queryRunning = false;
+		bool queryPrepass = false;		// [ query ] measured pre-pass, i.e. opaque faces only
+		float screenSamples = 1.0f;		// Samples of the screen when [ query ] began
+		float overdraw = 0.0f;
+	public:
+		inline static DepthShader create(const std::string& vpath, const std::string& fpath) {
+			DepthShader s;
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.program = createCachedProgram(vpath, fpath);
+			s.setUnifInt(uDrawData(), tDrawData());
+			glGenQueries(1, &s.query);
+			return s;
+		}
+		// Shader uniform variable names
+		inline static std::string uModelMat() noexcept {
+			return "modelMat";
+		}
+		inline static std::string uViewMat() noexcept {
+			return "viewMat";
+		}
+		inline static std::string uProjMat() noexcept {
+			return "projMat";
+		}
+		inline static std::string uIndirectMode() noexcept {
+			return "indirectMode";
+		}
+		inline static std::string uDrawData() noexcept {
+			return "drawData";
+		}
+		// Shader texture unit
+		inline static uint tDrawData() noexcept {
+			return 0;
+		}
+		// Shader attributes
+		inline static uint aPosition() noexcept {
+			return 0;
+		}
+		inline static void setAttributes(const Render& render) {
+			glBindVertexArray(render.getVAO());
+			glBindBuffer(GL_ARRAY_BUFFER, render.getVBO());
+
+			const static auto vertMemSize = Render::Vertex::memSize();
+			const static auto pOffset = Render::Vertex::positionOffset();
+
+			glEnableVertexAttribArray(aPosition());
+			glVertexAttribPointer(aPosition(), 3, GL_FLOAT, GL_FALSE, vertMemSize, (void*)pOffset);
+		}
+		// True if faces of [ render ] go into pre-pass : they are drawn and hide what is behind them.
+		// Blended faces, edges, points and lines are depth tested as usual in the main pass.
+		inline static bool occluder(const Render& render) {
+			const auto& option = render.getOptionC();
+			return (render.type() == TRI_RENDER_TYPE || render.type() == QUAD_RENDER_TYPE) &&
+				option.drawFace && option.alpha >= 1.0f;
+		}
+
+		// Mode
+		inline void setMode(int mode) noexcept {
+			this->mode = mode;
+		}
+		inline int getMode() const noexcept {
+			return mode;
+		}
+		inline void setOverdrawThreshold(float on, float off) noexcept {
+			onOverdraw = on;
+			offOverdraw = std::min(on, off);
+		}
+		inline bool getActive() const noexcept {
+			return active;
+		}
+		// Overdraw of the last measured frame, 0 if nothing is measured yet
+		inline float getOverdraw() const noexcept {
+			return overdraw;
+		}
+		inline void setIndirectMode(bool mode) noexcept {
+			indirectMode = mode;
+		}
+		inline bool getIndirectMode() const noexcept {
+			return indirectMode;
+		}
+
+		// Overdraw measurement
+		// Count samples of the following draws, unless the previous result is still on the way.
+		inline void beginMeasure(bool prepass = false) {
+			if (queryPending || queryRunning || query == 0)
+				return;
+			GLint viewport[4];
+			GLint samples = 0;
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glGetIntegerv(GL_SAMPLES, &samples);
+			screenSamples = (float)std::max(1, viewport[2] * viewport[3]) * (float)std::max(1, samples);
+			queryPrepass = prepass;
+			glBeginQuery(GL_SAMPLES_PASSED, query);
+			queryRunning = true;
+		}
+		inline void endMeasure() {
+			if (!queryRunning)
+				return;
+			glEndQuery(GL_SAMPLES_PASSED);
+			queryRunning = false;
+			queryPending = true;
+		}
+		// Read the result of the last measurement if it is ready, and update [ active ] in auto mode.
+		inline void updateMeasure() {
+			if (queryPending) {
+				GLint available = 0;
+				glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available) {
+					GLuint samples = 0;
+					glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+					overdraw = (float)samples / screenSamples;
+					queryPending = false;
+				}
+			}
+
+			if (mode == DEPTH_PREPASS_AUTO) {
+				// Pre-pass only counts opaque faces, so it is compared with the lower threshold
+				// to keep it on while those alone overdraw.
+				if (!active && !queryPrepass && overdraw > onOverdraw)
+					active = true;
+				else if (active && queryPrepass && overdraw < offOverdraw)
+					active = false;
+			}
+			else
+				active = (mode == DEPTH_PREPASS_ON);
+		}
+
+		// Draw
+		inline bool draw(const Render& render, const glm::mat4& modelMat) {
+			if (!occluder(render))
+				return false;
+			const auto& option = render.getOptionC();
+			setAttributes(render);
+
+			enable();
+			setUnifMat4(uModelMat(), modelMat);
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			if (render.type() == TRI_RENDER_TYPE)
+				render.drawElements(GL_TRIANGLES, 3 * option.drawNum);
+			else
+				render.drawElements(GL_QUADS, 4 * option.drawNum);
+			glBindVertexArray(0);
+			return true;
+		}
+		// Faces are all drawn the same way, so buckets only split by primitive.
+		inline static IndirectBatch::Key indirectKey(const Render& render) {
+			return { (float)render.type() };
+		}
+		// Opaque faces of [ scene ], in the same way [ StandardShader::drawObjects() ] draws them
+		// so that both passes produce the same depth.
+		inline void drawObjects(const Scene& scene) {
+			const bool indirect = indirectMode && IndirectBatch::supported();
+			if (indirect && !batchValid) {
+				batch = IndirectBatch::create();
+				batchValid = true;
+			}
+			if (batchValid)
+				batch.clear();
+
+			const auto& staticBatch = scene.getStaticBatchC();
+			struct Item {
+				int         id;
+				glm::mat4   modelMat;
+			};
+			auto& graph = scene.getGraphC();
+			int root = scene.getRoot();
+
+			Item rootItem;
+			rootItem.id = root;
+			rootItem.modelMat = graph.at(root).getObjectC()->getTransformC().getMat4();
+
+			std::vector<Item> drawQueue;
+			drawQueue.reserve(graph.size());
+			drawQueue.push_back(rootItem);
+			while (!drawQueue.empty()) {
+				Item item = drawQueue.back(); drawQueue.pop_back();
+				auto& node = graph.at(item.id);
+				auto& object = node.getObjectC();
+
+				item.modelMat = item.modelMat * object->getTransformC().getMat4();
+				for (const auto& prop : object->getPropertiesC()) {
+					const auto& render = prop.second->getRenderC();
+					if (render == nullptr || staticBatch.contains(*render) || !occluder(*render))
+						continue;
+					if (!indirect || !batch.add(*render, item.modelMat, indirectKey(*render), IndirectBatch::indexCount(*render)))
+						draw(*render, item.modelMat);
+				}
+				for (auto child : node.getChildC()) {
+					item.id = child;
+					drawQueue.push_back(item);
+				}
+			}
+
+			// Merged static geometry, only visible chunks of it
+			for (const auto& merged : staticBatch.getBatchesC()) {
+				const auto& render = *merged.render;
+				if (!occluder(render))
+					continue;
+				if (!indirect) {
+					draw(render, glm::mat4(1.0f));
+					continue;
+				}
+				for (const auto& range : merged.visibleRanges)
+					batch.add(render, glm::mat4(1.0f), indirectKey(render), (uint)range.indexNum, 0, (uint)range.firstIndex);
+			}
+			if (!indirect)
+				return;
+			batch.upload();
+
+			enable();
+			setUnifBool(uIndirectMode(), true);
+			batch.bindDrawData(tDrawData());
+			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			for (const auto& bucket : batch.getBucketsC()) {
+				setAttributes(*bucket.render);
+				batch.submit(bucket, IndirectBatch::primitiveMode(*bucket.render));
+			}
+			glBindVertexArray(0);
+			setUnifBool(uIndirectMode(), false);
+		}
+		// Fill depth of the bound framebuffer with opaque faces of [ scene ] if pre-pass is active in this frame.
+		// Returns true if it was drawn, then the main pass should test faces with GL_EQUAL.
+		inline bool draw(const Scene& scene, const Camera& camera) {
+			updateMeasure();
+			if (!active)
+				return false;
+
+			setUnifMat4(uViewMat(), camera.getViewMatC());
+			setUnifMat4(uProjMat(), camera.getProjMatC());
+
+			GLboolean colorMask[4];
+			glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			beginMeasure(true);
+			drawObjects(scene);
+			endMeasure();
+			glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+			return true;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_MOMENT_SHADER_H__
+#define __ME_MOMENT_SHADER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include "../Shader.h"
+#include "../Light.h"
+#include "ShadowmapShader.h"
+#include "glm/gtc/type_ptr.hpp"
+#include <cmath>
+#include <vector>
+
+namespace ME {
+	// Builds [ VarianceShadow ]s from depth in [ ShadowAtlas ] : converts depth into moments with horizontal blur,
+	// then blurs vertically into the moment map and generates its mipmaps. Draws a full screen triangle per pass.
+	class MomentShader : public Shader {
+	private:
+		uint vao = 0;					// Empty, vertices are made from gl_VertexID
+		uint depthSampler = 0;			// Reads raw depth from the atlas, which is in comparison mode
+		std::vector<uint> filtered;		// For each light, moment map built from its current tile ( 0 if none )
+	public:
+		inline static MomentShader create(const std::string& vpath, const std::string& fpath) {
+			MomentShader s;
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.program = createCachedProgram(vpath, fpath);
+			s.setUnifInt(uSource(), tSource());
+
+			glGenVertexArrays(1, &s.vao);
+			glGenSamplers(1, &s.depthSampler);
+			glSamplerParameteri(s.depthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glSamplerParameteri(s.depthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glSamplerParameteri(s.depthSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glSamplerParameteri(s.depthSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glSamplerParameteri(s.depthSampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+			return s;
+		}
+		// Shader uniform variable names
+		inline static std::string uSource() noexcept {
+			return "source";
+		}
+		inline static std::string uFromDepth() noexcept {
+			return "fromDepth";
+		}
+		inline static std::string uSourceRect() noexcept {
+			return "sourceRect";
+		}
+		inline static std::string uStep() noexcept {
+			return "step";
+		}
+		inline static std::string uExponents() noexcept {
+			return "exponents";
+		}
+		inline static std::string uRadius() noexcept {
+			return "radius";
+		}
+		inline static std::string uWeight(int id) noexcept {
+			return std::string("weights[") + std::to_string(id) + "]";
+		}
+		// Shader texture unit
+		inline static uint tSource() noexcept {
+			return 0;
+		}
+
+		// Normalized Gaussian weights of offset 0 ... [ radius ], with sigma of half the radius
+		inline static void gaussianWeights(int radius, float* weights) {
+			if (radius == 0) {
+				weights[0] = 1.0f;
+				return;
+			}
+			const float sigma = 0.5f * radius;
+			float sum = 0.0f;
+			for (int i = 0; i <= radius; i++) {
+				weights[i] = std::exp(-0.5f * i * i / (sigma * sigma));
+				sum += (i == 0 ? weights[i] : 2.0f * weights[i]);
+			}
+			for (int i = 0; i <= radius; i++)
+				weights[i] /= sum;
+		}
+		// Build moment map of [ vs ] from region [ rect ] ( in texture coords ) of depth map [ depthMap ].
+		inline void filter(const VarianceShadow& vs, uint depthMap, const glm::vec4& rect) {
+			const uint size = vs.getMapSize();
+			float weights[VARIANCE_SHADOW_MAX_BLUR_RADIUS + 1];
+			gaussianWeights(vs.getBlurRadius(), weights);
+
+			enable();
+			setUnifInt(uRadius(), vs.getBlurRadius());
+			for (int i = 0; i <= vs.getBlurRadius(); i++)
+				setUnifFloat(uWeight(i), weights[i]);
+			glUniform2fv(getUnifLoc(uExponents()), 1, glm::value_ptr(vs.getExponents()));
+
+			glDisable(GL_DEPTH_TEST);
+			glViewport(0, 0, size, size);
+			glBindVertexArray(vao);
+			glActiveTexture(GL_TEXTURE0 + tSource());
+
+			// 1. Depth to moments, with horizontal blur
+			glBindFramebuffer(GL_FRAMEBUFFER, vs.getTempFBO());
+			glBindTexture(GL_TEXTURE_2D, depthMap);
+			glBindSampler(tSource(), depthSampler);
+			setUnifBool(uFromDepth(), true);
+			setUnifVec4(uSourceRect(), rect);
+			glUniform2f(getUnifLoc(uStep()), rect.z / size, 0.0f);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			glBindSampler(tSource(), 0);
+
+			// 2. Vertical blur
+			glBindFramebuffer(GL_FRAMEBUFFER, vs.getFBO());
+			glBindTexture(GL_TEXTURE_2D, vs.getTempMap());
+			setUnifBool(uFromDepth(), false);
+			setUnifVec4(uSourceRect(), glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+			glUniform2f(getUnifLoc(uStep()), 0.0f, 1.0f / size);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			// 3. Pre-filter for minification
+			glBindTexture(GL_TEXTURE_2D, vs.getMomentMap());
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, 0);
+
+			glBindVertexArray(0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glEnable(GL_DEPTH_TEST);
+		}
+		// Build moment maps of lights whose tiles were rendered by [ shadowmapShader ] in this frame.
+		inline bool draw(const LightManager& lightManager, const ShadowmapShader& shadowmapShader) {
+			const auto& atlas = lightManager.atlas;
+			if (!atlas.getValid())
+				return false;
+			filtered.resize(lightManager.lights.size(), 0);
+			for (size_t i = 0; i < lightManager.lights.size(); i++) {
+				const auto& light = lightManager.lights[i];
+				const auto& vs = light.shadow.getVarianceC();
+				if (!light.getValid() || !light.shadow.getValid() || !light.shadow.getResident() ||
+					light.getShadowReplaced() || !vs.getValid()) {
+					filtered[i] = 0;
+					continue;
+				}
+				if (filtered[i] == vs.getMomentMap() && !shadowmapShader.getTileRendered((uint)i))
+					continue;
+				filter(vs, atlas.getDepthMap(), light.shadow.getRect());
+				filtered[i] = vs.getMomentMap();
+			}
+			return true;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
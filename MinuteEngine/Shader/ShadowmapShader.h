@@ -17,18 +17,91 @@
 #include <SDL_opengl.h>
 #include "../Shader.h"
 #include "../Scene.h"
+#include "../Indirect.h"
 #include "glm/gtc/type_ptr.hpp"
+#include <cstdint>
+
+#define SHADOW_STATIC_LAYER		0		// Casters of static objects, cached in [ ShadowAtlas ]'s static layer
+#define SHADOW_DYNAMIC_LAYER	1		// Every other caster, drawn over the cached static depth
+#define SHADOW_LAYER_NUM		2
+
+#define SHADOW_DEF_SLOPE_BIAS		2.0f	// Depth offset in proportion to slope of polygon, see glPolygonOffset()
+#define SHADOW_DEF_CONSTANT_BIAS	4.0f	// Depth offset in units of depth buffer resolution
 
 namespace ME {
 	class ShadowmapShader : public Shader {
+	private:
+		// Casters of the current frame, gathered once by [ prepare() ]
+		struct Caster {
+			const Render*	render;
+			glm::mat4		modelMat;
+		};
+		std::vector<Caster> casters[SHADOW_LAYER_NUM];
+		std::uint64_t casterHashes[SHADOW_LAYER_NUM] = { 0, 0 };	// Changes when any caster of the layer moves or changes
+
+		// Indirect draw
+		IndirectBatch batches[SHADOW_LAYER_NUM];
+		IndirectBatch cubeBatches[SHADOW_LAYER_NUM];	// Casters of cube pass, with quads as triangles
+		bool batchValid = false;
+		bool cubeBatchValid = false;
+		bool indirectMode = true;		// Use multi draw indirect when context supports it
+		bool indirectFrame = false;		// Indirect draw is used in the current frame
+
+		// Renders that are not in [ BufferArena ], drawn one by one even in indirect mode
+		std::vector<Caster> fallbacks[SHADOW_LAYER_NUM];
+		std::vector<Caster> cubeFallbacks[SHADOW_LAYER_NUM];
+
+		// What a shadow map was rendered with, to skip it while nothing has changed
+		struct CacheEntry {
+			bool valid = false;
+			glm::mat4 lightSpaceMat;
+			ShadowAtlas::Tile tile;
+			uint revision = 0;					// Of the depth map, see [ CascadedShadow::getRevision() ] and so on
+			std::uint64_t casterHashes[SHADOW_LAYER_NUM] = { 0, 0 };
+		};
+		std::vector<CacheEntry> tileCache;		// For each light
+		std::vector<char> tileRendered;			// For each light, true if its tile was rendered in the last frame
+		std::vector<CacheEntry> csmCache;		// For each cascade of each light
+		std::vector<CacheEntry> cubeCache;		// For each light
+		bool cacheMode = true;
+		uint renderedMapNum = 0;				// Shadow maps ( or cascades ) rendered in the last frame
+
+		// Program that renders every face of a cube shadow in a single pass, see [ createCubeProgram() ]
+		uint mapProgram = 0;
+		uint cubeProgram = 0;
+		bool cubePass = false;					// Points and lines are not drawn into cube shadows, quads are drawn as triangles
+
+		// Slope scaled depth bias, applied while rendering maps instead of comparing with constant bias.
+		// Cube shadows write depth in fragment shader, so they are not affected.
+		float slopeBias = SHADOW_DEF_SLOPE_BIAS;
+		float constantBias = SHADOW_DEF_CONSTANT_BIAS;
 	public:
 		inline static ShadowmapShader create(const std::string& vpath, const std::string& fpath) {
 			ShadowmapShader s;
-			s.vertShader = createVertShader(vpath);
-			s.fragShader = createFragShader(fpath);
-			s.program = createProgram(s.vertShader, s.fragShader);
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.program = createCachedProgram(vpath, fpath);
+			s.setUnifInt(uDrawData(), tDrawData());
+			s.mapProgram = s.program;
 			return s;
 		}
+		// Compile program for [ CubeShadow ]s of point lights. Returns false if geometry shader is not supported,
+		// then cube shadows are not rendered.
+		inline bool createCubeProgram(const std::string& vpath, const std::string& gpath, const std::string& fpath) {
+			if (!CubeShadow::supported())
+				return false;
+			cubeProgram = createCachedGeomProgram(vpath, gpath, fpath);
+
+			useCubeProgram(true);
+			setUnifInt(uDrawData(), tDrawData());
+			useCubeProgram(false);
+			return true;
+		}
+		// Every draw function works on the bound program, so switch it for cube pass.
+		inline void useCubeProgram(bool cube) noexcept {
+			program = (cube ? cubeProgram : mapProgram);
+			cubePass = cube;
+		}
 		// Shader uniform variable names
 		inline static std::string uModelMat() noexcept {
 			return "modelMat";
@@ -36,6 +109,25 @@ namespace ME {
 		inline static std::string uLightSpaceMat() noexcept {
 			return "lightSpaceMat";
 		}
+		inline static std::string uIndirectMode() noexcept {
+			return "indirectMode";
+		}
+		inline static std::string uDrawData() noexcept {
+			return "drawData";
+		}
+		inline static std::string uFaceMat(uint face) noexcept {
+			return std::string("faceMats[") + std::to_string(face) + "]";
+		}
+		inline static std::string uLightPosition() noexcept {
+			return "lightPosition";
+		}
+		inline static std::string uFarPlane() noexcept {
+			return "farPlane";
+		}
+		// Shader texture unit
+		inline static uint tDrawData() noexcept {
+			return 0;
+		}
 		// Shader attributes
 		inline static uint aPosition() noexcept {
 			return 0;
@@ -65,7 +157,7 @@ namespace ME {
 				glPointSize(option.edgeWidth);
 
 				glBindVertexArray(render.getVAO());
-				glDrawElements(GL_POINTS, option.drawNum, GL_UNSIGNED_INT, 0);
+				render.drawElements(GL_POINTS, option.drawNum);
 				glBindVertexArray(0);
 			}
 			else if (render.type() == 2) {
@@ -76,7 +168,7 @@ namespace ME {
 				glLineWidth(option.edgeWidth);
 
 				glBindVertexArray(render.getVAO());
-				glDrawElements(GL_LINES, option.drawNum, GL_UNSIGNED_INT, 0);
+				render.drawElements(GL_LINES, option.drawNum);
 				glBindVertexArray(0);
 			}
 			else if (render.type() == 3) {
@@ -89,12 +181,12 @@ namespace ME {
 				glBindVertexArray(render.getVAO());
 				if (option.drawFace) {
 					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-					glDrawElements(GL_TRIANGLES, 3 * option.drawNum, GL_UNSIGNED_INT, 0);
+					render.drawElements(GL_TRIANGLES, 3 * option.drawNum);
 				}
 				if (option.drawEdge) {
 					glLineWidth(option.edgeWidth);
 					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-					glDrawElements(GL_TRIANGLES, 3 * option.drawNum, GL_UNSIGNED_INT, 0);
+					render.drawElements(GL_TRIANGLES, 3 * option.drawNum);
 				}
 				glBindVertexArray(0);
 			}
@@ -105,15 +197,20 @@ namespace ME {
 				// Since [ QuadRender ] has its own model matrix, apply it first.
 				setUnifMat4(uModelMat(), modelMat);// *this->modelMat);
 
+				// Geometry shader of cube pass takes triangles, so the quads are drawn split in two.
+				const uint mode = (cubePass ? GL_TRIANGLES : GL_QUADS);
+				const int count = (cubePass ? 6 : 4) * option.drawNum;
+				const size_t first = (cubePass ? render.getTriangleFirst() : 0);
+
 				glBindVertexArray(render.getVAO());
 				if (option.drawFace) {
 					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-					glDrawElements(GL_QUADS, 4 * option.drawNum, GL_UNSIGNED_INT, 0);
+					render.drawElements(mode, count, first);
 				}
 				if (option.drawEdge) {
 					glLineWidth(option.edgeWidth);
 					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-					glDrawElements(GL_QUADS, 4 * option.drawNum, GL_UNSIGNED_INT, 0);
+					render.drawElements(mode, count, first);
 				}
 				glBindVertexArray(0);
 			}
@@ -124,14 +221,125 @@ namespace ME {
 				draw(*prop.getRenderC(), modelMat);
 			return true;
 		}
-		inline bool draw(const Object& object, const glm::mat4& prevMat) {
+		// @staticBatch : If given, renders merged into it are skipped
+		inline bool draw(const Object& object, const glm::mat4& prevMat, const StaticBatch* staticBatch = nullptr) {
 			glm::mat4 modelMat = prevMat * object.getTransformC().getMat4();
-			for (const auto& prop : object.getPropertiesC())
+			for (const auto& prop : object.getPropertiesC()) {
+				if (staticBatch != nullptr && prop.second->getRenderC() != nullptr && staticBatch->contains(*prop.second->getRenderC()))
+					continue;
 				draw(*prop.second, modelMat);
+			}
 			return true;
 		}
-		inline bool draw(const Scene& scene) {
-			const auto& lightManager = scene.getLightManagerC();
+		// Indirect draw
+		inline void setIndirectMode(bool mode) noexcept {
+			indirectMode = mode;
+		}
+		inline bool getIndirectMode() const noexcept {
+			return indirectMode;
+		}
+		// Only rasterization state matters for depth, so many more draws share a bucket than in [ StandardShader ].
+		inline static IndirectBatch::Key indirectKey(const Render& render) {
+			const auto& option = render.getOptionC();
+			return { (float)render.type(), (float)option.drawFace, (float)option.drawEdge, option.edgeWidth };
+		}
+		inline void drawIndirect(const IndirectBatch& batch, const IndirectBatch::Bucket& bucket) {
+			const auto& render = *bucket.render;
+			const auto& option = render.getOptionC();
+			const auto mode = IndirectBatch::primitiveMode(render, cubePass);
+			setAttributes(render);
+
+			if (render.type() == POINT_RENDER_TYPE) {
+				glPointSize(option.edgeWidth);
+				batch.submit(bucket, mode);
+			}
+			else if (render.type() == LINE_RENDER_TYPE) {
+				glLineWidth(option.edgeWidth);
+				batch.submit(bucket, mode);
+			}
+			else {
+				if (option.drawFace) {
+					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+					batch.submit(bucket, mode);
+				}
+				if (option.drawEdge) {
+					glLineWidth(option.edgeWidth);
+					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+					batch.submit(bucket, mode);
+				}
+			}
+		}
+
+		// Bias
+		inline void setSlopeBias(float bias) {
+			slopeBias = bias;
+			invalidate();
+		}
+		inline void setConstantBias(float bias) {
+			constantBias = bias;
+			invalidate();
+		}
+		inline float getSlopeBias() const noexcept {
+			return slopeBias;
+		}
+		inline float getConstantBias() const noexcept {
+			return constantBias;
+		}
+
+		// Cache
+		inline void setCacheMode(bool mode) noexcept {
+			cacheMode = mode;
+		}
+		inline bool getCacheMode() const noexcept {
+			return cacheMode;
+		}
+		// Render every shadow map again in the next frame
+		inline void invalidate() {
+			tileCache.clear();
+			csmCache.clear();
+			cubeCache.clear();
+		}
+		inline uint getRenderedMapNum() const noexcept {
+			return renderedMapNum;
+		}
+		// True if tile of light [ lightID ] in [ ShadowAtlas ] was rendered in the last frame
+		inline bool getTileRendered(uint lightID) const {
+			return lightID < tileRendered.size() && tileRendered[lightID];
+		}
+		// FNV-1a over raw bytes
+		inline static void hashBytes(std::uint64_t& hash, const void* data, size_t size) {
+			const auto* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; i++) {
+				hash ^= bytes[i];
+				hash *= 1099511628211ull;
+			}
+		}
+		// Everything of a caster that changes its depth : geometry, rasterization state and transform
+		inline static void hashCaster(std::uint64_t& hash, const Caster& caster) {
+			const auto& render = *caster.render;
+			const auto& option = render.getOptionC();
+			const auto* address = caster.render;
+			const uint state[] = { (uint)render.type(), render.getRevision(), render.getVAO(), (uint)option.drawNum, (uint)option.drawFace, (uint)option.drawEdge };
+			hashBytes(hash, &address, sizeof(address));
+			hashBytes(hash, state, sizeof(state));
+			hashBytes(hash, &option.edgeWidth, sizeof(option.edgeWidth));
+			hashBytes(hash, glm::value_ptr(caster.modelMat), sizeof(float) * 16);
+		}
+
+		// True if [ render ] can be drawn in cube pass, whose geometry shader takes triangles only
+		inline static bool cubeCaster(const Render& render) {
+			return render.type() == TRI_RENDER_TYPE || (render.type() == QUAD_RENDER_TYPE && render.getTriangleFirst() > 0);
+		}
+		// Gather casters of [ scene ] once per frame, split into static and dynamic layers.
+		// In indirect mode, they are uploaded here and reused by every shadow map of the frame.
+		inline void prepare(const Scene& scene) {
+			for (int i = 0; i < SHADOW_LAYER_NUM; i++) {
+				casters[i].clear();
+				fallbacks[i].clear();
+				cubeFallbacks[i].clear();
+			}
+
+			const auto& staticBatch = scene.getStaticBatchC();
 			struct Item {
 				int         id;
 				glm::mat4   modelMat;
@@ -139,48 +347,290 @@ namespace ME {
 			auto& graph = scene.getGraphC();
 			int root = scene.getRoot();
 
-			for (const auto& light : lightManager.lights) {
-				if (light.getValid() && light.shadow.getValid()) {
-					// Ready framebuffer
-					uint width, height;
-					light.shadow.getSize(width, height);
-					glViewport(0, 0, width, height);
-					glBindFramebuffer(GL_FRAMEBUFFER, light.shadow.getFBO());
-					glClear(GL_DEPTH_BUFFER_BIT);
-
-					// Ready light space matrix
-					const auto& viewMat = light.getViewMat();
-					const auto& projMat = light.shadow.getProjMat();
-					const auto& lightSpaceMat = projMat * viewMat;
-					enable();
-					setUnifMat4(uLightSpaceMat(), lightSpaceMat);
-
-					// Render scene
-					Item rootItem;
-					rootItem.id = root;
-					rootItem.modelMat = graph.at(root).getObjectC()->getTransformC().getMat4();
-
-					std::vector<Item> drawQueue;
-					drawQueue.reserve(graph.size());
-					drawQueue.push_back(rootItem);
-					while (!drawQueue.empty()) {
-						Item item = drawQueue.back(); drawQueue.pop_back();
-						auto& node = graph.at(item.id);
-						auto& object = node.getObjectC();
-
-						draw(*object, item.modelMat);
-
-						item.modelMat = item.modelMat * object->getTransformC().getMat4();
-						for (auto child : node.getChildC()) {
-							item.id = child;
-							drawQueue.push_back(item);
-						}
-					}
-
-					// Unbind
-					glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			Item rootItem;
+			rootItem.id = root;
+			rootItem.modelMat = graph.at(root).getObjectC()->getTransformC().getMat4();
+
+			std::vector<Item> drawQueue;
+			drawQueue.reserve(graph.size());
+			drawQueue.push_back(rootItem);
+			while (!drawQueue.empty()) {
+				Item item = drawQueue.back(); drawQueue.pop_back();
+				auto& node = graph.at(item.id);
+				auto& object = node.getObjectC();
+
+				item.modelMat = item.modelMat * object->getTransformC().getMat4();
+				const int layer = (object->getStatic() ? SHADOW_STATIC_LAYER : SHADOW_DYNAMIC_LAYER);
+				for (const auto& prop : object->getPropertiesC()) {
+					const auto& render = prop.second->getRenderC();
+					if (render == nullptr || staticBatch.contains(*render))
+						continue;
+					casters[layer].push_back({ render.get(), item.modelMat });
 				}
+				for (auto child : node.getChildC()) {
+					item.id = child;
+					drawQueue.push_back(item);
+				}
+			}
+
+			// Merged static geometry, as a whole since casters outside of the view still cast shadows
+			for (const auto& merged : staticBatch.getBatchesC())
+				casters[SHADOW_STATIC_LAYER].push_back({ merged.render.get(), glm::mat4(1.0f) });
+
+			for (int i = 0; i < SHADOW_LAYER_NUM; i++) {
+				casterHashes[i] = 14695981039346656037ull;
+				for (const auto& caster : casters[i])
+					hashCaster(casterHashes[i], caster);
 			}
+
+			indirectFrame = indirectMode && IndirectBatch::supported();
+			if (!indirectFrame)
+				return;
+			if (!batchValid) {
+				for (auto& batch : batches)
+					batch = IndirectBatch::create();
+				batchValid = true;
+			}
+			for (int i = 0; i < SHADOW_LAYER_NUM; i++) {
+				auto& batch = batches[i];
+				batch.clear();
+				for (const auto& caster : casters[i]) {
+					const auto& render = *caster.render;
+					if (!batch.add(render, caster.modelMat, indirectKey(render), IndirectBatch::indexCount(render)))
+						fallbacks[i].push_back(caster);
+				}
+				batch.upload();
+			}
+
+			// Cube pass draws quads from their triangles, so its commands differ
+			bool cubeFrame = false;
+			for (const auto& light : scene.getLightManagerC().lights)
+				cubeFrame = cubeFrame || (light.getValid() && light.getType() == 1 && light.cubeShadow.getValid());
+			if (!cubeFrame || cubeProgram == 0)
+				return;
+			if (!cubeBatchValid) {
+				for (auto& batch : cubeBatches)
+					batch = IndirectBatch::create();
+				cubeBatchValid = true;
+			}
+			for (int i = 0; i < SHADOW_LAYER_NUM; i++) {
+				auto& batch = cubeBatches[i];
+				batch.clear();
+				for (const auto& caster : casters[i]) {
+					const auto& render = *caster.render;
+					if (!cubeCaster(render))
+						continue;
+					if (!batch.add(render, caster.modelMat, indirectKey(render), IndirectBatch::indexCount(render, true), 0, (uint)render.getTriangleFirst()))
+						cubeFallbacks[i].push_back(caster);
+				}
+				batch.upload();
+			}
+		}
+		// Draw casters of [ layer ] into the bound framebuffer, with the light space matrix set.
+		inline void drawCasters(int layer) {
+			// Geometry shader of cube pass takes triangles only
+			auto skip = [this](const Render& render) {
+				return cubePass && !cubeCaster(render);
+			};
+			if (indirectFrame) {
+				for (const auto& fallback : (cubePass ? cubeFallbacks[layer] : fallbacks[layer])) {
+					if (!skip(*fallback.render))
+						draw(*fallback.render, fallback.modelMat);
+				}
+
+				const auto& batch = (cubePass ? cubeBatches[layer] : batches[layer]);
+				if (batch.getBucketsC().empty())
+					return;
+				setUnifBool(uIndirectMode(), true);
+				batch.bindDrawData(tDrawData());
+				for (const auto& bucket : batch.getBucketsC()) {
+					if (!skip(*bucket.render))
+						drawIndirect(batch, bucket);
+				}
+				setUnifBool(uIndirectMode(), false);
+				return;
+			}
+			for (const auto& caster : casters[layer]) {
+				if (!skip(*caster.render))
+					draw(*caster.render, caster.modelMat);
+			}
+		}
+		inline void drawCasters() {
+			for (int i = 0; i < SHADOW_LAYER_NUM; i++)
+				drawCasters(i);
+		}
+		// Ready the region ( [ x ], [ y ], [ width ], [ height ] ) of the depth map attached to the bound framebuffer.
+		// Only that region is cleared when scissor test is enabled.
+		inline void beginMap(uint x, uint y, uint width, uint height, const glm::mat4& lightSpaceMat, bool clear = true) {
+			glViewport(x, y, width, height);
+			glScissor(x, y, width, height);
+			if (clear)
+				glClear(GL_DEPTH_BUFFER_BIT);
+			enable();
+			setUnifMat4(uLightSpaceMat(), lightSpaceMat);
+		}
+		// True if [ entry ] is not valid any more, i.e. its shadow map has to be rendered again
+		inline bool outdated(const CacheEntry& entry, const glm::mat4& lightSpaceMat, const ShadowAtlas::Tile& tile, uint revision, int layer) const {
+			if (!cacheMode || !entry.valid || entry.lightSpaceMat != lightSpaceMat || entry.revision != revision)
+				return true;
+			if (entry.tile.x != tile.x || entry.tile.y != tile.y || entry.tile.size != tile.size)
+				return true;
+			for (int i = 0; i <= layer; i++) {
+				if (entry.casterHashes[i] != casterHashes[i])
+					return true;
+			}
+			return false;
+		}
+		inline void record(CacheEntry& entry, const glm::mat4& lightSpaceMat, const ShadowAtlas::Tile& tile, uint revision) {
+			entry.valid = true;
+			entry.lightSpaceMat = lightSpaceMat;
+			entry.tile = tile;
+			entry.revision = revision;
+			for (int i = 0; i < SHADOW_LAYER_NUM; i++)
+				entry.casterHashes[i] = casterHashes[i];
+		}
+		// @lightID : Index of the light that owns [ csm ], cascades that did not change are skipped.
+		// Cascades have no static layer, so a cascade is drawn again with every caster once any caster changes.
+		inline bool draw(const CascadedShadow& csm, uint lightID) {
+			if (csmCache.size() < (lightID + 1) * CSM_MAX_CASCADE_NUM)
+				csmCache.resize((lightID + 1) * CSM_MAX_CASCADE_NUM);
+
+			ShadowAtlas::Tile tile;
+			tile.size = csm.getMapSize();
+			glBindFramebuffer(GL_FRAMEBUFFER, csm.getFBO());
+			for (int i = 0; i < csm.getCascadeNum(); i++) {
+				// Snapping keeps cascade matrices the same while camera moves less than a texel.
+				auto& entry = csmCache[lightID * CSM_MAX_CASCADE_NUM + i];
+				const auto& shadowMat = csm.getShadowMat(i);
+				if (!outdated(entry, shadowMat, tile, csm.getRevision(), SHADOW_DYNAMIC_LAYER))
+					continue;
+
+				glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, csm.getDepthMap(), 0, i);
+				beginMap(0, 0, csm.getMapSize(), csm.getMapSize(), shadowMat);
+				drawCasters();
+				record(entry, shadowMat, tile, csm.getRevision());
+				renderedMapNum++;
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			return true;
+		}
+		// Render all 6 faces of [ cs ] in a single pass. Geometry shader sends each triangle only to the faces
+		// whose frustum it touches.
+		// @lightID : Index of the light that owns [ cs ], skipped if nothing has changed.
+		// Like cascades, there is no static layer, so all 6 faces are drawn again once any caster changes.
+		inline bool draw(const CubeShadow& cs, uint lightID) {
+			if (cubeProgram == 0)
+				return false;
+			if (cubeCache.size() < lightID + 1)
+				cubeCache.resize(lightID + 1);
+
+			// Face matrices encode position and planes of the cube
+			auto& entry = cubeCache[lightID];
+			ShadowAtlas::Tile tile;
+			tile.size = cs.getMapSize();
+			if (!outdated(entry, cs.getFaceMat(0), tile, cs.getRevision(), SHADOW_DYNAMIC_LAYER))
+				return true;
+
+			glBindFramebuffer(GL_FRAMEBUFFER, cs.getFBO());
+			useCubeProgram(true);
+			glViewport(0, 0, cs.getMapSize(), cs.getMapSize());
+			glClear(GL_DEPTH_BUFFER_BIT);
+			enable();
+			for (int i = 0; i < CUBE_SHADOW_FACE_NUM; i++)
+				setUnifMat4(uFaceMat(i), cs.getFaceMat(i));
+			setUnifVec3(uLightPosition(), cs.getPosition());
+			setUnifFloat(uFarPlane(), cs.getFPlane());
+			drawCasters();
+			useCubeProgram(false);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+			record(entry, cs.getFaceMat(0), tile, cs.getRevision());
+			renderedMapNum++;
+			return true;
+		}
+		// Render every light that has a tile into [ atlas ], without switching framebuffer.
+		// In cache mode, static casters are rendered into the static layer only when they ( or the light ) change,
+		// and a tile whose dynamic casters changed is restored from the static layer before they are drawn.
+		inline bool draw(const ShadowAtlas& atlas, const LightManager& lightManager) {
+			if (!atlas.getValid())
+				return false;
+			if (tileCache.size() != lightManager.lights.size())
+				tileCache.resize(lightManager.lights.size());
+			tileRendered.assign(lightManager.lights.size(), false);
+
+			glEnable(GL_SCISSOR_TEST);
+			for (size_t i = 0; i < lightManager.lights.size(); i++) {
+				const auto& light = lightManager.lights[i];
+				auto& entry = tileCache[i];
+				if (!light.getValid() || !light.shadow.getValid() || !light.shadow.getResident() ||
+					light.getShadowReplaced()) {
+					entry.valid = false;
+					continue;
+				}
+
+				const auto& tile = light.shadow.getTile();
+				const auto lightSpaceMat = light.shadow.getProjMat() * light.getViewMat();
+				if (!outdated(entry, lightSpaceMat, tile, atlas.getRevision(), SHADOW_DYNAMIC_LAYER))
+					continue;
+
+				// Without the static layer, there is nothing to restore from
+				if (!cacheMode || atlas.getStaticFBO() == 0) {
+					glBindFramebuffer(GL_FRAMEBUFFER, atlas.getFBO());
+					beginMap(tile.x, tile.y, tile.size, tile.size, lightSpaceMat);
+					drawCasters();
+					record(entry, lightSpaceMat, tile, atlas.getRevision());
+					tileRendered[i] = true;
+					renderedMapNum++;
+					continue;
+				}
+
+				// 1. Static layer
+				if (outdated(entry, lightSpaceMat, tile, atlas.getRevision(), SHADOW_STATIC_LAYER)) {
+					glBindFramebuffer(GL_FRAMEBUFFER, atlas.getStaticFBO());
+					beginMap(tile.x, tile.y, tile.size, tile.size, lightSpaceMat);
+					drawCasters(SHADOW_STATIC_LAYER);
+				}
+
+				// 2. Restore static depth, then draw dynamic casters over it
+				glScissor(tile.x, tile.y, tile.size, tile.size);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, atlas.getStaticFBO());
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, atlas.getFBO());
+				glBlitFramebuffer(
+					tile.x, tile.y, tile.x + tile.size, tile.y + tile.size,
+					tile.x, tile.y, tile.x + tile.size, tile.y + tile.size,
+					GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_FRAMEBUFFER, atlas.getFBO());
+				beginMap(tile.x, tile.y, tile.size, tile.size, lightSpaceMat, false);
+				drawCasters(SHADOW_DYNAMIC_LAYER);
+
+				record(entry, lightSpaceMat, tile, atlas.getRevision());
+				tileRendered[i] = true;
+				renderedMapNum++;
+			}
+			glDisable(GL_SCISSOR_TEST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			return true;
+		}
+		inline bool draw(const Scene& scene) {
+			const auto& lightManager = scene.getLightManagerC();
+			renderedMapNum = 0;
+			prepare(scene);
+
+			glEnable(GL_POLYGON_OFFSET_FILL);
+			glEnable(GL_POLYGON_OFFSET_LINE);
+			glPolygonOffset(slopeBias, constantBias);
+
+			for (size_t i = 0; i < lightManager.lights.size(); i++) {
+				const auto& light = lightManager.lights[i];
+				if (light.getCascadeBound())
+					draw(light.csm, (uint)i);
+				else if (light.getValid() && light.getType() == 1 && light.cubeShadow.getValid())
+					draw(light.cubeShadow, (uint)i);
+			}
+			draw(lightManager.atlas, lightManager);
+
+			glDisable(GL_POLYGON_OFFSET_FILL);
+			glDisable(GL_POLYGON_OFFSET_LINE);
 			return true;
 		}
 	};
@@ -24,9 +24,9 @@ namespace ME {
 	public:
 		inline static SkyboxShader create(const std::string& vpath, const std::string& fpath) {
 			SkyboxShader s;
-			s.vertShader = createVertShader(vpath);
-			s.fragShader = createFragShader(fpath);
-			s.program = createProgram(s.vertShader, s.fragShader);
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.program = createCachedProgram(vpath, fpath);
 			return s;
 		}
 		// Shader uniform variable names
@@ -66,7 +66,7 @@ namespace ME {
 
 				glBindVertexArray(render.getVAO());
 				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-				glDrawElements(GL_TRIANGLES, 3 * option.drawNum, GL_UNSIGNED_INT, 0);
+				render.drawElements(GL_TRIANGLES, 3 * option.drawNum);
 				glBindVertexArray(0);
 			}
 			else if (render.type() == 4) {
@@ -75,7 +75,7 @@ namespace ME {
 
 				glBindVertexArray(render.getVAO());
 				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-				glDrawElements(GL_QUADS, 4 * option.drawNum, GL_UNSIGNED_INT, 0);
+				render.drawElements(GL_QUADS, 4 * option.drawNum);
 				glBindVertexArray(0);
 			}
 			return true;
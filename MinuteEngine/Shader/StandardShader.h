@@ -17,20 +17,96 @@
 #include <SDL_opengl.h>
 #include "../Shader.h"
 #include "../Scene.h"
+#include "../Indirect.h"
+#include "DepthShader.h"
+#include "../Camera.h"
+#include "../Timer.h"
+#include "../TextureManager.h"
 #include "glm/gtc/type_ptr.hpp"
+#include <map>
 
-#define STANDARD_SHADER_MAX_LIGHT_NUM	16		// For texture number limit
+#define STANDARD_SHADER_MAX_LIGHT_NUM	16		// Size of light arrays in shader, for lights that are not clustered
+#define STANDARD_SHADER_MAX_CUBE_SHADOW_NUM	4	// Point lights with cube shadows, each takes a texture unit
+#define STANDARD_SHADER_MAX_VARIANCE_SHADOW_NUM	4	// Shadows with pre-filtered moments, each takes a texture unit
+
+// Feature bits of a permutation key, see [ StandardShader::variantKey() ]
+#define STANDARD_VARIANT_POLYGON		(1u << 0)	// Face ( or point ) color, otherwise edge color
+#define STANDARD_VARIANT_TEXTURE		(1u << 1)
+#define STANDARD_VARIANT_PHONG			(1u << 2)
+#define STANDARD_VARIANT_EM				(1u << 3)	// Environment mapping
+#define STANDARD_VARIANT_DIFFUSE_MAP	(1u << 4)
+#define STANDARD_VARIANT_SPECULAR_MAP	(1u << 5)
+#define STANDARD_VARIANT_NORMAL_MAP		(1u << 6)
+#define STANDARD_VARIANT_PARALLAX_MAP	(1u << 7)
+#define STANDARD_VARIANT_PM_MODE_SHIFT	8			// 2 bits of parallax mapping mode
+#define STANDARD_VARIANT_SPECULAR_PACKED	(1u << 10)	// Specular in alpha of diffuse map
+#define STANDARD_VARIANT_PARALLAX_PACKED	(1u << 11)	// Height in blue of normal map
 
 namespace ME {
 	class StandardShader : public Shader {
+	private:
+		// Indirect draw
+		IndirectBatch batch;
+		bool batchValid = false;
+		bool indirectMode = true;		// Use multi draw indirect when context supports it
+
+		// Shadow filtering
+		int shadowFilter = SHADOW_FILTER_POISSON;
+		float shadowFilterRadius = SHADOW_DEF_FILTER_RADIUS;
+
+		// Clustered lighting
+		bool clusterMode = true;		// Shade clusterable lights through [ LightManager::cluster ]
+
+		// Depth of opaque faces is already in depth buffer, see [ DepthShader ]
+		bool depthPrepass = false;
+
+		// Permutations
+		// [ program ] keeps runtime branches for every feature. While objects are drawn, each draw switches to
+		// a variant compiled only with the features of its [ Render::Option ], made the first time it is needed.
+		struct Variant {
+			AsyncProgram async;
+			uint frame = 0;				// Frame whose camera and lights were last sent to [ program ]
+			uint pollFrame = 0;			// Frame [ async ] was last polled in
+		};
+		std::map<uint, Variant> variants;
+		bool permutationMode = true;
+		bool asyncMode = true;			// Draw with [ program ] until a variant is compiled, instead of waiting
+		std::string variantVertPath;	// Shaders that variants are compiled from
+		std::string variantPath;
+		std::string variantDefines;		// Defines that every variant shares
+		double variantCompileTime = 0.0;	// Time main thread spent on compiling variants, in seconds
+
+		// Per frame state, sent again to a variant when it is first used in the frame
+		uint uberProgram = 0;			// [ program ] before objects are drawn, 0 while variants are not in use
+		uint frame = 0;
+		const Scene* frameScene = nullptr;
+		bool indirectDraw = false;		// Buckets of [ batch ] are being drawn
+		glm::mat4 frameViewMat = glm::mat4(1.0f);
+		glm::mat4 frameProjMat = glm::mat4(1.0f);
+		glm::vec3 frameCameraPosition = glm::vec3(0.0f);
 	public:
 		inline static StandardShader create(const std::string& vpath, const std::string& fpath) {
 			StandardShader s;
-			s.vertShader = createVertShader(vpath);
-			s.fragShader = createFragShader(fpath);
-			s.program = createProgram(s.vertShader, s.fragShader);
+			s.vertShader = 0;
+			s.fragShader = 0;
+			s.program = createCachedProgram(vpath, fpath);
+			s.setSamplerUnits();
+			s.setVariantSource(vpath, fpath, "");
 			return s;
 		}
+		// Buffer samplers must not share texture unit with 2D samplers even if they are not used.
+		inline void setSamplerUnits() const {
+			setUnifInt(uDrawData(), tDrawData());
+			setUnifInt(uMaterialData(), tMaterialData());
+			setUnifInt(uCascadedShadow() + ".data", tCascadedShadow());
+			for (uint i = 0; i < STANDARD_SHADER_MAX_CUBE_SHADOW_NUM; i++)
+				setUnifInt(uCubeShadow(i) + ".data", tCubeShadow(i));
+			for (uint i = 0; i < STANDARD_SHADER_MAX_VARIANCE_SHADOW_NUM; i++)
+				setUnifInt(uVarianceMap(i), tVarianceMap(i));
+			setUnifInt(uClusterLightData(), tClusterLightData());
+			setUnifInt(uClusterRecords(), tClusterRecords());
+			setUnifInt(uClusterIndices(), tClusterIndices());
+		}
 		// Shader uniform variable names
 		inline static std::string uPosition() noexcept {
 			return "position";
@@ -97,6 +173,12 @@ namespace ME {
 		inline static std::string uParallaxMap() {
 			return "parallaxMap";
 		}
+		inline static std::string uSpecularPacked() {
+			return "specularPacked";
+		}
+		inline static std::string uParallaxPacked() {
+			return "parallaxPacked";
+		}
 
 		inline static std::string uPmOptionMode() {
 			return "pmOption.mode";
@@ -135,6 +217,31 @@ namespace ME {
 		inline static std::string uLightValid(uint id) {
 			return std::string("light[") + std::to_string(id) + "].valid";
 		}
+		inline static std::string uLightRange(uint id) {
+			return std::string("light[") + std::to_string(id) + "].range";
+		}
+
+		inline static std::string uClusterMode() {
+			return "clusterMode";
+		}
+		inline static std::string uClusterGrid() {
+			return "clusterGrid";
+		}
+		inline static std::string uClusterTileSize() {
+			return "clusterTileSize";
+		}
+		inline static std::string uClusterDepthParams() {
+			return "clusterDepthParams";
+		}
+		inline static std::string uClusterLightData() {
+			return "clusterLightData";
+		}
+		inline static std::string uClusterRecords() {
+			return "clusterRecords";
+		}
+		inline static std::string uClusterIndices() {
+			return "clusterIndices";
+		}
 
 		inline static std::string uShadowNum() {
 			return "shadowNum";
@@ -142,6 +249,27 @@ namespace ME {
 		inline static std::string uShadow(uint id) {
 			return std::string("shadow[") + std::to_string(id) + "]";
 		}
+		inline static std::string uShadowAtlas() {
+			return "shadowAtlas";
+		}
+		inline static std::string uCascadedShadow() {
+			return "csm";
+		}
+		inline static std::string uShadowFilter() {
+			return "shadowFilter";
+		}
+		inline static std::string uShadowFilterRadius() {
+			return "shadowFilterRadius";
+		}
+		inline static std::string uVarianceMap(uint id) {
+			return std::string("varianceMaps[") + std::to_string(id) + "]";
+		}
+		inline static std::string uCubeShadowNum() {
+			return "cubeShadowNum";
+		}
+		inline static std::string uCubeShadow(uint id) {
+			return std::string("cubeShadow[") + std::to_string(id) + "]";
+		}
 
 		inline static std::string uEnvironmentMap() {
 			return "envMap";
@@ -156,6 +284,16 @@ namespace ME {
 			return "emFactor";
 		}
 
+		inline static std::string uIndirectMode() {
+			return "indirectMode";
+		}
+		inline static std::string uDrawData() {
+			return "drawData";
+		}
+		inline static std::string uMaterialData() {
+			return "materialData";
+		}
+
 		// Shader texture unit
 		inline static uint tDiffuseMap() {
 			return 0;
@@ -172,8 +310,32 @@ namespace ME {
 		inline static uint tEnvironmentMap() {
 			return 4;
 		}
-		inline static uint tShadow(uint id) {
-			return tEnvironmentMap() + 1 + id;
+		inline static uint tShadowAtlas() {
+			return tEnvironmentMap() + 1;
+		}
+		inline static uint tDrawData() {
+			return tShadowAtlas() + 1;
+		}
+		inline static uint tMaterialData() {
+			return tDrawData() + 1;
+		}
+		inline static uint tCascadedShadow() {
+			return tMaterialData() + 1;
+		}
+		inline static uint tCubeShadow(uint id) {
+			return tCascadedShadow() + 1 + id;
+		}
+		inline static uint tVarianceMap(uint id) {
+			return tCubeShadow(STANDARD_SHADER_MAX_CUBE_SHADOW_NUM) + id;
+		}
+		inline static uint tClusterLightData() {
+			return tVarianceMap(STANDARD_SHADER_MAX_VARIANCE_SHADOW_NUM);
+		}
+		inline static uint tClusterRecords() {
+			return tClusterLightData() + 1;
+		}
+		inline static uint tClusterIndices() {
+			return tClusterRecords() + 1;
 		}
 
 		// Shader attributes
@@ -236,16 +398,12 @@ namespace ME {
 
 			return true;
 		}
-		inline bool setUnifShadow(const std::string& name, uint unitID, const Shadow& shadow, const glm::mat4& lightViewMat) const {
+		inline bool setUnifShadow(const std::string& name, const Shadow& shadow, const glm::mat4& lightViewMat) const {
 			enable();
 
-			if (shadow.getValid()) {
+			if (shadow.getValid() && shadow.getResident()) {
 				setUnifBool(name + ".valid", true);
-
-				glEnable(GL_TEXTURE_2D);
-				glActiveTexture(GL_TEXTURE0 + unitID);
-				glBindTexture(GL_TEXTURE_2D, shadow.getDepthMap());
-				setUnifInt(name + ".data", unitID);
+				setUnifVec4(name + ".rect", shadow.getRect());
 
 				const auto projMat = shadow.getProjMat();
 				const auto shadowMat = projMat * lightViewMat;
@@ -255,6 +413,51 @@ namespace ME {
 				setUnifBool(name + ".valid", false);
 			return true;
 		}
+		inline bool setUnifShadowAtlas(const std::string& name, uint unitID, const ShadowAtlas& atlas) const {
+			enable();
+
+			glActiveTexture(GL_TEXTURE0 + unitID);
+			glBindTexture(GL_TEXTURE_2D, atlas.getValid() ? atlas.getDepthMap() : 0);
+			setUnifInt(name, unitID);
+			return true;
+		}
+		inline bool setUnifCascadedShadow(const std::string& name, uint unitID, const CascadedShadow& csm) const {
+			enable();
+
+			glActiveTexture(GL_TEXTURE0 + unitID);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, csm.getDepthMap());
+			setUnifInt(name + ".data", unitID);
+
+			for (int i = 0; i < csm.getCascadeNum(); i++) {
+				setUnifMat4(name + ".shadowMat[" + std::to_string(i) + "]", csm.getShadowMat(i));
+				setUnifFloat(name + ".splits[" + std::to_string(i) + "]", csm.getSplit(i));
+			}
+			setUnifInt(name + ".num", csm.getCascadeNum());
+			setUnifFloat(name + ".blendRatio", csm.getBlendRatio());
+			setUnifBool(name + ".valid", true);
+			return true;
+		}
+		inline bool setUnifCubeShadow(const std::string& name, uint unitID, const CubeShadow& cs) const {
+			enable();
+
+			glActiveTexture(GL_TEXTURE0 + unitID);
+			glBindTexture(GL_TEXTURE_CUBE_MAP, cs.getDepthMap());
+			setUnifInt(name + ".data", unitID);
+			setUnifVec3(name + ".position", cs.getPosition());
+			setUnifFloat(name + ".farPlane", cs.getFPlane());
+			return true;
+		}
+		// @name : Name of [ Shadow ] that uses moment map [ slot ]
+		inline bool setUnifVarianceShadow(const std::string& name, uint slot, const VarianceShadow& vs) const {
+			enable();
+
+			glActiveTexture(GL_TEXTURE0 + tVarianceMap(slot));
+			glBindTexture(GL_TEXTURE_2D, vs.getMomentMap());
+			setUnifInt(name + ".variance", slot);
+			glUniform2fv(getUnifLoc(name + ".exponents"), 1, glm::value_ptr(vs.getExponents()));
+			setUnifFloat(name + ".bleedReduction", vs.getBleedReduction());
+			return true;
+		}
 		inline bool setUnifLight(uint id, const Light& light) const {
 			enable();
 
@@ -280,18 +483,82 @@ namespace ME {
 			loc = getUnifLoc(uLightValid(id));
 			glUniform1i(loc, light.getValid());
 
-			setUnifShadow(uShadow(id), tShadow(id), light.shadow, light.getViewMat());
+			loc = getUnifLoc(uLightRange(id));
+			glUniform1f(loc, light.getRange());
 
+			if (light.getShadowReplaced())
+				setUnifBool(uShadow(id) + ".valid", false);		// Cascades or cube map are used instead
+			else
+				setUnifShadow(uShadow(id), light.shadow, light.getViewMat());
+
+			return true;
+		}
+		inline bool setUnifLightCluster(const LightCluster& cluster) const {
+			enable();
+			setUnifBool(uClusterMode(), true);
+			glUniform3i(getUnifLoc(uClusterGrid()), cluster.getGridX(), cluster.getGridY(), cluster.getGridZ());
+			glUniform2f(getUnifLoc(uClusterTileSize()), cluster.getTileWidth(), cluster.getTileHeight());
+			glUniform2f(getUnifLoc(uClusterDepthParams()), cluster.getDepthScale(), cluster.getDepthBias());
+			cluster.bindLightData(tClusterLightData());
+			cluster.bindRecords(tClusterRecords());
+			cluster.bindIndices(tClusterIndices());
 			return true;
 		}
-		inline bool setUnifTexture2D(const std::string& name, uint unitID, const Render::Texture2D& texture) const {
-			if (texture.valid) {
+		// Set uniform variables for face rendering according to [ option.shadeMode ]
+		inline void setUnifFaceState(const Render::Option& option) const {
+			if (option.shadeMode == 0) {
+				// Simple shading, use(basic) color without lighting
+				setUnifVec3(uFaceColor(), option.faceColor);
+				setUnifBool(uPhongMode(), false);
+				setUnifBool(uTextureMode(), false);
+			}
+			else if (option.shadeMode == 1) {
+				// Phong shading, with material
+				setUnifMaterial(option.material);
+				setUnifBool(uPhongMode(), true);
+				setUnifBool(uTextureMode(), false);
+
+				// Environment mapping option
+				setUnifBool(uEmMode(), option.emMode);
+				setUnifFloat(uEmFactor(), option.emFactor);
+			}
+			else if (option.shadeMode == 2) {
+				// Phong shading, with textures
+				setUnifBool(uPhongMode(), true);
+				setUnifBool(uTextureMode(), true);
+				setUnifTexture2D(uDiffuseMap(), tDiffuseMap(), option.diffuseMap);
+				setUnifTexture2D(uSpecularMap(), tSpecularMap(), option.specularMap, option.specularPacked);
+				setUnifTexture2D(uNormalMap(), tNormalMap(), option.normalMap);
+				setUnifTexture2D(uParallaxMap(), tParallaxMap(), option.parallaxMap, option.parallaxPacked);
+				setUnifBool(uSpecularPacked(), option.specularPacked);
+				setUnifBool(uParallaxPacked(), option.parallaxPacked);
+
+				// Parallax mapping option
+				if (option.parallaxMap.valid) {
+					setUnifInt(uPmOptionMode(), option.pmMode);
+					setUnifFloat(uPmOptionDepthScale(), option.pmDepthScale);
+					setUnifInt(uPmOptionMinLayers(), option.pmMinLayers);
+					setUnifInt(uPmOptionMaxLayers(), option.pmMaxLayers);
+				}
+
+				// Environment mapping option
+				setUnifBool(uEmMode(), option.emMode);
+				setUnifFloat(uEmFactor(), option.emFactor);
+			}
+		}
+		// @packed : [ texture ] is read from another map, so only its validity is set
+		inline bool setUnifTexture2D(const std::string& name, uint unitID, const Render::Texture2D& texture, bool packed = false) const {
+			if (texture.valid && packed)
+				setUnifBool(name + ".valid", true);
+			else if (texture.valid) {
 				setUnifBool(name + ".valid", true);
 				
 				glEnable(GL_TEXTURE_2D);
 				glActiveTexture(GL_TEXTURE0 + unitID);
 				glBindTexture(GL_TEXTURE_2D, texture.texture.id);
+				glBindSampler(unitID, ME::Texture2D::sampler(texture.filter, texture.anisotropy));
 				setUnifInt(name + ".data", unitID);
+				TextureManager::global().touch(texture.texture.id);	// Drawn, for residency
 			}
 			else
 				setUnifBool(name + ".valid", false);
@@ -302,19 +569,303 @@ namespace ME {
 		inline static uint maxLightNum() noexcept {
 			return STANDARD_SHADER_MAX_LIGHT_NUM;
 		}
+		// Lights shaded through clusters, on top of [ maxLightNum() ]
+		inline static uint maxClusteredLightNum() noexcept {
+			return LIGHT_CLUSTER_MAX_LIGHT_NUM;
+		}
+		inline void setClusterMode(bool mode) noexcept {
+			clusterMode = mode;
+		}
+		inline bool getClusterMode() const noexcept {
+			return clusterMode;
+		}
+		// @prepass : True if [ DepthShader ] has drawn this frame, then opaque faces are shaded only where
+		// they are the nearest surface.
+		inline void setDepthPrepass(bool prepass) noexcept {
+			depthPrepass = prepass;
+		}
+		inline bool getDepthPrepass() const noexcept {
+			return depthPrepass;
+		}
+		inline void beginFaceDepth(const Render& render) const {
+			if (depthPrepass && DepthShader::occluder(render)) {
+				glDepthFunc(GL_EQUAL);
+				glDepthMask(GL_FALSE);
+			}
+		}
+		inline void endFaceDepth() const {
+			if (depthPrepass) {
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+			}
+		}
+
+		// Camera
+		// Matrices and eye position of [ camera ], kept to be sent to variants as well
+		inline void setUnifCamera(const Camera& camera) {
+			frameViewMat = camera.getViewMatC();
+			frameProjMat = camera.getProjMatC();
+			frameCameraPosition = camera.getEye();
+			setUnifMat4(uViewMat(), frameViewMat);
+			setUnifMat4(uProjMat(), frameProjMat);
+			setUnifVec3(uCameraPosition(), frameCameraPosition);
+		}
+
+		// Permutations
+		inline void setPermutationMode(bool mode) noexcept {
+			permutationMode = mode;
+		}
+		inline bool getPermutationMode() const noexcept {
+			return permutationMode;
+		}
+		inline uint getVariantNum() const noexcept {
+			return (uint)variants.size();
+		}
+		inline double getVariantCompileTime() const noexcept {
+			return variantCompileTime;
+		}
+		// Variants are compiled from [ vpath ] and [ fpath ], with [ defines ] in front of their own
+		inline void setVariantSource(const std::string& vpath, const std::string& fpath, const std::string& defines) {
+			variantVertPath = vpath;
+			variantPath = fpath;
+			variantDefines = defines;
+			variants.clear();
+		}
+		inline void setAsyncMode(bool mode) noexcept {
+			asyncMode = mode;
+		}
+		inline bool getAsyncMode() const noexcept {
+			return asyncMode;
+		}
+		// Variants that are still compiling
+		inline uint getPendingVariantNum() const noexcept {
+			uint num = 0;
+			for (const auto& variant : variants) {
+				if (!variant.second.async.ready)
+					num++;
+			}
+			return num;
+		}
+		// Wait for every variant that is still compiling. Without parallel compile, variants are never ready
+		// until this is called, see [ Shader::pollProgram() ], so call it where a stall is acceptable such as a loading screen.
+		inline void finishVariants() {
+			Timer timer;
+			timer.setBeg();
+			for (auto& it : variants) {
+				auto& variant = it.second;
+				if (variant.async.ready)
+					continue;
+				finishProgram(variant.async);
+				setVariantUnits(variant);
+			}
+			timer.setEnd();
+			variantCompileTime += timer.getElapsedTime();
+		}
+		inline std::string getVariantReport() const {
+			return std::to_string(variants.size()) + " variants compiled in " + std::to_string(variantCompileTime * 1000.0) + " msec" +
+				" on main thread, " + std::to_string(getPendingVariantNum()) + " pending";
+		}
+		// Features that a draw of [ render ] uses. Bits that do not change the result are left 0,
+		// so that draws which only differ in them share a variant.
+		// @face : True for faces, false for edges
+		inline static uint variantKey(const Render& render, bool face) {
+			const auto& option = render.getOptionC();
+			if (render.type() == POINT_RENDER_TYPE)
+				return STANDARD_VARIANT_POLYGON;
+			if (render.type() == LINE_RENDER_TYPE || !face)
+				return 0;
+
+			uint key = STANDARD_VARIANT_POLYGON;
+			if (option.shadeMode == 0)
+				return key;
+			key |= STANDARD_VARIANT_PHONG;
+			if (option.emMode)
+				key |= STANDARD_VARIANT_EM;
+			if (option.shadeMode == 2) {
+				key |= STANDARD_VARIANT_TEXTURE;
+				if (option.diffuseMap.valid)
+					key |= STANDARD_VARIANT_DIFFUSE_MAP;
+				if (option.specularMap.valid)
+					key |= STANDARD_VARIANT_SPECULAR_MAP | (option.specularPacked ? STANDARD_VARIANT_SPECULAR_PACKED : 0);
+				if (option.normalMap.valid)
+					key |= STANDARD_VARIANT_NORMAL_MAP;
+				if (option.parallaxMap.valid)
+					key |= STANDARD_VARIANT_PARALLAX_MAP | ((uint)(option.pmMode & 3) << STANDARD_VARIANT_PM_MODE_SHIFT) |
+						(option.parallaxPacked ? STANDARD_VARIANT_PARALLAX_PACKED : 0);
+			}
+			return key;
+		}
+		// Defines that fix branches of standard.frag to the features of [ key ]
+		inline static std::string variantHeader(uint key) {
+			auto define = [key](const char* name, uint bit) {
+				return std::string("#define ") + name + ((key & bit) ? " true\n" : " false\n");
+			};
+			return std::string("#define STANDARD_VARIANT\n") +
+				define("VARIANT_POLYGON_MODE", STANDARD_VARIANT_POLYGON) +
+				define("VARIANT_TEXTURE_MODE", STANDARD_VARIANT_TEXTURE) +
+				define("VARIANT_PHONG_MODE", STANDARD_VARIANT_PHONG) +
+				define("VARIANT_EM_MODE", STANDARD_VARIANT_EM) +
+				define("VARIANT_DIFFUSE_MAP", STANDARD_VARIANT_DIFFUSE_MAP) +
+				define("VARIANT_SPECULAR_MAP", STANDARD_VARIANT_SPECULAR_MAP) +
+				define("VARIANT_NORMAL_MAP", STANDARD_VARIANT_NORMAL_MAP) +
+				define("VARIANT_PARALLAX_MAP", STANDARD_VARIANT_PARALLAX_MAP) +
+				define("VARIANT_SPECULAR_PACKED", STANDARD_VARIANT_SPECULAR_PACKED) +
+				define("VARIANT_PARALLAX_PACKED", STANDARD_VARIANT_PARALLAX_PACKED) +
+				"#define VARIANT_PM_MODE " + std::to_string((key >> STANDARD_VARIANT_PM_MODE_SHIFT) & 3) + "\n";
+		}
+		inline Variant& getVariant(uint key) {
+			auto it = variants.find(key);
+			if (it != variants.end())
+				return it->second;
+
+			Timer timer;
+			timer.setBeg();
+			Variant variant;
+			variant.async = createProgramAsync(variantVertPath, variantPath, "", variantDefines + variantHeader(key));
+			if (!asyncMode)
+				finishProgram(variant.async);
+			timer.setEnd();
+			variantCompileTime += timer.getElapsedTime();
+
+			auto& ret = variants[key] = variant;
+			if (ret.async.ready)
+				setVariantUnits(ret);
+			return ret;
+		}
+		inline void setVariantUnits(const Variant& variant) {
+			const uint current = program;
+			program = variant.async.program;
+			setSamplerUnits();
+			program = current;
+		}
+		// True if [ variant ] is ready to draw with, polled once per frame
+		inline bool pollVariant(Variant& variant) {
+			if (variant.async.ready)
+				return true;
+			if (variant.pollFrame == frame)
+				return false;
+			variant.pollFrame = frame;
+
+			Timer timer;
+			timer.setBeg();
+			const bool ready = pollProgram(variant.async);
+			timer.setEnd();
+			variantCompileTime += timer.getElapsedTime();
+			if (ready)
+				setVariantUnits(variant);
+			return ready;
+		}
+		// Switch to the variant of [ key ] while objects are drawn, and send it the state of this frame if it
+		// has not got it yet. Until the variant is compiled, [ program ] with runtime branches draws instead.
+		// Returns true if program changed, then per draw uniforms have to be sent again.
+		inline bool useVariant(uint key) {
+			if (!permutationMode || uberProgram == 0 || variantPath.empty())
+				return false;
+			auto& variant = getVariant(key);
+			const bool ready = pollVariant(variant);
+			const uint target = (ready ? variant.async.program : uberProgram);
+			if (program == target)
+				return false;
+
+			program = target;
+			enable();
+			if (ready && variant.frame != frame) {
+				setUnifMat4(uViewMat(), frameViewMat);
+				setUnifMat4(uProjMat(), frameProjMat);
+				setUnifVec3(uCameraPosition(), frameCameraPosition);
+				if (frameScene != nullptr) {
+					draw(frameScene->getSkyboxC());
+					draw(frameScene->getLightManagerC());
+				}
+				variant.frame = frame;
+			}
+			setUnifBool(uIndirectMode(), indirectDraw);
+			return true;
+		}
+		inline void setIndirectMode(bool mode) noexcept {
+			indirectMode = mode;
+		}
+		inline bool getIndirectMode() const noexcept {
+			return indirectMode;
+		}
+		// @filter : SHADOW_FILTER_HARD, SHADOW_FILTER_GAUSSIAN, SHADOW_FILTER_POISSON
+		inline void setShadowFilter(int filter) noexcept {
+			shadowFilter = filter;
+		}
+		inline void setShadowFilterRadius(float radius) noexcept {
+			shadowFilterRadius = radius;
+		}
+		inline int getShadowFilter() const noexcept {
+			return shadowFilter;
+		}
+		inline float getShadowFilterRadius() const noexcept {
+			return shadowFilterRadius;
+		}
 
 		// Draw
 		inline bool draw(const LightManager& lightManager) {
-			auto num = lightManager.lights.size();
-			num = (num < maxLightNum() ? num : maxLightNum());
+			// Clusterable lights are shaded through clusters, the others fill uniform arrays in order.
+			const bool clustered = clusterMode && lightManager.cluster.getValid();
+			std::vector<const Light*> lights;
+			for (const auto& light : lightManager.lights) {
+				if (lights.size() == maxLightNum())
+					break;
+				if (!clustered || !LightCluster::clusterable(light))
+					lights.push_back(&light);
+			}
+			if (clustered)
+				setUnifLightCluster(lightManager.cluster);
+			else
+				setUnifBool(uClusterMode(), false);
+
+			const int num = (int)lights.size();
 			setUnifInt(uLightNum(), num);
 			setUnifInt(uShadowNum(), num);
+			setUnifShadowAtlas(uShadowAtlas(), tShadowAtlas(), lightManager.atlas);
+			setUnifInt(uShadowFilter(), shadowFilter);
+			setUnifFloat(uShadowFilterRadius(), shadowFilterRadius);
 			bool ret = true;
 			for (int i = 0; i < num; i++) {
-				bool success = setUnifLight(i, lightManager.lights[i]);
+				bool success = setUnifLight(i, *lights[i]);
 				if (!success)
 					ret = false;
 			}
+
+			// Only one light can have cascaded shadow, see [ LightManager::updateShadows() ]
+			bool cascaded = false;
+			for (int i = 0; i < num && !cascaded; i++) {
+				const auto& light = *lights[i];
+				if (light.getCascadeBound()) {
+					setUnifCascadedShadow(uCascadedShadow(), tCascadedShadow(), light.csm);
+					cascaded = true;
+				}
+			}
+			if (!cascaded)
+				setUnifBool(uCascadedShadow() + ".valid", false);
+
+			// Point lights with cube shadows, as many as texture units allow
+			uint cubeNum = 0;
+			for (int i = 0; i < num && cubeNum < STANDARD_SHADER_MAX_CUBE_SHADOW_NUM; i++) {
+				const auto& light = *lights[i];
+				if (light.getValid() && light.getType() == 1 && light.cubeShadow.getValid()) {
+					setUnifCubeShadow(uCubeShadow(cubeNum), tCubeShadow(cubeNum), light.cubeShadow);
+					cubeNum++;
+				}
+			}
+			setUnifInt(uCubeShadowNum(), cubeNum);
+
+			// Shadows with moment maps, the rest use PCF
+			uint varianceNum = 0;
+			for (int i = 0; i < num; i++) {
+				const auto& light = *lights[i];
+				const auto& vs = light.shadow.getVarianceC();
+				if (varianceNum < STANDARD_SHADER_MAX_VARIANCE_SHADOW_NUM && vs.getValid() && !light.getShadowReplaced()) {
+					setUnifVarianceShadow(uShadow(i), varianceNum, vs);
+					varianceNum++;
+				}
+				else
+					setUnifInt(uShadow(i) + ".variance", -1);
+			}
 			return ret;
 		}
 		
@@ -325,6 +876,7 @@ namespace ME {
 			// Send uniform data according to the render type
 			if (render.type() == 1) {
 				// PointRender
+				useVariant(variantKey(render, true));
 				enable();
 
 				setUnifMat4(uModelMat(), modelMat);
@@ -336,11 +888,12 @@ namespace ME {
 				glPointSize(option.edgeWidth);
 
 				glBindVertexArray(render.getVAO());
-				glDrawElements(GL_POINTS, option.drawNum, GL_UNSIGNED_INT, 0);
+				render.drawElements(GL_POINTS, option.drawNum);
 				glBindVertexArray(0);
 			}
 			else if (render.type() == 2) {
 				// LineRender
+				useVariant(variantKey(render, false));
 				enable();
 
 				setUnifMat4(uModelMat(), modelMat);
@@ -352,11 +905,12 @@ namespace ME {
 				glLineWidth(option.edgeWidth);
 
 				glBindVertexArray(render.getVAO());
-				glDrawElements(GL_LINES, option.drawNum, GL_UNSIGNED_INT, 0);
+				render.drawElements(GL_LINES, option.drawNum);
 				glBindVertexArray(0);
 			}
 			else if (render.type() == 3) {
 				// TriRender
+				useVariant(variantKey(render, option.drawFace));
 				enable();
 
 				// Since [ TriRender ] has its own model matrix, apply it first.
@@ -366,59 +920,28 @@ namespace ME {
 				if (option.drawFace) {
 					setUnifBool(uPolygonMode(), true);
 
-					if (option.shadeMode == 0) {
-						// Simple shading, use(basic) color without lighting
-						setUnifVec3(uFaceColor(), option.faceColor);
-						setUnifBool(uPhongMode(), false);
-						setUnifBool(uTextureMode(), false);
-					}
-					else if (option.shadeMode == 1) {
-						// Phong shading, with material
-						setUnifMaterial(option.material);
-						setUnifBool(uPhongMode(), true);
-						setUnifBool(uTextureMode(), false);
-
-						// Environment mapping option
-						setUnifBool(uEmMode(), option.emMode);
-						setUnifFloat(uEmFactor(), option.emFactor);
-					}
-					else if (option.shadeMode == 2) {
-						// Phong shading, with textures
-						setUnifBool(uPhongMode(), true);
-						setUnifBool(uTextureMode(), true);
-						setUnifTexture2D(uDiffuseMap(), tDiffuseMap(), option.diffuseMap);
-						setUnifTexture2D(uSpecularMap(), tSpecularMap(), option.specularMap);
-						setUnifTexture2D(uNormalMap(), tNormalMap(), option.normalMap);
-						setUnifTexture2D(uParallaxMap(), tParallaxMap(), option.parallaxMap);
-
-						// Parallax mapping option
-						if (option.parallaxMap.valid) {
-							setUnifInt(uPmOptionMode(), option.pmMode);
-							setUnifFloat(uPmOptionDepthScale(), option.pmDepthScale);
-							setUnifInt(uPmOptionMinLayers(), option.pmMinLayers);
-							setUnifInt(uPmOptionMaxLayers(), option.pmMaxLayers);
-						}
-
-						// Environment mapping option
-						setUnifBool(uEmMode(), option.emMode);
-						setUnifFloat(uEmFactor(), option.emFactor);
-					}
+					setUnifFaceState(option);
 					setUnifFloat(uAlpha(), option.alpha);
 					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-					glDrawElements(GL_TRIANGLES, 3 * option.drawNum, GL_UNSIGNED_INT, 0);
+					beginFaceDepth(render);
+					render.drawElements(GL_TRIANGLES, 3 * option.drawNum);
+					endFaceDepth();
 				}
 				if (option.drawEdge) {
+					if (useVariant(variantKey(render, false)))
+						setUnifMat4(uModelMat(), modelMat);
 					setUnifVec3(uEdgeColor(), option.edgeColor);
 					setUnifFloat(uAlpha(), option.alpha);
 					setUnifBool(uPolygonMode(), false);
 					glLineWidth(option.edgeWidth);
 					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-					glDrawElements(GL_TRIANGLES, 3 * option.drawNum, GL_UNSIGNED_INT, 0);
+					render.drawElements(GL_TRIANGLES, 3 * option.drawNum);
 				}
 				glBindVertexArray(0);
 			}
 			else if (render.type() == 4) {
 				// QuadRender
+				useVariant(variantKey(render, option.drawFace));
 				enable();
 
 				// Since [ QuadRender ] has its own model matrix, apply it first.
@@ -428,54 +951,22 @@ namespace ME {
 				if (option.drawFace) {
 					setUnifBool(uPolygonMode(), true);
 
-					if (option.shadeMode == 0) {
-						// Simple shading, use(basic) color without lighting
-						setUnifVec3(uFaceColor(), option.faceColor);
-						setUnifBool(uPhongMode(), false);
-						setUnifBool(uTextureMode(), false);
-					}
-					else if (option.shadeMode == 1) {
-						// Phong shading, with material
-						setUnifMaterial(option.material);
-						setUnifBool(uPhongMode(), true);
-						setUnifBool(uTextureMode(), false);
-
-						// Environment mapping option
-						setUnifBool(uEmMode(), option.emMode);
-						setUnifFloat(uEmFactor(), option.emFactor);
-					}
-					else if (option.shadeMode == 2) {
-						// Phong shading, with textures
-						setUnifBool(uPhongMode(), true);
-						setUnifBool(uTextureMode(), true);
-						setUnifTexture2D(uDiffuseMap(), tDiffuseMap(), option.diffuseMap);
-						setUnifTexture2D(uSpecularMap(), tSpecularMap(), option.specularMap);
-						setUnifTexture2D(uNormalMap(), tNormalMap(), option.normalMap);
-						setUnifTexture2D(uParallaxMap(), tParallaxMap(), option.parallaxMap);
-
-						// Parallax mapping option
-						if (option.parallaxMap.valid) {
-							setUnifInt(uPmOptionMode(), option.pmMode);
-							setUnifFloat(uPmOptionDepthScale(), option.pmDepthScale);
-							setUnifInt(uPmOptionMinLayers(), option.pmMinLayers);
-							setUnifInt(uPmOptionMaxLayers(), option.pmMaxLayers);
-						}
-
-						// Environment mapping option
-						setUnifBool(uEmMode(), option.emMode);
-						setUnifFloat(uEmFactor(), option.emFactor);
-					}
+					setUnifFaceState(option);
 					setUnifFloat(uAlpha(), option.alpha);
 					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-					glDrawElements(GL_QUADS, 4 * option.drawNum, GL_UNSIGNED_INT, 0);
+					beginFaceDepth(render);
+					render.drawElements(GL_QUADS, 4 * option.drawNum);
+					endFaceDepth();
 				}
 				if (option.drawEdge) {
+					if (useVariant(variantKey(render, false)))
+						setUnifMat4(uModelMat(), modelMat);
 					setUnifVec3(uEdgeColor(), option.edgeColor);
 					setUnifFloat(uAlpha(), option.alpha);
 					setUnifBool(uPolygonMode(), false);
 					glLineWidth(option.edgeWidth);
 					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-					glDrawElements(GL_QUADS, 4 * option.drawNum, GL_UNSIGNED_INT, 0);
+					render.drawElements(GL_QUADS, 4 * option.drawNum);
 				}
 				glBindVertexArray(0);
 			}
@@ -486,10 +977,14 @@ namespace ME {
 				draw(*prop.getRenderC(), modelMat);
 			return true;
 		}
-		inline bool draw(const Object& object, const glm::mat4& prevMat) {
+		// @staticBatch : If given, renders merged into it are skipped
+		inline bool draw(const Object& object, const glm::mat4& prevMat, const StaticBatch* staticBatch = nullptr) {
 			glm::mat4 modelMat = prevMat * object.getTransformC().getMat4();
-			for (const auto& prop : object.getPropertiesC())
+			for (const auto& prop : object.getPropertiesC()) {
+				if (staticBatch != nullptr && prop.second->getRenderC() != nullptr && staticBatch->contains(*prop.second->getRenderC()))
+					continue;
 				draw(*prop.second, modelMat);
+			}
 			return true;
 		}
 		inline bool draw(const Scene::Skybox& skybox) {
@@ -503,6 +998,176 @@ namespace ME {
 			}
 			return true;
 		}
+		// Indirect draw
+		// Draws of the same key share every uniform except model matrix and material.
+		inline static IndirectBatch::Key indirectKey(const Render& render) {
+			const auto& option = render.getOptionC();
+			IndirectBatch::Key key = { (float)render.type(), (float)option.drawFace, (float)option.drawEdge, option.edgeWidth, option.alpha };
+			auto addColor = [&key](const Color& color) {
+				key.push({ color.r, color.g, color.b });
+			};
+			auto addTexture = [&key](const Render::Texture2D& texture, bool packed) {
+				key.push(texture.valid ? (packed ? -2.0f : (float)texture.texture.id) : -1.0f);
+				if (texture.valid && !packed)
+					key.push({ (float)texture.filter, texture.anisotropy });
+			};
+			if (render.type() == POINT_RENDER_TYPE)
+				addColor(option.faceColor);
+			else if (render.type() == LINE_RENDER_TYPE)
+				addColor(option.edgeColor);
+			else {
+				if (option.drawEdge)
+					addColor(option.edgeColor);
+				if (option.drawFace) {
+					key.push((float)option.shadeMode);
+					if (option.shadeMode == 0)
+						addColor(option.faceColor);
+					else {
+						key.push({ (float)option.emMode, option.emFactor });
+						if (option.shadeMode == 2) {
+							addTexture(option.diffuseMap, false);
+							addTexture(option.specularMap, option.specularPacked);
+							addTexture(option.normalMap, false);
+							addTexture(option.parallaxMap, option.parallaxPacked);
+							key.push({ (float)option.pmMode, option.pmDepthScale, (float)option.pmMinLayers, (float)option.pmMaxLayers });
+						}
+					}
+				}
+			}
+			return key;
+		}
+		inline void drawIndirect(const IndirectBatch::Bucket& bucket) {
+			const auto& render = *bucket.render;
+			const auto& option = render.getOptionC();
+			const auto mode = IndirectBatch::primitiveMode(render);
+			setAttributes(render);
+
+			if (render.type() == POINT_RENDER_TYPE) {
+				useVariant(variantKey(render, true));
+				setUnifVec3(uFaceColor(), option.faceColor);
+				setUnifFloat(uAlpha(), option.alpha);
+				setUnifBool(uPolygonMode(), true);
+				setUnifBool(uTextureMode(), false);
+				setUnifBool(uPhongMode(), false);
+				glPointSize(option.edgeWidth);
+				batch.submit(bucket, mode);
+			}
+			else if (render.type() == LINE_RENDER_TYPE) {
+				useVariant(variantKey(render, false));
+				setUnifVec3(uEdgeColor(), option.edgeColor);
+				setUnifFloat(uAlpha(), option.alpha);
+				setUnifBool(uPolygonMode(), false);
+				setUnifBool(uTextureMode(), false);
+				setUnifBool(uPhongMode(), false);
+				glLineWidth(option.edgeWidth);
+				batch.submit(bucket, mode);
+			}
+			else {
+				if (option.drawFace) {
+					useVariant(variantKey(render, true));
+					setUnifBool(uPolygonMode(), true);
+					setUnifFaceState(option);
+					setUnifFloat(uAlpha(), option.alpha);
+					glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+					beginFaceDepth(render);
+					batch.submit(bucket, mode);
+					endFaceDepth();
+				}
+				if (option.drawEdge) {
+					useVariant(variantKey(render, false));
+					setUnifVec3(uEdgeColor(), option.edgeColor);
+					setUnifFloat(uAlpha(), option.alpha);
+					setUnifBool(uPolygonMode(), false);
+					glLineWidth(option.edgeWidth);
+					glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+					batch.submit(bucket, mode);
+				}
+			}
+		}
+		// Gather every render of the scene into [ batch ], and draw each bucket with one call.
+		// Renders that are not in [ BufferArena ] are drawn one by one as before.
+		inline bool drawIndirect(const Scene& scene) {
+			if (!batchValid) {
+				batch = IndirectBatch::create();
+				batchValid = true;
+			}
+			batch.clear();
+
+			const auto& staticBatch = scene.getStaticBatchC();
+			struct Item {
+				int         id;
+				glm::mat4   modelMat;
+			};
+			auto& graph = scene.getGraphC();
+			int root = scene.getRoot();
+
+			Item rootItem;
+			rootItem.id = root;
+			rootItem.modelMat = graph.at(root).getObjectC()->getTransformC().getMat4();
+
+			// Blended draws depend on order, so they stay out of buckets and are drawn after them in scene order
+			struct Blended {
+				const Render*	render;
+				glm::mat4		modelMat;
+			};
+			std::vector<Blended> blended;
+
+			std::vector<Item> drawQueue;
+			drawQueue.reserve(graph.size());
+			drawQueue.push_back(rootItem);
+			while (!drawQueue.empty()) {
+				Item item = drawQueue.back(); drawQueue.pop_back();
+				auto& node = graph.at(item.id);
+				auto& object = node.getObjectC();
+
+				item.modelMat = item.modelMat * object->getTransformC().getMat4();
+				for (const auto& prop : object->getPropertiesC()) {
+					const auto& render = prop.second->getRenderC();
+					if (render == nullptr || staticBatch.contains(*render))
+						continue;
+					const auto& option = render->getOptionC();
+					if (option.alpha < 1.0f) {
+						blended.push_back({ render.get(), item.modelMat });
+						continue;
+					}
+					int material = (option.shadeMode == 1 ? batch.addMaterial(option.material) : 0);
+					if (!batch.add(*render, item.modelMat, indirectKey(*render), IndirectBatch::indexCount(*render), material))
+						draw(*render, item.modelMat);
+				}
+				for (auto child : node.getChildC()) {
+					item.id = child;
+					drawQueue.push_back(item);
+				}
+			}
+
+			// Merged static geometry, only visible chunks of it
+			for (const auto& merged : staticBatch.getBatchesC()) {
+				const auto& render = *merged.render;
+				const auto& option = render.getOptionC();
+				if (option.alpha < 1.0f) {
+					blended.push_back({ &render, glm::mat4(1.0f) });
+					continue;
+				}
+				int material = (option.shadeMode == 1 ? batch.addMaterial(option.material) : 0);
+				for (const auto& range : merged.visibleRanges)
+					batch.add(render, glm::mat4(1.0f), indirectKey(render), (uint)range.indexNum, material, (uint)range.firstIndex);
+			}
+			batch.upload();
+
+			enable();
+			indirectDraw = true;
+			setUnifBool(uIndirectMode(), true);
+			batch.bindDrawData(tDrawData());
+			batch.bindMaterialData(tMaterialData());
+			for (const auto& bucket : batch.getBucketsC())
+				drawIndirect(bucket);
+			setUnifBool(uIndirectMode(), false);
+			indirectDraw = false;
+			for (const auto& b : blended)
+				draw(*b.render, b.modelMat);
+			return true;
+		}
+
 		inline bool draw(const Scene& scene) {
 			draw(scene.getSkyboxC());
 
@@ -510,6 +1175,27 @@ namespace ME {
 			draw(scene.getLightManagerC());
 
 			// Second draw objects
+			return drawObjects(scene);
+		}
+		// Draw every object of [ scene ], lights and skybox must be set before
+		inline bool drawObjects(const Scene& scene) {
+			// Variants take camera and lights from the program set up by now
+			uberProgram = program;
+			frameScene = &scene;
+			frame++;
+			const bool ret = traverseObjects(scene);
+			// Material samplers would override parameters of whatever other passes bind to these units
+			for (uint unit : { tDiffuseMap(), tSpecularMap(), tNormalMap(), tParallaxMap() })
+				glBindSampler(unit, 0);
+			program = uberProgram;
+			uberProgram = 0;
+			frameScene = nullptr;
+			return ret;
+		}
+		inline bool traverseObjects(const Scene& scene) {
+			if (indirectMode && IndirectBatch::supported())
+				return drawIndirect(scene);
+
 			struct Item {
 				int         id;
 				glm::mat4   modelMat;
@@ -529,7 +1215,7 @@ namespace ME {
 				auto& node = graph.at(item.id);
 				auto& object = node.getObjectC();
 
-				draw(*object, item.modelMat);
+				draw(*object, item.modelMat, &scene.getStaticBatchC());
 
 				item.modelMat = item.modelMat * object->getTransformC().getMat4();
 				for (auto child : node.getChildC()) {
@@ -537,6 +1223,10 @@ namespace ME {
 					drawQueue.push_back(item);
 				}
 			}
+
+			// Merged static geometry is already in world space
+			for (const auto& merged : scene.getStaticBatchC().getBatchesC())
+				draw(*merged.render, glm::mat4(1.0f));
 			return true;
 		}
 	};
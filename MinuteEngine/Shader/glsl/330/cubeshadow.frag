@@ -0,0 +1,19 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+in vec3 worldPosition;
+
+uniform vec3 lightPosition;
+uniform float farPlane;
+
+void main(void) {
+    // Store linear distance from the light, so that every face shares the same depth scale
+    gl_FragDepth = length(worldPosition - lightPosition) / farPlane;
+}
\ No newline at end of file
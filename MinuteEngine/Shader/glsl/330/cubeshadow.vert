@@ -0,0 +1,32 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+/* ---------------------------------------------------------------------------------  Attributes */
+// If we do not use these variables, compiler can throw them away!
+layout (location = 0) in vec3 position;
+layout (location = 5) in int drawID;        // Index of per-draw data, only used in indirect mode
+/* --------------------------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------------  Uniform */
+uniform mat4 modelMat;
+
+uniform bool indirectMode;          // If true, fetch model matrix from [ drawData ] instead of [ modelMat ].
+uniform samplerBuffer drawData;     // 5 texels per draw : 4 columns of model matrix, ( material index, 0, 0, 0 )
+/* ------------------------------------------------------------------------------------------ */
+
+void main(void)
+{
+    mat4 model = modelMat;
+    if (indirectMode) {
+        int base = drawID * 5;
+        model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    }
+    gl_Position = model * vec4(position.xyz, 1.0);     // World coords, projected to each face in geometry shader
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+out vec4 FragColor;
+
+in vec4 oColor;
+
+void main() {
+	FragColor = oColor;
+}
\ No newline at end of file
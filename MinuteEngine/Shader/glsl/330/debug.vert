@@ -0,0 +1,29 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+/* ---------------------------------------------------------------------------------  In */
+// If we do not use these variables, compiler can throw them away!
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec4 color;
+/* --------------------------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------------  Out */
+out vec4 oColor;
+/* --------------------------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------------  Uniform */
+uniform mat4 viewMat;	// Debug primitives are given in world space, so do not need model matrix!
+uniform mat4 projMat;
+/* ------------------------------------------------------------------------------------------ */
+
+void main() {
+	oColor = color;
+	gl_Position = projMat * viewMat * vec4(position, 1.0);
+}
\ No newline at end of file
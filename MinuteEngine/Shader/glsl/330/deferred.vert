@@ -0,0 +1,48 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+// Lighting pass of deferred shading. Linked with standard.frag, so it provides every output that
+// standard.vert does, though positions are read from G-buffer there.
+
+/* ---------------------------------------------------------------------------------  Uniform */
+uniform mat4 viewMat;
+/* ------------------------------------------------------------------------------------------ */
+
+/* ---------------------------------------------------------------------------------  Out */
+out mat4 oModelMat;
+out mat4 oViewMat;
+out mat4 oModelViewMat;
+
+out vec3 oPosition;
+out vec3 oNormal;
+out vec3 oTexCoord;
+out vec3 oTangent;
+out vec3 oBitangent;
+
+flat out int oDrawID;
+/* ------------------------------------------------------------------------------------------ */
+
+void main(void)
+{
+    oModelMat = mat4(1.0);
+    oViewMat = viewMat;
+    oModelViewMat = viewMat;
+    oDrawID = 0;
+
+    oPosition = vec3(0.0);
+    oNormal = vec3(0.0, 0.0, 1.0);
+    oTexCoord = vec3(0.0);
+    oTangent = vec3(1.0, 0.0, 0.0);
+    oBitangent = vec3(0.0, 1.0, 0.0);
+
+    // Full screen triangle
+    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+// Only depth is written, color writes are masked
+void main(void) {
+}
\ No newline at end of file
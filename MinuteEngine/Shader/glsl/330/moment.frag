@@ -0,0 +1,42 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+in vec2 texCoord;
+out vec4 FragColor;
+
+/* ---------------------------------------------------------------------------------  Uniform */
+uniform sampler2D source;       // Depth map ( [ fromDepth ] ) or moments
+uniform bool fromDepth;         // If true, convert depth into moments before blurring
+uniform vec4 sourceRect;        // Region of [ source ] to read : ( x, y, width, height ) in texture coords
+uniform vec2 step;              // Offset between taps in texture coords of [ source ]
+uniform vec2 exponents;         // Positive and negative exponents of EVSM warp
+uniform int radius;
+uniform float weights[16];      // Gaussian weights of offset 0 ... [ radius ]
+/* ------------------------------------------------------------------------------------------ */
+
+vec4 fetchMoments(vec2 coords) {
+    vec4 value = texture(source, clamp(coords, sourceRect.xy, sourceRect.xy + sourceRect.zw));
+    if (!fromDepth)
+        return value;
+    float depth = value.r * 2.0 - 1.0;
+    float pos = exp(exponents.x * depth);
+    float neg = -exp(-exponents.y * depth);
+    return vec4(pos, pos * pos, neg, neg * neg);
+}
+
+void main(void) {
+    vec2 coords = sourceRect.xy + texCoord * sourceRect.zw;
+    vec4 sum = fetchMoments(coords) * weights[0];
+    for (int i = 1; i <= radius; i++) {
+        sum += fetchMoments(coords + step * float(i)) * weights[i];
+        sum += fetchMoments(coords - step * float(i)) * weights[i];
+    }
+    FragColor = sum;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+//
+// *******************************************************************************************
+// Author	: Sang Hyun Son 
+// Email	: shh1295@gmail.com
+// Github	: github.com/SonSang
+// *******************************************************************************************
+//
+
+#version 330 core
+
+out vec2 texCoord;
+
+void main(void)
+{
+    // Full screen triangle : ( 0, 0 ), ( 2, 0 ), ( 0, 2 ) in texture coords
+    vec2 p = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    texCoord = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -11,14 +11,23 @@
 /* ---------------------------------------------------------------------------------  Attributes */
 // If we do not use these variables, compiler can throw them away!
 layout (location = 0) in vec3 position;
+layout (location = 5) in int drawID;        // Index of per-draw data, only used in indirect mode
 /* --------------------------------------------------------------------------------------------- */
 
 /* ---------------------------------------------------------------------------------  Uniform */
 uniform mat4 lightSpaceMat;     // Transform matrix that takes world coords vector to light space coords vector
 uniform mat4 modelMat;
+
+uniform bool indirectMode;          // If true, fetch model matrix from [ drawData ] instead of [ modelMat ].
+uniform samplerBuffer drawData;     // 5 texels per draw : 4 columns of model matrix, ( material index, 0, 0, 0 )
 /* ------------------------------------------------------------------------------------------ */
 
 void main(void)
 {
-    gl_Position = lightSpaceMat * modelMat * vec4(position.xyz, 1.0);
+    mat4 model = modelMat;
+    if (indirectMode) {
+        int base = drawID * 5;
+        model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    }
+    gl_Position = lightSpaceMat * model * vec4(position.xyz, 1.0);
 }
\ No newline at end of file
@@ -9,7 +9,25 @@
 #version 330 core
 
 // Final output
-out vec4 FragColor;
+layout (location = 0) out vec4 FragColor;     // Emission in deferred geometry pass
+
+// Deferred shading : DEFERRED_GEOMETRY_PASS writes surfaces into G-buffer, DEFERRED_LIGHTING_PASS shades them.
+#ifdef DEFERRED_GEOMETRY_PASS
+layout (location = 1) out vec4 gDiffuse;        // Diffuse, encoded shininess
+layout (location = 2) out vec4 gSpecular;       // Specular, 1 if lit
+layout (location = 3) out vec4 gAmbient;
+layout (location = 4) out vec2 gNormal;         // Octahedral view space normal in [ 0, 1 ]
+#endif
+#ifdef DEFERRED_LIGHTING_PASS
+uniform sampler2D gbufferEmission;
+uniform sampler2D gbufferDiffuse;
+uniform sampler2D gbufferSpecular;
+uniform sampler2D gbufferAmbient;
+uniform sampler2D gbufferNormal;
+uniform sampler2D gbufferDepth;
+uniform mat4 invProjMat;
+uniform mat4 invViewMat;
+#endif
 
 // Material structure
 struct Material {
@@ -24,11 +42,26 @@ uniform vec3 faceColor;
 uniform vec3 edgeColor;     // Only needed for geometric entities with face.
 uniform float alpha;
 
+// In a permutation ( STANDARD_VARIANT ), these switches are constants given by VARIANT_* defines,
+// so that the compiler removes every branch the variant does not take.
+#ifdef STANDARD_VARIANT
+const bool polygonMode = VARIANT_POLYGON_MODE;
+const bool textureMode = VARIANT_TEXTURE_MODE;
+const bool phongMode = VARIANT_PHONG_MODE;
+#else
 uniform bool polygonMode;   // If true, render face (GL_FILL). Else, render line (GL_LINE).
 uniform bool textureMode;   // If true, use texture to render instead of material.
 uniform bool phongMode;     // If true, use Phong shading. Else, use simple shading. 
+#endif
 uniform Material    material;   // Used for Phong shading.
 
+// Indirect mode : material comes from [ materialData ] by per-draw material index.
+uniform bool indirectMode;
+uniform samplerBuffer drawData;
+uniform samplerBuffer materialData;     // 5 texels per material : emission, ambient, diffuse, specular, ( shininess, 0, 0, 0 )
+flat in int oDrawID;
+Material curMaterial;
+
 // ==================================================== Lights =============================================== //
 // Light structure
 struct Light {
@@ -40,18 +73,60 @@ struct Light {
     vec3 diffuse;
     vec3 specular;
     bool valid;
+    float range;    // Point light fades out to zero at this distance, 0 means no fall off
 };
 uniform int         lightNum;
-uniform Light       light[16];      // Used for Phong shading
+uniform Light       light[16];      // Used for Phong shading, lights that are not clustered
+float lightAttenuation(Light light);
+float rangeAttenuation(float dist, float range);
+// ==================================================== Clustered lights ===================================== //
+// Point lights with range are binned into froxels on CPU, a fragment only visits the lights of its cluster.
+uniform bool            clusterMode;
+uniform ivec3           clusterGrid;            // Number of clusters along screen x, screen y and depth
+uniform vec2            clusterTileSize;        // Screen size of a cluster in pixels
+uniform vec2            clusterDepthParams;     // Depth slice = log( view depth ) * x + y
+uniform samplerBuffer   clusterLightData;       // 4 texels per light : ( view position, range ), ambient, diffuse, specular
+uniform usamplerBuffer  clusterRecords;         // ( offset, count ) of each cluster in [ clusterIndices ]
+uniform usamplerBuffer  clusterIndices;         // Light indices of every cluster, packed
+int clusterIndex();
+vec3 clusterLighting(vec3 ambient, vec3 diffuse, vec3 specular, float shininess, vec3 normal);
 // ==================================================== Shadows ============================================== //
 // Shadow structure
 struct Shadow {
-    sampler2D data;                 // Shadow map
     mat4 shadowMat;                 // Transform that takes world coords to depth map's local coords
+    vec4 rect;                      // Tile of the shadow atlas : ( x, y, width, height ) in texture coords
+    int variance;                   // Index of [ varianceMaps ], -1 if PCF is used
+    vec2 exponents;                 // EVSM warp exponents of the moment map
+    float bleedReduction;
     bool valid;
 };
 uniform int         shadowNum;
 uniform Shadow      shadow[16];     // Used for shadow mapping ( for each light )
+uniform sampler2DShadow shadowAtlas;    // Shadow maps of every light, packed in a single texture
+uniform sampler2D   varianceMaps[4];    // Pre-filtered ( blurred, mip-mapped ) EVSM moments of shadows
+// Cascaded shadow of a directional light, used instead of its [ shadow ]
+struct CascadedShadow {
+    sampler2DArrayShadow data;      // Shadow map of each cascade in a layer
+    mat4 shadowMat[4];              // Transform that takes world coords to each cascade's local coords
+    float splits[4];                // View space far distance of each cascade
+    int num;
+    float blendRatio;               // Last part of each cascade that is blended into the next one
+    bool valid;
+};
+uniform CascadedShadow csm;
+// Cube shadow of a point light, stores distance from the light divided by [ farPlane ]
+struct CubeShadow {
+    samplerCubeShadow data;
+    vec3 position;                  // Position of the light
+    float farPlane;
+};
+uniform int         cubeShadowNum;
+uniform CubeShadow  cubeShadow[4];
+// Filtering of every shadow map. Each tap is compared by hardware with bilinear PCF.
+uniform int         shadowFilter;           // 0 : Hard ( 1 tap )
+                                            // 1 : Gaussian ( 9 weighted taps )
+                                            // 2 : Poisson disk ( 8 taps, rotated per pixel )
+uniform float       shadowFilterRadius;     // Radius of Poisson disk in texels
 // ==================================================== Textures ============================================= //
 in vec3 oTexCoord;
 
@@ -64,6 +139,26 @@ uniform Texture2D diffuseMap;
 uniform Texture2D specularMap;
 uniform Texture2D normalMap;
 uniform Texture2D parallaxMap;
+#ifdef STANDARD_VARIANT
+#define DIFFUSE_MAP_VALID   VARIANT_DIFFUSE_MAP
+#define SPECULAR_MAP_VALID  VARIANT_SPECULAR_MAP
+#define NORMAL_MAP_VALID    VARIANT_NORMAL_MAP
+#define PARALLAX_MAP_VALID  VARIANT_PARALLAX_MAP
+#else
+#define DIFFUSE_MAP_VALID   diffuseMap.valid
+#define SPECULAR_MAP_VALID  specularMap.valid
+#define NORMAL_MAP_VALID    normalMap.valid
+#define PARALLAX_MAP_VALID  parallaxMap.valid
+#endif
+// Packed maps ( Texture2D::createPacked() ) : specular is alpha of diffuse map, height is blue of normal map.
+// Their own samplers are not bound then.
+#ifdef STANDARD_VARIANT
+const bool specularPacked = VARIANT_SPECULAR_PACKED;
+const bool parallaxPacked = VARIANT_PARALLAX_PACKED;
+#else
+uniform bool specularPacked;
+uniform bool parallaxPacked;
+#endif
 // =========================================================================================================== //
 
 // Matrix
@@ -82,6 +177,7 @@ in vec3 oBitangent;
 // Global variables : These variables are assumed to be ready before any subroutine is called
 vec3 eyePosition;
 vec3 eyeNormal;
+vec3 worldPosition;
 
 mat3 TBN;       // Tangent - Bitangent - Normal matrix that takes a vector in normal map local space to world space
 mat3 eyeTBN;    // TBN matrix that takes a vector in normal map local space to view space
@@ -92,7 +188,14 @@ vec3 phongLightSpecular(vec3 specular, float shininess, vec3 normal, Light pl);
 /* ============================================================================================= */
 
 /* ================================== Shadow =================================================== */
-float inShadowFactor(Shadow shadow);    // 1.0 (Fully in shadow) - 0.0 (Fully out shadow)
+const float shadowDarkness = 1.0 / 1.5; // Every kind of shadow is scaled by this, so that fully shadowed is not black
+float inShadowFactor(Shadow shadow);    // [ shadowDarkness ] (Fully in shadow) - 0.0 (Fully out shadow)
+float inShadowFactor(CascadedShadow csm);
+float inShadowFactor(CubeShadow cs);
+int shadowKernelSize();
+vec2 shadowKernelOffset(int i);         // In texels
+float shadowKernelWeight(int i);
+float varianceShadowFactor(Shadow shadow, vec3 shadowMapCoords);
 /* ============================================================================================= */
 
 /* ================================== Parallax mapping ========================================= */
@@ -105,28 +208,54 @@ struct PMOption {
     int maxLayers;
 };
 uniform PMOption pmOption;
+#ifdef STANDARD_VARIANT
+#define PM_MODE     VARIANT_PM_MODE
+#else
+#define PM_MODE     pmOption.mode
+#endif
 vec3 pmSingle();        // Use single layer sampling to determine new texture coordinates
 vec3 pmMultiple();      // Use multi layer sampling to determine new texture coordinates
 vec3 pmOcclusion();     // Use multi layer sampling and linear interpolation to determine new texture coordinates
+float pmHeight(vec2 texCoord);  // Height from parallax map, or from normal map it is packed into
 /* ============================================================================================= */
 
 /* ================================== Environment mapping ========================================= */
 uniform samplerCube envMap;
 uniform vec3 cameraPosition;
+#ifdef STANDARD_VARIANT
+const bool emMode = VARIANT_EM_MODE;
+#else
 uniform bool emMode;
+#endif
 uniform float emFactor;
 /* ============================================================================================= */
 
-vec3 renderByTexture() {
-    vec3 ret = vec3(0.0, 0.0, 0.0);
+// Surface attributes that lighting needs. Filled from textures or material, or read from G-buffer.
+struct Surface {
+    vec3 emission;      // Added without lighting
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float shininess;
+    vec3 normal;        // View space
+    bool lit;           // If false, only [ emission ] is used
+};
+Surface surfaceByTexture() {
+    Surface surface;
+    surface.emission = vec3(0.0, 0.0, 0.0);
+    surface.ambient = vec3(0.0, 0.0, 0.0);
+    surface.diffuse = vec3(0.0, 0.0, 0.0);
+    surface.specular = vec3(0.0, 0.0, 0.0);
+    surface.shininess = 1000.0;
+    surface.normal = eyeNormal;
+    surface.lit = phongMode;
     
     if (phongMode) {
-        vec3 normal;
         vec3 texCoord;
-        if (parallaxMap.valid) {
-            if (pmOption.mode == 0)
+        if (PARALLAX_MAP_VALID) {
+            if (PM_MODE == 0)
                 texCoord = pmSingle();
-            else if (pmOption.mode == 1)
+            else if (PM_MODE == 1)
                 texCoord = pmMultiple();
             else
                 texCoord = pmOcclusion();
@@ -145,39 +274,26 @@ vec3 renderByTexture() {
         }
         else 
             texCoord = oTexCoord;
-        if (normalMap.valid) {
+        if (NORMAL_MAP_VALID) {
             // (Normal texture's) Local space normal
-            normal = texture2D(normalMap.data, texCoord.st).rgb;
-            normal = normalize(normal * 2.0 - 1.0);     // Domain change from [0, 1] to [-1, 1]
+            // Only x and y are read, since BC5 normal maps do not store z. It is always toward the surface.
+            vec2 normalXY = texture2D(normalMap.data, texCoord.st).rg * 2.0 - 1.0;     // Domain change from [0, 1] to [-1, 1]
+            vec3 normal = normalize(vec3(normalXY, sqrt(max(0.0, 1.0 - dot(normalXY, normalXY)))));
 
             // View space normal
-            normal = eyeTBN * normal;
+            surface.normal = eyeTBN * normal;
         }
-        else
-            normal = eyeNormal;
-
-        float shadowFactor = 0.0;
-        for(int i = 0; i < shadowNum; i++) {
-            if(shadow[i].valid) {
-                float tmpShadowFactor = inShadowFactor(shadow[i]);
-                if(tmpShadowFactor > shadowFactor)
-                    shadowFactor = tmpShadowFactor;
-            }
-        }   
-
-        if (diffuseMap.valid) {
-            vec3 diffuse = vec3(0.0, 0.0, 0.0);
-            vec3 diffusePixel = texture2D(diffuseMap.data, texCoord.st).rgb;
-            for (int i = 0; i < lightNum; i++)
-                diffuse += phongLightDiffuse(diffusePixel, normal, light[i]);
-            ret = diffuse * (1.0 - shadowFactor);
+
+        vec4 diffuseTexel = vec4(0.0);
+        if (DIFFUSE_MAP_VALID) {
+            diffuseTexel = texture2D(diffuseMap.data, texCoord.st);
+            surface.diffuse = diffuseTexel.rgb;
         }
-        if (specularMap.valid) {
-            vec3 specular = vec3(0.0, 0.0, 0.0);
-            vec3 specularPixel = texture2D(specularMap.data, texCoord.st).rgb;
-            for (int i = 0; i < lightNum; i++)
-                specular += phongLightSpecular(specularPixel, 1000.0, normal, light[i]);
-            ret += specular * (1.0 - shadowFactor);
+        if (SPECULAR_MAP_VALID) {
+            if (specularPacked)
+                surface.specular = vec3(diffuseTexel.a);
+            else
+                surface.specular = texture2D(specularMap.data, texCoord.st).rgb;
         }
 
         if(emMode) {
@@ -186,24 +302,58 @@ vec3 renderByTexture() {
             vec3 I = normalize(wPosition - cameraPosition);
             vec3 R = reflect(I, normalize(wNormal));
             vec3 emColor = texture(envMap, R).rgb;
-            ret += emColor * emFactor;
+            surface.emission = emColor * emFactor;
         }
     }
     else {
-        if (diffuseMap.valid) 
-            ret = texture2D(diffuseMap.data, oTexCoord.st).rgb;
+        if (DIFFUSE_MAP_VALID) 
+            surface.emission = texture2D(diffuseMap.data, oTexCoord.st).rgb;
     }
-    return ret;
+    return surface;
+}
+Surface surfaceByMaterial() {
+    // Environment
+    vec3 environment = vec3(0.0, 0.0, 0.0);
+    if(emMode) {
+        vec3 wPosition = (oModelMat * vec4(oPosition, 1.0)).xyz;
+        vec3 wNormal = (oModelMat * vec4(oNormal, 0.0)).xyz;
+        vec3 I = normalize(wPosition - cameraPosition);
+        vec3 R = reflect(I, normalize(wNormal));
+        vec3 emColor = texture(envMap, R).rgb;
+        environment = emColor * emFactor;
+    }
+
+    Surface surface;
+    surface.emission = curMaterial.emission;
+    surface.ambient = curMaterial.ambient;
+    surface.diffuse = curMaterial.diffuse + environment;
+    surface.specular = curMaterial.specular;
+    surface.shininess = curMaterial.shininess;
+    surface.normal = eyeNormal;
+    surface.lit = true;
+    return surface;
+}
+Surface surfaceByColor(vec3 color) {
+    Surface surface;
+    surface.emission = color;
+    surface.ambient = vec3(0.0, 0.0, 0.0);
+    surface.diffuse = vec3(0.0, 0.0, 0.0);
+    surface.specular = vec3(0.0, 0.0, 0.0);
+    surface.shininess = 1.0;
+    surface.normal = eyeNormal;
+    surface.lit = false;
+    return surface;
 }
 
-vec3 renderByMaterial() {
-    // Emission
-    vec3 emission = material.emission;
+// Phong shading of [ surface ] by every light
+vec3 shade(Surface surface) {
+    if (!surface.lit)
+        return surface.emission;
 
     // Ambient
     vec3 ambient = vec3(0.0, 0.0, 0.0);
     for (int i = 0; i < lightNum; i++)
-        ambient += material.ambient.rgb * light[i].ambient.rgb;
+        ambient += surface.ambient * light[i].ambient.rgb * lightAttenuation(light[i]);
 
     float shadowFactor = 0.0;
     for(int i = 0; i < shadowNum; i++) {
@@ -213,34 +363,89 @@ vec3 renderByMaterial() {
                 shadowFactor = tmpShadowFactor;
         }
     }   
-
-    // Environment
-    vec3 environment;
-    if(emMode) {
-        vec3 wPosition = (oModelMat * vec4(oPosition, 1.0)).xyz;
-        vec3 wNormal = (oModelMat * vec4(oNormal, 0.0)).xyz;
-        vec3 I = normalize(wPosition - cameraPosition);
-        vec3 R = reflect(I, normalize(wNormal));
-        vec3 emColor = texture(envMap, R).rgb;
-        environment = emColor * emFactor;
-    }
+    shadowFactor = max(shadowFactor, inShadowFactor(csm));
+    for(int i = 0; i < cubeShadowNum; i++)
+        shadowFactor = max(shadowFactor, inShadowFactor(cubeShadow[i]));
 
     // Diffuse.
-    vec3 normal = eyeNormal;
     vec3 diffuse = vec3(0.0, 0.0, 0.0);
     for (int i = 0; i < lightNum; i++)
-        diffuse += phongLightDiffuse(material.diffuse + environment, normal, light[i]);
+        diffuse += phongLightDiffuse(surface.diffuse, surface.normal, light[i]);
     diffuse = diffuse * (1.0 - shadowFactor);
 
     // Specular.
     vec3 specular = vec3(0.0, 0.0, 0.0);
     for (int i = 0; i < lightNum; i++)
-        specular += phongLightSpecular(material.specular, material.shininess, normal, light[i]);
+        specular += phongLightSpecular(surface.specular, surface.shininess, surface.normal, light[i]);
     specular = specular * (1.0 - shadowFactor);
 
-    return emission + ambient + diffuse + specular;
+    // Clustered lights, they do not cast shadows.
+    vec3 clustered = vec3(0.0, 0.0, 0.0);
+    if (clusterMode)
+        clustered = clusterLighting(surface.ambient, surface.diffuse, surface.specular, surface.shininess, surface.normal);
+
+    return surface.emission + ambient + diffuse + specular + clustered;
+}
+
+// Octahedral normal encoding : fold the lower hemisphere of the octahedron onto the upper one
+vec2 octEncode(vec3 n) {
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    vec2 p = n.xy;
+    if (n.z < 0.0)
+        p = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return p;
+}
+vec3 octDecode(vec2 p) {
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+// Shininess in [ 1, 2048 ] stored in 8 bits, logarithmically
+float encodeShininess(float shininess) {
+    return clamp(log2(max(shininess, 1.0)) / 11.0, 0.0, 1.0);
+}
+float decodeShininess(float code) {
+    return exp2(code * 11.0);
 }
 
+#ifdef DEFERRED_GEOMETRY_PASS
+void writeGBuffer(Surface surface) {
+    FragColor = vec4(surface.emission, 1.0);
+    gDiffuse = vec4(surface.diffuse, encodeShininess(surface.shininess));
+    gSpecular = vec4(surface.specular, surface.lit ? 1.0 : 0.0);
+    gAmbient = vec4(surface.ambient, 1.0);
+    gNormal = octEncode(normalize(surface.normal)) * 0.5 + 0.5;
+}
+#endif
+#ifdef DEFERRED_LIGHTING_PASS
+// Read surface at this pixel and restore positions from depth. Returns false if nothing was drawn there.
+bool readGBuffer(out Surface surface) {
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepth, coords, 0).r;
+    if (depth >= 1.0)
+        return false;
+    gl_FragDepth = depth;       // Later passes are depth tested against G-buffer
+
+    vec2 ndc = gl_FragCoord.xy / vec2(textureSize(gbufferDepth, 0)) * 2.0 - 1.0;
+    vec4 eye = invProjMat * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    eyePosition = eye.xyz / eye.w;
+    worldPosition = (invViewMat * vec4(eyePosition, 1.0)).xyz;
+
+    vec4 diffuse = texelFetch(gbufferDiffuse, coords, 0);
+    vec4 specular = texelFetch(gbufferSpecular, coords, 0);
+    surface.emission = texelFetch(gbufferEmission, coords, 0).rgb;
+    surface.ambient = texelFetch(gbufferAmbient, coords, 0).rgb;
+    surface.diffuse = diffuse.rgb;
+    surface.specular = specular.rgb;
+    surface.shininess = decodeShininess(diffuse.a);
+    surface.normal = octDecode(texelFetch(gbufferNormal, coords, 0).xy * 2.0 - 1.0);
+    surface.lit = (specular.a > 0.5);
+    eyeNormal = surface.normal;
+    return true;
+}
+#endif
+
 // Compute TBN matrix ( with Gram - Schmidt diagonalization )
 void computeTBN() {
     // World TBN
@@ -259,23 +464,52 @@ void computeTBN() {
     eyeTBN = mat3(T, B, N);
 }
 
+void fetchMaterial() {
+    if (indirectMode) {
+        int base = int(texelFetch(drawData, oDrawID * 5 + 4).x) * 5;
+        curMaterial.emission = texelFetch(materialData, base).rgb;
+        curMaterial.ambient = texelFetch(materialData, base + 1).rgb;
+        curMaterial.diffuse = texelFetch(materialData, base + 2).rgb;
+        curMaterial.specular = texelFetch(materialData, base + 3).rgb;
+        curMaterial.shininess = texelFetch(materialData, base + 4).x;
+    }
+    else
+        curMaterial = material;
+}
+
 void main(void) {
+#ifdef DEFERRED_LIGHTING_PASS
+    Surface surface;
+    if (!readGBuffer(surface))
+        discard;
+    FragColor = vec4(shade(surface), 1.0);
+#else
+    fetchMaterial();
     eyePosition = (oModelViewMat * vec4(oPosition, 1.0)).xyz;
     eyeNormal = normalize((oModelViewMat * vec4(oNormal.xyz, 0.0)).xyz);
+    worldPosition = (oModelMat * vec4(oPosition, 1.0)).xyz;
     computeTBN();
 
+    Surface surface;
     if(polygonMode) {
         if (textureMode)
-            FragColor = vec4(renderByTexture(), alpha);
+            surface = surfaceByTexture();
         else {
             if (phongMode)
-                FragColor = vec4(renderByMaterial(), alpha);
+                surface = surfaceByMaterial();
             else
-                FragColor = vec4(faceColor, alpha);
+                surface = surfaceByColor(faceColor);
         }        
     }
     else
-        FragColor = vec4(edgeColor, alpha);
+        surface = surfaceByColor(edgeColor);
+
+#ifdef DEFERRED_GEOMETRY_PASS
+    writeGBuffer(surface);
+#else
+    FragColor = vec4(shade(surface), alpha);
+#endif
+#endif
 }
 
 /* ================================== Phong shading by light =================================== */
@@ -294,7 +528,7 @@ vec3 phongLightDiffuse(vec3 diffuse, vec3 normal, Light light) {
     float diffuseFactor = dot(normal, lightDir);
 //    if (diffuseFactor < 0.0)
 //        diffuseFactor = -diffuseFactor;         // Back face rendering
-    return diffuseFactor * (light.diffuse.rgb * diffuse.rgb);
+    return diffuseFactor * lightAttenuation(light) * (light.diffuse.rgb * diffuse.rgb);
 }
 vec3 phongLightSpecular(vec3 specular, float shininess, vec3 normal, Light light) {
     vec3 lightDir;
@@ -311,49 +545,224 @@ vec3 phongLightSpecular(vec3 specular, float shininess, vec3 normal, Light light
     vec3 viewDir = normalize(-eyePosition);    // In eye space, camera is at (0, 0, 0);
     vec3 reflectDir = reflect(-lightDir, normal);
     float specularFactor = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
-    return specularFactor * (light.specular.rgb * specular);
+    return specularFactor * lightAttenuation(light) * (light.specular.rgb * specular);
+}
+float rangeAttenuation(float dist, float range) {
+    if (range <= 0.0)
+        return 1.0;
+    // Smooth window that reaches zero exactly at [ range ], so that clusters can bound the light
+    float ratio = dist / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window;
+}
+float lightAttenuation(Light light) {
+    if (light.type == 0)
+        return 1.0;
+    vec3 lightPos = (oViewMat * vec4(light.position, 1.0)).xyz;
+    return rangeAttenuation(length(lightPos - eyePosition), light.range);
+}
+int clusterIndex() {
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), clusterGrid.xy - 1);
+    float depth = max(-eyePosition.z, 1e-4);
+    int slice = clamp(int(floor(log(depth) * clusterDepthParams.x + clusterDepthParams.y)), 0, clusterGrid.z - 1);
+    return tile.x + clusterGrid.x * (tile.y + clusterGrid.y * slice);
+}
+vec3 clusterLighting(vec3 ambient, vec3 diffuse, vec3 specular, float shininess, vec3 normal) {
+    vec3 ret = vec3(0.0, 0.0, 0.0);
+    vec3 viewDir = normalize(-eyePosition);
+    uvec2 record = texelFetch(clusterRecords, clusterIndex()).xy;
+    for (uint i = 0u; i < record.y; i++) {
+        int base = int(texelFetch(clusterIndices, int(record.x + i)).x) * 4;
+        vec4 positionRange = texelFetch(clusterLightData, base);
+        vec3 toLight = positionRange.xyz - eyePosition;
+        float dist = length(toLight);
+        float attenuation = rangeAttenuation(dist, positionRange.w);
+        if (attenuation <= 0.0)
+            continue;
+
+        vec3 lightDir = toLight / max(dist, 1e-4);
+        float diffuseFactor = max(dot(normal, lightDir), 0.0);
+        float specularFactor = pow(max(dot(viewDir, reflect(-lightDir, normal)), 0.0), shininess);
+        ret += attenuation * (
+            ambient * texelFetch(clusterLightData, base + 1).rgb +
+            diffuseFactor * diffuse * texelFetch(clusterLightData, base + 2).rgb +
+            specularFactor * specular * texelFetch(clusterLightData, base + 3).rgb);
+    }
+    return ret;
 }
 /* ============================================================================================= */
 
 /* ================================== Shadow =================================================== */
+// Poisson disk in the unit circle
+const vec2 poissonDisk[8] = vec2[8](
+    vec2(-0.613392, 0.617481), vec2(0.170019, -0.040254), vec2(-0.299417, 0.791925), vec2(0.645680, 0.493210),
+    vec2(-0.651784, 0.717887), vec2(0.421003, 0.027070), vec2(-0.817194, -0.271096), vec2(0.977050, -0.108615)
+);
+int shadowKernelSize() {
+    if(shadowFilter == 1)
+        return 9;
+    if(shadowFilter == 2)
+        return 8;
+    return 1;
+}
+vec2 shadowKernelOffset(int i) {
+    if(shadowFilter == 1) {
+        // 3x3 taps, 1 texel apart. With bilinear PCF it covers 4x4 texels.
+        return vec2(float(i % 3 - 1), float(i / 3 - 1));
+    }
+    if(shadowFilter == 2) {
+        // Rotate the disk by interleaved gradient noise, so that banding turns into fine noise
+        float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+        float c = cos(angle);
+        float s = sin(angle);
+        vec2 p = poissonDisk[i];
+        return vec2(c * p.x - s * p.y, s * p.x + c * p.y) * shadowFilterRadius;
+    }
+    return vec2(0.0);
+}
+float shadowKernelWeight(int i) {
+    if(shadowFilter == 1) {
+        // Binomial ( 1, 2, 1 ) x ( 1, 2, 1 ) / 16, a discrete Gaussian
+        float wx = (i % 3 == 1 ? 2.0 : 1.0);
+        float wy = (i / 3 == 1 ? 2.0 : 1.0);
+        return wx * wy / 16.0;
+    }
+    return 1.0 / float(shadowKernelSize());
+}
 float inShadowFactor(Shadow shadow) {
     if(!shadow.valid)
         return 0.0;
 
-    vec4 shadowMapCoords4 = shadow.shadowMat * oModelMat * vec4(oPosition, 1.0);
+    vec4 shadowMapCoords4 = shadow.shadowMat * vec4(worldPosition, 1.0);
     vec3 shadowMapCoords = shadowMapCoords4.xyz / shadowMapCoords4.w;
     shadowMapCoords = shadowMapCoords * 0.5 + 0.5;
+    if(any(lessThan(shadowMapCoords, vec3(0.0))) || any(greaterThan(shadowMapCoords, vec3(1.0))))
+        return 0.0;
+
+    if(shadow.variance >= 0)
+        return varianceShadowFactor(shadow, shadowMapCoords) * shadowDarkness;
 
-    //float shadowMapDepth = texture2D(shadow.data, shadowMapCoords.xy).r;
-    float currentDepth = shadowMapCoords.z;
+    // Depth bias is applied when the map is rendered ( slope scaled polygon offset ).
+    // Texel size in tile coords, and the range that does not bleed into neighbor tiles
+    vec2 texelSize = 1.0 / (vec2(textureSize(shadowAtlas, 0)) * shadow.rect.zw);
+    vec2 minCoords = 0.5 * texelSize;
+    vec2 maxCoords = 1.0 - 0.5 * texelSize;
 
     float factor = 0.0;
-    float bias = 0.005;
-
-    vec2 texelSize = 1.0 / vec2(1000.0, 1000.0);
-
-    int sampleRes = 1;
-    float sampleNum = 0.0;
-    for(int x = -sampleRes; x <= sampleRes; x++) {
-        for(int y = -sampleRes; y <= sampleRes; y++) {
-            vec2 tmpShadowMapCoords = shadowMapCoords.xy + vec2(x, y) * texelSize;
-            if(tmpShadowMapCoords.x < 0.0 || 
-                tmpShadowMapCoords.x > 1.0 ||
-                tmpShadowMapCoords.y < 0.0 || 
-                tmpShadowMapCoords.y > 1.0)
-                continue;
-            float shadowMapDepth = texture2D(shadow.data, shadowMapCoords.xy + vec2(x, y) * texelSize).r;
-            if(currentDepth - bias > shadowMapDepth)
-                factor += 1.0;
-            sampleNum += 1.0;
-        }
+    int num = shadowKernelSize();
+    for(int i = 0; i < num; i++) {
+        vec2 coords = clamp(shadowMapCoords.xy + shadowKernelOffset(i) * texelSize, minCoords, maxCoords);
+        float lit = texture(shadowAtlas, vec3(shadow.rect.xy + coords * shadow.rect.zw, shadowMapCoords.z));
+        factor += (1.0 - lit) * shadowKernelWeight(i);
+    }
+    return factor * shadowDarkness;
+}
+// Upper bound of the probability that a receiver at [ mean ] is lit
+float chebyshevUpperBound(vec2 moments, float mean, float minVariance, float bleedReduction) {
+    if(mean <= moments.x)
+        return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    return clamp((pMax - bleedReduction) / (1.0 - bleedReduction), 0.0, 1.0);    // Cut off the tail that bleeds light
+}
+float varianceShadowFactor(Shadow shadow, vec3 shadowMapCoords) {
+    // A single filtered fetch, [ variance ] is uniform so the branch does not break derivatives
+    vec4 moments = vec4(0.0);
+    for(int i = 0; i < 4; i++) {
+        if(i == shadow.variance)
+            moments = texture(varianceMaps[i], shadowMapCoords.xy);
+    }
+
+    float depth = shadowMapCoords.z * 2.0 - 1.0;
+    vec2 warped = vec2(exp(shadow.exponents.x * depth), -exp(-shadow.exponents.y * depth));
+    vec2 depthScale = 0.0001 * shadow.exponents * warped;
+    vec2 minVariance = depthScale * depthScale;
+    float pos = chebyshevUpperBound(moments.xy, warped.x, minVariance.x, shadow.bleedReduction);
+    float neg = chebyshevUpperBound(moments.zw, warped.y, minVariance.y, shadow.bleedReduction);
+    return 1.0 - min(pos, neg);
+}
+float cascadeShadowFactor(CascadedShadow csm, int cascade) {
+    vec4 shadowMapCoords4 = csm.shadowMat[cascade] * vec4(worldPosition, 1.0);
+    vec3 shadowMapCoords = shadowMapCoords4.xyz / shadowMapCoords4.w;
+    shadowMapCoords = shadowMapCoords * 0.5 + 0.5;
+    if(shadowMapCoords.z > 1.0)
+        return 0.0;
+
+    vec2 texelSize = 1.0 / vec2(textureSize(csm.data, 0).xy);
+    float factor = 0.0;
+    int num = shadowKernelSize();
+    for(int i = 0; i < num; i++) {
+        vec2 coords = shadowMapCoords.xy + shadowKernelOffset(i) * texelSize;
+        float lit = texture(csm.data, vec4(coords, float(cascade), shadowMapCoords.z));
+        factor += (1.0 - lit) * shadowKernelWeight(i);
     }
-    factor /= (sampleNum * 1.5);
     return factor;
 }
+float inShadowFactor(CascadedShadow csm) {
+    if(!csm.valid)
+        return 0.0;
+
+    // Select cascade by view space depth
+    float depth = -eyePosition.z;
+    int cascade = -1;
+    for(int i = 0; i < csm.num; i++) {
+        if(depth < csm.splits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    if(cascade == -1)
+        return 0.0;
+    float factor = cascadeShadowFactor(csm, cascade);
+
+    // Blend into the next cascade near the far end, so that the seam is not visible
+    if(cascade + 1 < csm.num) {
+        float begin = (cascade == 0 ? 0.0 : csm.splits[cascade - 1]);
+        float end = csm.splits[cascade];
+        float blendBegin = end - (end - begin) * csm.blendRatio;
+        if(depth > blendBegin) {
+            float t = (depth - blendBegin) / (end - blendBegin);
+            factor = mix(factor, cascadeShadowFactor(csm, cascade + 1), t);
+        }
+    }
+    return factor * shadowDarkness;
+}
+float inShadowFactor(CubeShadow cs) {
+    // Compare linear distances, the same in every face
+    vec3 lightToFrag = worldPosition - cs.position;
+    float currentDistance = length(lightToFrag);
+    if(currentDistance > cs.farPlane)
+        return 0.0;
+
+    // Depth is written by fragment shader in cube pass, so polygon offset does not apply there.
+    float bias = 0.05;
+    float reference = (currentDistance - bias) / cs.farPlane;
+    float texelAngle = 2.0 / float(textureSize(cs.data, 0).x);     // Size of a texel seen from the light, in radians
+
+    // Taps spread in the plane perpendicular to [ lightToFrag ]
+    vec3 dir = lightToFrag / currentDistance;
+    vec3 u = normalize(cross(dir, abs(dir.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));
+    vec3 v = cross(dir, u);
+
+    float factor = 0.0;
+    int num = shadowKernelSize();
+    for(int i = 0; i < num; i++) {
+        vec2 offset = shadowKernelOffset(i) * texelAngle * currentDistance;
+        vec3 sampleDir = lightToFrag + offset.x * u + offset.y * v;
+        float lit = texture(cs.data, vec4(sampleDir, reference));
+        factor += (1.0 - lit) * shadowKernelWeight(i);
+    }
+    return factor * shadowDarkness;
+}
 /* ============================================================================================= */
 
 /* ================================== Parallax mapping ========================================= */
+float pmHeight(vec2 texCoord) {
+    if (parallaxPacked)
+        return texture2D(normalMap.data, texCoord).b;
+    return texture2D(parallaxMap.data, texCoord).r;
+}
 vec3 pmSingle() {
     vec3 tangentSpaceViewDir;
     mat3 invEyeTBN;
@@ -364,7 +773,7 @@ vec3 pmSingle() {
     vec3 eyeSpaceViewDir = -eyePosition;
     tangentSpaceViewDir = normalize(invEyeTBN * eyeSpaceViewDir);
 
-    float depth = 1.0 - texture2D(parallaxMap.data, oTexCoord.st).r;
+    float depth = 1.0 - pmHeight(oTexCoord.st);
     vec2 p = tangentSpaceViewDir.xy * (depth * pmOption.depthScale) / tangentSpaceViewDir.z;
     return oTexCoord - vec3(p.xy, 0.0);
 }
@@ -387,10 +796,10 @@ vec3 pmMultiple() {
     vec2 dTexCoord = P / numLayers;
 
     vec2 cTexCoord = oTexCoord.st;
-    float currentDepthMapValue = 1.0 - texture2D(parallaxMap.data, cTexCoord.st).r;
+    float currentDepthMapValue = 1.0 - pmHeight(cTexCoord.st);
     while (currentDepthMapValue > currentLayerDepth) {
         cTexCoord -= dTexCoord;
-        currentDepthMapValue = 1.0 - texture2D(parallaxMap.data, cTexCoord.st).r;
+        currentDepthMapValue = 1.0 - pmHeight(cTexCoord.st);
         currentLayerDepth += layerDepth;
     }
     return vec3(cTexCoord.xy, 0.0);
@@ -414,15 +823,15 @@ vec3 pmOcclusion() {
     vec2 dTexCoord = P / numLayers;
 
     vec2 cTexCoord = oTexCoord.st;
-    float currentDepthMapValue = 1.0 - texture2D(parallaxMap.data, cTexCoord.st).r;
+    float currentDepthMapValue = 1.0 - pmHeight(cTexCoord.st);
     while (currentDepthMapValue > currentLayerDepth) {
         cTexCoord -= dTexCoord;
-        currentDepthMapValue = 1.0 - texture2D(parallaxMap.data, cTexCoord.st).r;
+        currentDepthMapValue = 1.0 - pmHeight(cTexCoord.st);
         currentLayerDepth += layerDepth;
     }
     vec2 prevTexCoord = cTexCoord + dTexCoord;
     float afterDepth = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture2D(parallaxMap.data, prevTexCoord).r - currentLayerDepth + layerDepth;
+    float beforeDepth = pmHeight(prevTexCoord) - currentLayerDepth + layerDepth;
 
     float weight = afterDepth / (afterDepth - beforeDepth);
     vec2 fTexCoord = prevTexCoord * weight + cTexCoord * (1.0 - weight);
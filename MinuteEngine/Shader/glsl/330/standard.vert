@@ -15,12 +15,16 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec3 texCoord;     // Texture coordinates 
 layout (location = 3) in vec3 tangent;
 layout (location = 4) in vec3 bitangent;    // Tangent space vectors
+layout (location = 5) in int drawID;        // Index of per-draw data, only used in indirect mode
 /* --------------------------------------------------------------------------------------------- */
 
 /* ---------------------------------------------------------------------------------  Uniform */
 uniform mat4 modelMat;
 uniform mat4 viewMat;
 uniform mat4 projMat;
+
+uniform bool indirectMode;          // If true, fetch model matrix from [ drawData ] instead of [ modelMat ].
+uniform samplerBuffer drawData;     // 5 texels per draw : 4 columns of model matrix, ( material index, 0, 0, 0 )
 /* ------------------------------------------------------------------------------------------ */
 
 /* ---------------------------------------------------------------------------------  Out */
@@ -33,13 +37,24 @@ out vec3 oNormal;
 out vec3 oTexCoord;
 out vec3 oTangent;
 out vec3 oBitangent;
+
+flat out int oDrawID;
 /* ------------------------------------------------------------------------------------------ */
 
+// Depth pre-pass ( depth.vert ) computes position in the same way, and faces are tested against it with GL_EQUAL.
+invariant gl_Position;
+
 void main(void)
 {
-    oModelMat = modelMat;
+    if (indirectMode) {
+        int base = drawID * 5;
+        oModelMat = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    }
+    else
+        oModelMat = modelMat;
     oViewMat = viewMat;
-    oModelViewMat = viewMat * modelMat;
+    oModelViewMat = viewMat * oModelMat;
+    oDrawID = drawID;
 
     oPosition = position;
     oNormal = normal;
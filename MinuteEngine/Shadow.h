@@ -15,12 +15,21 @@
 
 #include "Utils.h"
 #include "Shader.h"
+#include "ShadowAtlas.h"
+#include "VarianceShadow.h"
+#include "glm/vec4.hpp"
 #include "glm/mat4x4.hpp"
 #include "glm/gtx/rotate_vector.hpp"    // For camera rotation.
 
 #include <GL/glew.h>
 #include <SDL_opengl.h>
 
+// Filtering kernels of shadow maps in [ StandardShader ], every tap is a bilinear PCF by hardware.
+#define SHADOW_FILTER_HARD			0		// 1 tap
+#define SHADOW_FILTER_GAUSSIAN		1		// 3x3 taps with binomial weights
+#define SHADOW_FILTER_POISSON		2		// 8 taps of Poisson disk, rotated per pixel
+#define SHADOW_DEF_FILTER_RADIUS	1.5f	// Radius of Poisson disk in texels
+
 namespace ME {
 	class Shadow {
 	public:
@@ -41,41 +50,31 @@ namespace ME {
 	private:
 		bool valid = false;
 		ProjOption projOption;
-		uint fbo;					// Depth map Frame Buffer Object
-		uint depthMap;				// Texture ID of depth map 
-		uint mapWidth = 1024;
-		uint mapHeight = 1024;		// Size of depth map
+		ShadowAtlas::Tile tile;		// Region of [ ShadowAtlas ] that holds depth map, assigned by [ ShadowAtlas::update() ]
+		uint atlasSize = 0;
+		VarianceShadow variance;	// If valid, shadow is looked up from pre-filtered moments instead of PCF
 	public:
+		// Depth map lives in [ ShadowAtlas ], so no GL object is made here.
 		inline static Shadow create() {
-			Shadow shadow;
-
-			glGenFramebuffers(1, &shadow.fbo);
-			glBindFramebuffer(GL_FRAMEBUFFER, shadow.fbo);
-
-			glGenTextures(1, &shadow.depthMap);
-			glBindTexture(GL_TEXTURE_2D, shadow.depthMap);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadow.mapWidth, shadow.mapHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow.depthMap, 0);
-			glDrawBuffer(GL_NONE);
-			glReadBuffer(GL_NONE);	// Since we do not use color buffer, just set these to GL_NONE
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-			return shadow;
+			return Shadow();
 		}
-		inline uint getFBO() const noexcept {
-			return fbo;
+		inline const ShadowAtlas::Tile& getTile() const noexcept {
+			return tile;
 		}
-		inline uint getDepthMap() const {
-			return depthMap;
+		// Tile in texture coords of the atlas : ( x, y, width, height )
+		inline glm::vec4 getRect() const noexcept {
+			if (atlasSize == 0)
+				return glm::vec4(0.0f);
+			float inv = 1.0f / atlasSize;
+			return glm::vec4(tile.x * inv, tile.y * inv, tile.size * inv, tile.size * inv);
 		}
 		inline void getSize(uint& width, uint& height) const noexcept {
-			width = mapWidth;
-			height = mapHeight;
+			width = tile.size;
+			height = tile.size;
+		}
+		// True if depth map has a place in the atlas
+		inline bool getResident() const noexcept {
+			return tile.size != 0;
 		}
 		inline bool getValid() const noexcept {
 			return valid;
@@ -86,6 +85,12 @@ namespace ME {
 		inline const ProjOption& getProjOptionC() const noexcept {
 			return projOption;
 		}
+		inline VarianceShadow& getVariance() noexcept {
+			return variance;
+		}
+		inline const VarianceShadow& getVarianceC() const noexcept {
+			return variance;
+		}
 		inline glm::mat4 getProjMat() const noexcept {
 			if (projOption.orthoMode) {
 				return glm::ortho(
@@ -110,6 +115,10 @@ namespace ME {
 		inline void setValid(bool valid) noexcept {
 			this->valid = valid;
 		}
+		inline void setTile(const ShadowAtlas::Tile& tile, uint atlasSize) noexcept {
+			this->tile = tile;
+			this->atlasSize = atlasSize;
+		}
 	};
 };
 
@@ -0,0 +1,221 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "ShadowAtlas.h"
+#include "Light.h"
+#include "Camera.h"
+#include "Residency.h"
+#include "glm/geometric.hpp"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace ME {
+	// Make a depth texture of [ size ] x [ size ] and a framebuffer that renders into it
+	static void createDepthTarget(uint size, uint& fbo, uint& depthMap) {
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+		glGenTextures(1, &depthMap);
+		glBindTexture(GL_TEXTURE_2D, depthMap);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		ResidencyManager::global().setTargetBytes(depthMap, (size_t)size * size * 4);		// 24 bit depth takes 4 bytes
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);	// Bilinear PCF by shadow samplers
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);	// Since we do not use color buffer, just set these to GL_NONE
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	static void deleteDepthTarget(uint& fbo, uint& depthMap) {
+		ResidencyManager::global().eraseTarget(depthMap);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &depthMap);
+		fbo = 0;
+		depthMap = 0;
+	}
+
+	static uint revisionNum = 0;		// Last revision given to any [ ShadowAtlas ]
+
+	ShadowAtlas ShadowAtlas::create(uint maxSize) {
+		ShadowAtlas atlas;
+		atlas.maxSize = maxSize;
+		atlas.maxTileSize = std::min(atlas.maxTileSize, maxSize);
+		atlas.valid = true;
+		atlas.renew();
+		atlas.clear();
+		return atlas;
+	}
+	void ShadowAtlas::destroy() {
+		deleteDepthTarget(fbo, depthMap);
+		deleteDepthTarget(staticFBO, staticDepthMap);
+		size = 0;
+		valid = false;
+		nodes.clear();
+		requests.clear();
+	}
+	void ShadowAtlas::renew() {
+		revision = ++revisionNum;
+	}
+	void ShadowAtlas::resize(uint size) {
+		const bool staticLayer = (staticDepthMap != 0);
+		deleteDepthTarget(fbo, depthMap);
+		deleteDepthTarget(staticFBO, staticDepthMap);
+		this->size = size;
+		createDepthTarget(size, fbo, depthMap);
+		if (staticLayer)
+			createDepthTarget(size, staticFBO, staticDepthMap);
+		renew();
+	}
+	void ShadowAtlas::clear() {
+		Node root;
+		root.x = 0;
+		root.y = 0;
+		root.size = size;
+		nodes.clear();
+		nodes.push_back(root);
+	}
+	bool ShadowAtlas::allocate(int node, uint tileSize, Tile& tile) {
+		// Do not keep reference to [ nodes ] here, splitting may reallocate it.
+		if (nodes[node].used || nodes[node].size < tileSize)
+			return false;
+		if (nodes[node].size == tileSize) {
+			if (nodes[node].child != -1)
+				return false;		// Partially used by smaller tiles
+			nodes[node].used = true;
+			tile.x = nodes[node].x;
+			tile.y = nodes[node].y;
+			tile.size = tileSize;
+			return true;
+		}
+		if (nodes[node].child == -1) {
+			const uint half = nodes[node].size / 2;
+			const int child = (int)nodes.size();
+			for (int i = 0; i < 4; i++) {
+				Node n;
+				n.x = nodes[node].x + (i & 1 ? half : 0);
+				n.y = nodes[node].y + (i & 2 ? half : 0);
+				n.size = half;
+				nodes.push_back(n);
+			}
+			nodes[node].child = child;
+		}
+		for (int i = 0; i < 4; i++) {
+			if (allocate(nodes[node].child + i, tileSize, tile))
+				return true;
+		}
+		return false;
+	}
+	bool ShadowAtlas::allocate(uint tileSize, Tile& tile) {
+		uint pow2 = 1;
+		while (pow2 < tileSize)
+			pow2 <<= 1;
+		if (nodes.empty() || pow2 > size)
+			return false;
+		return allocate(0, pow2, tile);
+	}
+	float ShadowAtlas::importance(const Light& light, const Camera& camera) {
+		// Directional light covers the whole view
+		if (light.getType() == 0)
+			return 1.0f;
+
+		// Bounding sphere of the light's shadow frustum
+		const auto& option = light.shadow.getProjOptionC();
+		const glm::vec3 dir = glm::normalize(light.getDirection());
+		glm::vec3 center;
+		float radius;
+		if (option.orthoMode) {
+			glm::vec3 extent(option.orthoRight - option.orthoLeft, option.orthoTop - option.orthoBottom, option.projFar - option.projNear);
+			center = light.getPosition() + dir * (0.5f * (option.projNear + option.projFar));
+			radius = 0.5f * glm::length(extent);
+		}
+		else {
+			center = light.getPosition() + dir * (0.5f * option.projFar);
+			radius = 0.5f * option.projFar / std::cos(0.5f * option.perspFovy);
+		}
+
+		// Ratio of projected radius to half of the screen height
+		float halfHeight;
+		if (camera.getOrthoMode())
+			halfHeight = 0.5f * camera.getOrthoHeight();
+		else {
+			float distance = glm::length(center - camera.getEye());
+			if (distance <= radius)
+				return 1.0f;
+			halfHeight = distance * std::tan(glm::radians(camera.getFovy()) * 0.5f);
+		}
+		return std::min(1.0f, radius / halfHeight);
+	}
+	void ShadowAtlas::update(std::vector<Light>& lights, const Camera& camera, bool staticLayer) {
+		// 1. Requested tile size of each light, 0 if it does not need a tile
+		std::vector<uint> sizes(lights.size(), 0);
+		for (size_t i = 0; i < lights.size(); i++) {
+			const auto& light = lights[i];
+			if (!light.getValid() || !light.shadow.getValid())
+				continue;
+			if (light.getShadowReplaced())
+				continue;
+			const float target = importance(light, camera) * maxTileSize;
+			uint tileSize = minTileSize;
+			while (tileSize < maxTileSize && tileSize < target)
+				tileSize <<= 1;
+			sizes[i] = tileSize;
+		}
+		const bool changed = (sizes != requests);
+		if (changed) {
+			// Smallest power of 2 that holds every tile : squares of power of 2 sorted from the largest
+			// always fit in a quadtree whose area is not smaller than their sum.
+			std::uint64_t area = 0;
+			uint required = 0;
+			for (auto tileSize : sizes) {
+				area += (std::uint64_t)tileSize * tileSize;
+				required = std::max(required, tileSize);
+			}
+			while (required != 0 && required < maxSize && (std::uint64_t)required * required < area)
+				required <<= 1;
+			if (required > size)
+				resize(std::min(required, maxSize));
+		}
+		if (staticLayer && depthMap != 0 && staticDepthMap == 0) {
+			createDepthTarget(size, staticFBO, staticDepthMap);
+			renew();
+		}
+		if (!changed)
+			return;
+		requests = sizes;
+		renew();
+
+		// 2. Reallocate from the largest tile, so that the quadtree does not fragment
+		std::vector<size_t> order(lights.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+			return sizes[a] > sizes[b];
+		});
+
+		clear();
+		for (auto id : order) {
+			Tile tile;
+			uint tileSize = sizes[id];
+			if (tileSize != 0) {
+				while (!allocate(tileSize, tile) && tileSize > minTileSize)
+					tileSize >>= 1;
+			}
+			lights[id].shadow.setTile(tile, size);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_SHADOW_ATLAS_H__
+#define __ME_SHADOW_ATLAS_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include <vector>
+
+#define SHADOW_ATLAS_DEF_MAX_SIZE		4096
+#define SHADOW_ATLAS_DEF_MAX_TILE_SIZE	2048
+#define SHADOW_ATLAS_DEF_MIN_TILE_SIZE	128
+
+namespace ME {
+	class Light;
+	class Camera;
+
+	// A single depth texture that holds shadow maps of every light. Each light gets a square tile
+	// whose size depends on how large the light's influence looks on screen, allocated by a quadtree.
+	// A second texture of the same layout keeps depth of static casters, so that a tile can be restored
+	// from it and only dynamic casters are drawn again.
+	// Nothing is allocated until a light requests a tile. The atlas is then as large as the summed area
+	// of requested tiles, and grows by powers of 2 up to [ maxSize ]. The static layer is allocated
+	// once there is a static caster.
+	class ShadowAtlas {
+	public:
+		// Region of the atlas in pixels, [ size ] is 0 if not allocated
+		struct Tile {
+			uint x = 0;
+			uint y = 0;
+			uint size = 0;
+		};
+	private:
+		// Quadtree node, children are 4 consecutive nodes starting from [ child ]
+		struct Node {
+			uint x;
+			uint y;
+			uint size;
+			int child = -1;
+			bool used = false;
+		};
+		std::vector<Node> nodes;
+		std::vector<uint> requests;		// Requested tile size of each light in the last allocation
+
+		bool valid = false;
+		uint fbo = 0;
+		uint depthMap = 0;
+		uint staticFBO = 0;
+		uint staticDepthMap = 0;		// Static layer : depth of static casters only, cached across frames
+		uint size = 0;					// 0 until the first tile is requested
+		uint maxSize = SHADOW_ATLAS_DEF_MAX_SIZE;
+		uint maxTileSize = SHADOW_ATLAS_DEF_MAX_TILE_SIZE;
+		uint minTileSize = SHADOW_ATLAS_DEF_MIN_TILE_SIZE;
+		uint revision = 0;				// Renewed whenever tiles are reallocated, or depth textures are ( re )allocated
+
+		bool allocate(int node, uint tileSize, Tile& tile);
+		// Give a revision that no atlas had before
+		void renew();
+		// Reallocate depth textures with [ size ], previous contents are lost.
+		void resize(uint size);
+	public:
+		static ShadowAtlas create(uint maxSize = SHADOW_ATLAS_DEF_MAX_SIZE);
+		void destroy();
+
+		// Free every tile
+		void clear();
+		// Allocate a tile of [ tileSize ] ( rounded up to power of 2 ). Returns false if there is no space.
+		bool allocate(uint tileSize, Tile& tile);
+
+		// Screen space importance of [ light ] seen from [ camera ], in [ 0, 1 ].
+		static float importance(const Light& light, const Camera& camera);
+		// Assign tiles to shadows of [ lights ]. Tiles are kept as they are if requested sizes did not change,
+		// otherwise every tile is reallocated from the largest one. Lights that do not fit get smaller tiles.
+		// @staticLayer : Allocate the static layer, if it is not yet, i.e. there are static casters
+		void update(std::vector<Light>& lights, const Camera& camera, bool staticLayer);
+
+		inline uint getFBO() const noexcept {
+			return fbo;
+		}
+		inline uint getDepthMap() const noexcept {
+			return depthMap;
+		}
+		inline uint getStaticFBO() const noexcept {
+			return staticFBO;
+		}
+		inline uint getStaticDepthMap() const noexcept {
+			return staticDepthMap;
+		}
+		inline uint getSize() const noexcept {
+			return size;
+		}
+		inline uint getMaxSize() const noexcept {
+			return maxSize;
+		}
+		inline uint getRevision() const noexcept {
+			return revision;
+		}
+		inline bool getValid() const noexcept {
+			return valid;
+		}
+		inline uint getMaxTileSize() const noexcept {
+			return maxTileSize;
+		}
+		inline uint getMinTileSize() const noexcept {
+			return minTileSize;
+		}
+		inline void setMaxTileSize(uint tileSize) noexcept {
+			maxTileSize = tileSize;
+		}
+		inline void setMinTileSize(uint tileSize) noexcept {
+			minTileSize = tileSize;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,237 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "StaticBatch.h"
+#include "Scene.h"
+#include "glm/common.hpp"
+#include "glm/geometric.hpp"
+#include "glm/matrix.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace ME {
+	// Every option that changes how a render is drawn, so renders with the same key can share one [ Option ].
+	static std::vector<float> optionKey(const Render& render) {
+		const auto& option = render.getOptionC();
+		const auto& mat = option.material;
+		std::vector<float> key = {
+			(float)render.type(), (float)option.shadeMode, (float)option.drawFace, (float)option.drawEdge,
+			option.edgeColor.r, option.edgeColor.g, option.edgeColor.b, option.edgeWidth,
+			option.faceColor.r, option.faceColor.g, option.faceColor.b, option.alpha,
+			(float)option.pmMode, option.pmDepthScale, (float)option.pmMinLayers, (float)option.pmMaxLayers,
+			(float)option.emMode, option.emFactor, mat.getShininess()
+		};
+		for (const auto& color : { mat.getEmission(), mat.getAmbient(), mat.getDiffuse(), mat.getSpecular() })
+			key.insert(key.end(), { color.r, color.g, color.b });
+		for (const auto* texture : { &option.diffuseMap, &option.specularMap, &option.normalMap, &option.parallaxMap })
+			key.push_back(texture->valid ? (float)texture->texture.id : -1.0f);
+		return key;
+	}
+
+	StaticBatch StaticBatch::create() {
+		return StaticBatch();
+	}
+	void StaticBatch::destroy() {
+		for (auto& batch : batches)
+			batch.render->destroy();
+		batches.clear();
+		sources.clear();
+		baked = false;
+	}
+	void StaticBatch::bake(const Scene& scene) {
+		auto previous = std::move(sources);
+		destroy();
+		baked = true;
+		revision = Object::getStaticRevision();
+
+		struct Member {
+			Render::Ptr render;
+			int node;
+			glm::mat4 worldMat;
+		};
+		struct Item {
+			int         id;
+			glm::mat4   modelMat;
+		};
+
+		// 1. Collect renders of static objects by option, with the same traversal as shaders.
+		std::map<std::vector<float>, std::vector<Member>> groups;
+		auto& graph = scene.getGraphC();
+		int root = scene.getRoot();
+
+		Item rootItem;
+		rootItem.id = root;
+		rootItem.modelMat = graph.at(root).getObjectC()->getTransformC().getMat4();
+
+		std::vector<Item> queue;
+		queue.push_back(rootItem);
+		while (!queue.empty()) {
+			Item item = queue.back(); queue.pop_back();
+			auto& node = graph.at(item.id);
+			auto& object = node.getObjectC();
+
+			item.modelMat = item.modelMat * object->getTransformC().getMat4();
+			if (object->getStatic()) {
+				for (const auto& prop : object->getPropertiesC()) {
+					const auto& render = prop.second->getRenderC();
+					if (render == nullptr || render->getRange() == nullptr)
+						continue;
+					if (render->type() != TRI_RENDER_TYPE && render->type() != QUAD_RENDER_TYPE)
+						continue;
+					groups[optionKey(*render)].push_back({ render, item.id, item.modelMat });
+				}
+			}
+			for (auto child : node.getChildC()) {
+				item.id = child;
+				queue.push_back(item);
+			}
+		}
+
+		// 2. Merge each group into a single render
+		for (auto& group : groups) {
+			auto& list = group.second;
+			if (list.size() < 2)
+				continue;
+
+			struct Part {
+				Chunk chunk;
+				std::vector<Render::Vertex> vertices;
+				std::vector<uint> indices;
+			};
+			std::vector<Part> parts(list.size());
+			glm::vec3 groupMin(std::numeric_limits<float>::max());
+			glm::vec3 groupMax(-std::numeric_limits<float>::max());
+			for (size_t i = 0; i < list.size(); i++) {
+				const auto& source = list[i];
+				auto& part = parts[i];
+
+				// Geometry of the last bake, if the render is the same and has not been replaced since
+				Source cached;
+				auto it = previous.find(source.render.get());
+				if (it != previous.end() && it->second.render.lock() == source.render && it->second.revision == source.render->getRevision())
+					cached = std::move(it->second);
+				else {
+					const auto& range = source.render->getRange();
+					cached.render = source.render;
+					cached.revision = source.render->getRevision();
+					cached.vertices.resize(range->vertexNum);
+					cached.indices.resize(range->indexNum);
+					BufferArena::global().read(range, cached.vertices.data(), cached.indices.data());
+					// Triangles of quads are made again when the merged render is uploaded
+					if (source.render->getTriangleFirst() > 0)
+						cached.indices.resize(source.render->getTriangleFirst());
+				}
+				part.vertices = cached.vertices;
+				part.indices = cached.indices;
+				sources[source.render.get()] = std::move(cached);
+
+				// Pre-transform into world space
+				const glm::mat3 mat(source.worldMat);
+				const glm::mat3 normalMat = glm::transpose(glm::inverse(mat));
+				part.chunk.node = source.node;
+				part.chunk.min = glm::vec3(std::numeric_limits<float>::max());
+				part.chunk.max = glm::vec3(-std::numeric_limits<float>::max());
+				for (auto& v : part.vertices) {
+					v.position = glm::vec3(source.worldMat * glm::vec4(v.position, 1.0f));
+					v.normal = glm::normalize(normalMat * v.normal);
+					v.tangent = mat * v.tangent;
+					v.bitangent = mat * v.bitangent;
+					part.chunk.min = glm::min(part.chunk.min, v.position);
+					part.chunk.max = glm::max(part.chunk.max, v.position);
+				}
+				groupMin = glm::min(groupMin, part.chunk.min);
+				groupMax = glm::max(groupMax, part.chunk.max);
+			}
+
+			// Sort chunks along the longest axis, so that visible chunks tend to form long runs.
+			glm::vec3 extent = groupMax - groupMin;
+			int axis = (extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2));
+			std::vector<size_t> order(parts.size());
+			for (size_t i = 0; i < order.size(); i++)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+				return parts[a].chunk.min[axis] + parts[a].chunk.max[axis] < parts[b].chunk.min[axis] + parts[b].chunk.max[axis];
+			});
+
+			Batch batch;
+			std::vector<Render::Vertex> vertices;
+			std::vector<uint> indices;
+			for (auto id : order) {
+				auto& part = parts[id];
+				const uint base = (uint)vertices.size();
+				part.chunk.firstIndex = indices.size();
+				part.chunk.indexNum = part.indices.size();
+				vertices.insert(vertices.end(), part.vertices.begin(), part.vertices.end());
+				for (auto index : part.indices)
+					indices.push_back(base + index);
+				batch.chunks.push_back(part.chunk);
+			}
+
+			const Render::Ptr& first = list.front().render;
+			Render::Ptr render;
+			if (first->type() == TRI_RENDER_TYPE)
+				render = TriRender::createMeshPtr(vertices, indices);
+			else
+				render = QuadRender::createMeshPtr(vertices, indices);
+			int drawNum = render->getOptionC().drawNum;
+			render->getOption() = first->getOptionC();
+			render->getOption().drawNum = drawNum;
+
+			batch.render = render;
+			batch.visibleRanges.push_back({ 0, indices.size() });
+			batches.push_back(batch);
+		}
+	}
+	void StaticBatch::cull(const glm::mat4& viewProjMat) {
+		if (batches.empty())
+			return;
+
+		// Frustum planes in world space, ( a, b, c, d ) with inside being a * x + b * y + c * z + d >= 0
+		glm::vec4 planes[6];
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 4; j++) {
+				planes[2 * i][j] = viewProjMat[j][3] + viewProjMat[j][i];
+				planes[2 * i + 1][j] = viewProjMat[j][3] - viewProjMat[j][i];
+			}
+		}
+		auto visible = [&planes](const Chunk& chunk) {
+			for (const auto& plane : planes) {
+				// Corner of the box farthest along the plane normal
+				glm::vec3 p(
+					plane.x > 0 ? chunk.max.x : chunk.min.x,
+					plane.y > 0 ? chunk.max.y : chunk.min.y,
+					plane.z > 0 ? chunk.max.z : chunk.min.z);
+				if (plane.x * p.x + plane.y * p.y + plane.z * p.z + plane.w < 0)
+					return false;
+			}
+			return true;
+		};
+
+		for (auto& batch : batches) {
+			batch.visibleRanges.clear();
+			for (const auto& chunk : batch.chunks) {
+				if (!visible(chunk))
+					continue;
+				auto& ranges = batch.visibleRanges;
+				if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexNum == chunk.firstIndex)
+					ranges.back().indexNum += chunk.indexNum;
+				else
+					ranges.push_back({ chunk.firstIndex, chunk.indexNum });
+			}
+		}
+	}
+	bool StaticBatch::outdated() const noexcept {
+		return baked && revision != Object::getStaticRevision();
+	}
+	bool StaticBatch::contains(const Render& render) const {
+		auto it = sources.find(&render);
+		return it != sources.end() && !it->second.render.expired();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_STATIC_BATCH_H__
+#define __ME_STATIC_BATCH_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "Render.h"
+#include "glm/vec3.hpp"
+#include "glm/mat4x4.hpp"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace ME {
+	class Scene;
+
+	// Merges geometry of static objects that share the same [ Render::Option ] into a single [ Render ].
+	// Geometry is pre-transformed into world space, so merged renders are drawn with identity model matrix.
+	class StaticBatch {
+	public:
+		// Part of a merged render that came from one source render
+		struct Chunk {
+			int node = -1;				// Scene node of the source object
+			size_t firstIndex = 0;		// Relative to the merged render
+			size_t indexNum = 0;
+			glm::vec3 min;				// World space bounding box
+			glm::vec3 max;
+		};
+		// Index range of a merged render to draw
+		struct Range {
+			size_t firstIndex = 0;
+			size_t indexNum = 0;
+		};
+		struct Batch {
+			Render::Ptr render = nullptr;
+			std::vector<Chunk> chunks;			// Sorted along the longest axis of the batch, so nearby chunks are adjacent
+			std::vector<Range> visibleRanges;	// Adjacent visible chunks merged, updated by [ cull() ]
+		};
+	private:
+		// Render merged into a batch, with its local space geometry read back from [ BufferArena ].
+		// Only merged renders keep a copy, and only while they stay merged, so baking again does not read it back.
+		struct Source {
+			std::weak_ptr<const Render> render;
+			uint revision = 0;					// [ Render::getRevision() ] when the geometry was read
+			std::vector<Render::Vertex> vertices;
+			std::vector<uint> indices;
+		};
+		std::vector<Batch> batches;
+		std::map<const Render*, Source> sources;	// Source renders, not drawn by themselves while baked
+		bool baked = false;
+		uint revision = 0;						// [ Object::getStaticRevision() ] at the last bake
+	public:
+		static StaticBatch create();
+		void destroy();
+
+		// Merge renders of static objects in [ scene ]. Previous batches are destroyed.
+		// Only [ TriRender ] and [ QuadRender ] in [ BufferArena ] are merged, and a group of a single render is left as is.
+		// Static objects ( and their parents ) must not move after baking.
+		void bake(const Scene& scene);
+
+		// True if the batch was baked, and an object became static or dynamic since then
+		bool outdated() const noexcept;
+
+		// Update [ visibleRanges ] of every batch with chunks that intersect view frustum of [ viewProjMat ].
+		void cull(const glm::mat4& viewProjMat);
+
+		// True if [ render ] is merged into one of the batches.
+		// A deleted source never matches, even if another render reuses its address.
+		bool contains(const Render& render) const;
+
+		inline const std::vector<Batch>& getBatchesC() const noexcept {
+			return batches;
+		}
+		inline bool empty() const noexcept {
+			return batches.empty();
+		}
+	};
+}
+
+#endif
\ No newline at end of file
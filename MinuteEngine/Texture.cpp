@@ -7,6 +7,7 @@
  */
 
 #include "Texture.h"
+#include "TextureStream.h"
 #include "Utils.h"
 
 #include <GL/glew.h>
@@ -15,20 +16,88 @@
 #define STB_IMAGE_IMPLEMENTATION // https://learnopengl.com/Getting-started/Textures
 #include "stbi/stb_image.h"
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 #include <stdexcept>
 
 namespace ME {
+	// Bytes of each texture, updated by uploads. Textures are only made on GL thread, but stats may be read elsewhere.
+	static std::mutex bytesMutex;
+	static std::unordered_map<uint, size_t> textureBytes;
+	static size_t totalBytes = 0;
+	static void setBytes(uint id, size_t bytes) {
+		std::lock_guard<std::mutex> lock(bytesMutex);
+		auto& b = textureBytes[id];
+		totalBytes = totalBytes - b + bytes;
+		b = bytes;
+	}
+	static void eraseBytes(uint id) {
+		std::lock_guard<std::mutex> lock(bytesMutex);
+		auto it = textureBytes.find(id);
+		if (it == textureBytes.end())
+			return;
+		totalBytes -= it->second;
+		textureBytes.erase(it);
+	}
+
 	// Texture2D
-	Texture2D Texture2D::create(const std::string& path) {
+	bool Texture2D::srgb = false;
+
+	Texture2D Texture2D::create(const std::string& path, int compression) {
 		Texture2D texture;
 		glGenTextures(1, &texture.id);
 		if (!path.empty()) 
-			texture.loadImage(path);
+			texture.loadImage(path, compression);
+		return texture;
+	}
+	Texture2D Texture2D::createAsync(const std::string& path, const Color& placeholder, int compression) {
+		Texture2D texture;
+		glGenTextures(1, &texture.id);
+		const uchar texel[3] = { (uchar)(placeholder.r * 255.0f), (uchar)(placeholder.g * 255.0f), (uchar)(placeholder.b * 255.0f) };
+		texture.upload(1, 1, texel);
+		TextureStreamer::global().request(texture, path, compression);
+		return texture;
+	}
+	Texture2D Texture2D::createPacked(const std::string& path, const std::string& packPath, int packChannel, int compression) {
+		Texture2D texture;
+		glGenTextures(1, &texture.id);
+		if (compression != TEXTURE_COMPRESSION_NONE &&
+			TextureCompressor::supported(TextureCompressor::format(compression, nullptr, 0, 0, 3))) {
+			TextureCompressor::Image image;
+			if (!TextureCompressor::load(path, packPath, packChannel, compression, image))
+				throw(std::runtime_error("Texture image load failed"));
+			texture.uploadCompressed(image.format, image.width, image.height, image.levelNum, image.data.data());
+			return texture;
+		}
+		int width, height, channels;
+		uchar* data = TextureCompressor::pack(path, packPath, packChannel, width, height, channels);
+		if (!data)
+			throw(std::runtime_error("Texture image load failed"));
+		texture.upload(width, height, data, channels);
+		TextureCompressor::free(data);
 		return texture;
 	}
-	void Texture2D::loadImage(const std::string& path) {
+	Texture2D Texture2D::createPackedAsync(const std::string& path, const std::string& packPath, int packChannel, const Color& placeholder, int compression) {
+		Texture2D texture;
+		glGenTextures(1, &texture.id);
+		const uchar texel[4] = { (uchar)(placeholder.r * 255.0f), (uchar)(placeholder.g * 255.0f), (uchar)(placeholder.b * 255.0f), (uchar)(placeholder.a * 255.0f) };
+		texture.upload(1, 1, texel, packChannel + 1);
+		TextureStreamer::global().request(texture, path, compression, packPath, packChannel);
+		return texture;
+	}
+	void Texture2D::loadImage(const std::string& path, int compression) {
+		if (compression != TEXTURE_COMPRESSION_NONE &&
+			TextureCompressor::supported(TextureCompressor::format(compression, nullptr, 0, 0, 3))) {
+			TextureCompressor::Image image;
+			if (!TextureCompressor::load(path, compression, image))
+				throw(std::runtime_error("Texture image load failed"));
+			uploadCompressed(image.format, image.width, image.height, image.levelNum, image.data.data());
+			return;
+		}
 		int width, height, nrChannels;
-		uchar* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);
+		uchar* data = TextureCompressor::decode(path, width, height, nrChannels);
 		auto size = sizeof(data);
 
 		if (!data)
@@ -36,15 +105,32 @@ namespace ME {
 		/*if (width > GL_MAX_TEXTURE_SIZE || height > GL_MAX_TEXTURE_SIZE)
 			throw(std::runtime_error("Texture image is too big"));*/
 
+		upload(width, height, data, nrChannels);
+		stbi_image_free(data);
+	}
+	void Texture2D::upload(int width, int height, const void* pixels, int channels) {
+		static const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+		if (channels < 1 || channels > 4)
+			throw(std::runtime_error("Texture image has invalid number of channels"));
+
 		glEnable(GL_TEXTURE_2D);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, id);
 
 		/* Warning : Parameters must be set! If not, only black color will be displayed */
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+		const GLint gray[4] = { GL_RED, GL_RED, GL_RED, channels == 2 ? GL_GREEN : GL_ONE };
+		const GLint color[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, channels <= 2 ? gray : color);
+
+		// Rows of gray images are not 4 byte aligned
+		GLint alignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
 		// @arg0 : Texture type
 		// @arg1 : Mipmap level
@@ -53,9 +139,101 @@ namespace ME {
 		// @arg5 : Have to be 0 ( Legacy )
 		// @arg6 : Format of source image
 		// @arg7 : Image data
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		
-		stbi_image_free(data);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(channels, srgb), width, height, 0, formats[channels - 1], GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+		// Mip chain adds a third of level 0
+		setBytes(id, (size_t)width * height * channels * 4 / 3);
+
+		// Minified textures ( tiled floors, far objects ) read small levels instead of skipping over level 0
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	void Texture2D::uploadCompressed(int format, int width, int height, int levelNum, const void* data) {
+		glEnable(GL_TEXTURE_2D);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, id);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelNum - 1);
+		const GLint gray[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		const GLint color[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, format == TEXTURE_BC4 ? gray : color);
+
+		// Mip levels come with the blocks, driver cannot generate them for compressed formats
+		const GLenum glFormat = TextureCompressor::glFormat(format, srgb);
+		size_t offset = 0;
+		for (int level = 0; level < levelNum; level++) {
+			const int w = std::max(1, width >> level);
+			const int h = std::max(1, height >> level);
+			const size_t size = TextureCompressor::levelSize(format, w, h);
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, glFormat, w, h, 0, (GLsizei)size, (const uchar*)data + offset);
+			offset += size;
+		}
+		setBytes(id, offset);
+	}
+	void Texture2D::destroy() {
+		eraseBytes(id);
+		glDeleteTextures(1, &id);
+		id = 0;
+	}
+	size_t Texture2D::getBytes(uint id) {
+		std::lock_guard<std::mutex> lock(bytesMutex);
+		auto it = textureBytes.find(id);
+		return (it == textureBytes.end() ? 0 : it->second);
+	}
+	size_t Texture2D::getTotalBytes() {
+		std::lock_guard<std::mutex> lock(bytesMutex);
+		return totalBytes;
+	}
+	void Texture2D::setSRGB(bool srgb) noexcept {
+		Texture2D::srgb = srgb;
+	}
+	bool Texture2D::getSRGB() noexcept {
+		return srgb;
+	}
+	uint Texture2D::internalFormat(int channels, bool srgb) {
+		switch (channels) {
+		case 1:
+			return GL_R8;
+		case 2:
+			return GL_RG8;
+		case 3:
+			return srgb ? GL_SRGB8 : GL_RGB8;
+		default:
+			return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		}
+	}
+	float Texture2D::maxAnisotropy() {
+		static float anisotropy = -1.0f;
+		if (anisotropy < 0.0f) {
+			anisotropy = 1.0f;
+			if (GLEW_EXT_texture_filter_anisotropic || GLEW_ARB_texture_filter_anisotropic)
+				glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &anisotropy);
+		}
+		return anisotropy;
+	}
+	uint Texture2D::sampler(int filter, float anisotropy) {
+		static std::map<std::pair<int, float>, uint> samplers;
+		anisotropy = std::max(1.0f, std::min(anisotropy, maxAnisotropy()));
+		const auto key = std::make_pair(filter, anisotropy);
+		auto it = samplers.find(key);
+		if (it != samplers.end())
+			return it->second;
+
+		uint sampler;
+		glGenSamplers(1, &sampler);
+		glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, filter == TEXTURE_FILTER_TRILINEAR ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		if (maxAnisotropy() > 1.0f)
+			glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+		samplers[key] = sampler;
+		return sampler;
 	}
 
 	// TextureCube
@@ -65,22 +243,37 @@ namespace ME {
 		texture.loadImage(path);
 		return texture;
 	}
+	TextureCube TextureCube::createAsync(const std::string path[6], const Color& placeholder) {
+		TextureCube texture;
+		glGenTextures(1, &texture.id);
+		const uchar texel[3] = { (uchar)(placeholder.r * 255.0f), (uchar)(placeholder.g * 255.0f), (uchar)(placeholder.b * 255.0f) };
+		for (int i = 0; i < 6; i++)
+			texture.upload(i, 1, 1, texel);
+		TextureStreamer::global().request(texture, path);
+		return texture;
+	}
 	void TextureCube::loadImage(const std::string path[6]) {
-		glEnable(GL_TEXTURE_CUBE_MAP);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, id);
-
 		for (int i = 0; i < 6; i++) {
 			int width, height, nrChannels;
-			uchar* data = stbi_load(path[i].c_str(), &width, &height, &nrChannels, 0);
+			uchar* data = TextureCompressor::decode(path[i], width, height, nrChannels, 3);		// Faces are uploaded as RGB
 			auto size = sizeof(data);
 
 			if (!data)
 				throw(std::runtime_error("Texture image load failed"));
 			
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+			upload(i, width, height, data);
 			stbi_image_free(data);
 		}
+	}
+	void TextureCube::upload(int face, int width, int height, const void* pixels) {
+		glEnable(GL_TEXTURE_CUBE_MAP);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, id);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, Texture2D::internalFormat(3, Texture2D::getSRGB()), width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		setBytes(id, (size_t)width * height * 3 * 6);		// Faces are the same size
+		if (face != 5)
+			return;
+
 		/* Warning : Parameters must be set! If not, only black color will be displayed */
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -88,4 +281,9 @@ namespace ME {
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 	}
+	void TextureCube::destroy() {
+		eraseBytes(id);
+		glDeleteTextures(1, &id);
+		id = 0;
+	}
 }
\ No newline at end of file
@@ -14,15 +14,61 @@
 #endif
 
 #include "Shader.h"
+#include "Color.h"
+#include "TextureCompress.h"
 #include <string>
 
+// Minification filter of [ Texture2D::sampler() ]
+#define TEXTURE_FILTER_BILINEAR		0		// Level 0 only
+#define TEXTURE_FILTER_TRILINEAR	1		// Linear between the two nearest mip levels
+
+#define TEXTURE_DEF_ANISOTROPY		8.0f
+
 namespace ME {
 	class Texture2D {
 	public:
 		uint id;			// Specifies ID of this texture : [ glBindTexture(type, { id }) ]
+	private:
+		static bool srgb;
 	public:
-		static Texture2D create(const std::string& path = "");
-		void loadImage(const std::string& path);
+		// @compression : TEXTURE_COMPRESSION_*, what the image holds. Compressed images go through
+		// [ TextureCompressor ]'s cache, and stay uncompressed if driver does not take their block format.
+		static Texture2D create(const std::string& path = "", int compression = TEXTURE_COMPRESSION_NONE);
+		// Texture of a single [ placeholder ] texel, replaced by the image at [ path ] once [ TextureStreamer ]
+		// has decoded and uploaded it.
+		static Texture2D createAsync(const std::string& path, const Color& placeholder = Color::create(0.5f, 0.5f, 0.5f), int compression = TEXTURE_COMPRESSION_NONE);
+		// Image at [ path ] with the gray image at [ packPath ] in its [ packChannel ], see [ TextureCompressor::pack() ].
+		// Shaders then read both from one texture : [ Render::Option::specularPacked ], [ parallaxPacked ].
+		static Texture2D createPacked(const std::string& path, const std::string& packPath, int packChannel, int compression = TEXTURE_COMPRESSION_NONE);
+		static Texture2D createPackedAsync(const std::string& path, const std::string& packPath, int packChannel,
+			const Color& placeholder = Color::create(0.5f, 0.5f, 0.5f), int compression = TEXTURE_COMPRESSION_NONE);
+		void loadImage(const std::string& path, int compression = TEXTURE_COMPRESSION_NONE);
+		// Set image of [ width ] x [ height ] with its full mip chain, and sampling parameters.
+		// Format follows [ channels ] : R8 and RG8 are read as gray ( R, R, R, G ), RGB8 and RGBA8 as they are.
+		// [ pixels ] is an offset into the bound pixel unpack buffer, if any.
+		void upload(int width, int height, const void* pixels, int channels = 3);
+		// Same as [ upload() ], for [ levelNum ] levels of [ format ] blocks laid out as in [ TextureCompressor::Image ].
+		// BC4 is read as gray ( R, R, R, 1 ), and BC5 leaves z of normals to the shader.
+		void uploadCompressed(int format, int width, int height, int levelNum, const void* data);
+
+		// Sampler object of [ filter ] and [ anisotropy ], shared by every texture that asks for the same.
+		// Anisotropy is clamped to what the driver supports, and ignored without anisotropic filtering.
+		static uint sampler(int filter, float anisotropy);
+		static float maxAnisotropy();
+
+		// Delete the GL texture. Copies of this [ Texture2D ] share it, so only one of them should call this.
+		void destroy();
+		// GPU memory of texture [ id ] ( 2D or cube ) as last uploaded, with its mip levels
+		static size_t getBytes(uint id);
+		// GPU memory of every texture that is alive
+		static size_t getTotalBytes();
+
+		// Store color images ( RGB, RGBA, BC1, BC3 ) of textures created from now on in sRGB formats, so that
+		// shaders read them in linear space. Only for a pipeline that writes to sRGB framebuffers; gray images stay linear.
+		static void setSRGB(bool srgb) noexcept;
+		static bool getSRGB() noexcept;
+		// Internal format for an uncompressed image of [ channels ] channels
+		static uint internalFormat(int channels, bool srgb);
 	};
 
 	class TextureCube {
@@ -30,7 +76,11 @@ namespace ME {
 		uint id;			// Specifies ID of this texture : [ glBindTexture(type, { id }) ]
 	public:
 		static TextureCube create(const std::string path[6]);
+		static TextureCube createAsync(const std::string path[6], const Color& placeholder = Color::create(0.5f, 0.5f, 0.5f));
 		void loadImage(const std::string path[6]);
+		// Same as [ Texture2D::upload() ], for [ face ] of the cube. Parameters are set with the last face.
+		void upload(int face, int width, int height, const void* pixels);
+		void destroy();
 	};
 }
 
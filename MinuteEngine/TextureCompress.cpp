@@ -0,0 +1,536 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "TextureCompress.h"
+#include "IO.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+
+#include "stbi/stb_image.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ME_TEXTURE_COMPRESS_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace ME {
+	static std::string cacheDir = "cache/textures/";
+	static std::atomic<uint> cacheHitNum{ 0 };
+	static std::atomic<uint> cacheMissNum{ 0 };
+
+	struct CompressedHeader {
+		char            magic[4];       // "MEBC"
+		std::uint32_t   version;
+		std::uint64_t   key;
+		std::int32_t    format;
+		std::int32_t    width;
+		std::int32_t    height;
+		std::int32_t    levelNum;
+		std::uint64_t   size;
+	};
+
+	// Color space
+	struct SrgbTable {
+		float linear[256];
+
+		SrgbTable() {
+			for (int i = 0; i < 256; i++) {
+				const float c = i / 255.0f;
+				linear[i] = (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f));
+			}
+		}
+	};
+	static const float* srgbToLinear() {
+		static const SrgbTable table;		// Built once, even if several workers get here first
+		return table.linear;
+	}
+	static uchar linearToSrgb(float c) {
+		c = std::max(0.0f, std::min(1.0f, c));
+		c = (c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f);
+		return (uchar)(c * 255.0f + 0.5f);
+	}
+
+	std::vector<uchar> TextureCompressor::downsample(const uchar* pixels, int width, int height, int channels, bool linear) {
+		const float* toLinear = srgbToLinear();
+		const int w = std::max(1, width / 2);
+		const int h = std::max(1, height / 2);
+		std::vector<uchar> dst((size_t)w * h * channels);
+		for (int y = 0; y < h; y++) {
+			const int y0 = std::min(2 * y, height - 1);
+			const int y1 = std::min(2 * y + 1, height - 1);
+			for (int x = 0; x < w; x++) {
+				const int x0 = std::min(2 * x, width - 1);
+				const int x1 = std::min(2 * x + 1, width - 1);
+				const uchar* t[4] = {
+					&pixels[((size_t)y0 * width + x0) * channels], &pixels[((size_t)y0 * width + x1) * channels],
+					&pixels[((size_t)y1 * width + x0) * channels], &pixels[((size_t)y1 * width + x1) * channels]
+				};
+				uchar* d = &dst[((size_t)y * w + x) * channels];
+				for (int c = 0; c < channels; c++) {
+					if (linear && c < 3) {
+						const float sum = toLinear[t[0][c]] + toLinear[t[1][c]] + toLinear[t[2][c]] + toLinear[t[3][c]];
+						d[c] = linearToSrgb(sum * 0.25f);
+					}
+					else
+						d[c] = (uchar)((t[0][c] + t[1][c] + t[2][c] + t[3][c] + 2) / 4);
+				}
+			}
+		}
+		return dst;
+	}
+
+	// Blocks
+	static inline std::uint16_t pack565(int r, int g, int b) {
+		return (std::uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+	}
+	static inline void unpack565(std::uint16_t c, int rgb[3]) {
+		const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+	// Index of the nearest of 4 [ palette ] colors to each texel, 2 bits each
+	static std::uint32_t paletteIndices(const uchar texels[64], const int palette[4][3]) {
+		std::uint32_t indices = 0;
+#ifdef ME_TEXTURE_COMPRESS_SSE
+		const __m128 pr = _mm_setr_ps((float)palette[0][0], (float)palette[1][0], (float)palette[2][0], (float)palette[3][0]);
+		const __m128 pg = _mm_setr_ps((float)palette[0][1], (float)palette[1][1], (float)palette[2][1], (float)palette[3][1]);
+		const __m128 pb = _mm_setr_ps((float)palette[0][2], (float)palette[1][2], (float)palette[2][2], (float)palette[3][2]);
+		for (int i = 0; i < 16; i++) {
+			const __m128 dr = _mm_sub_ps(_mm_set1_ps((float)texels[4 * i + 0]), pr);
+			const __m128 dg = _mm_sub_ps(_mm_set1_ps((float)texels[4 * i + 1]), pg);
+			const __m128 db = _mm_sub_ps(_mm_set1_ps((float)texels[4 * i + 2]), pb);
+			const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+			float dist[4];
+			_mm_storeu_ps(dist, d);
+			int best = 0;
+			for (int j = 1; j < 4; j++)
+				if (dist[j] < dist[best])
+					best = j;
+			indices |= (std::uint32_t)best << (2 * i);
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestDist = 0x7fffffff;
+			for (int j = 0; j < 4; j++) {
+				const int dr = texels[4 * i + 0] - palette[j][0];
+				const int dg = texels[4 * i + 1] - palette[j][1];
+				const int db = texels[4 * i + 2] - palette[j][2];
+				const int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = j;
+				}
+			}
+			indices |= (std::uint32_t)best << (2 * i);
+		}
+#endif
+		return indices;
+	}
+
+	void TextureCompressor::encodeBC1(const uchar texels[64], uchar block[8]) {
+		// Endpoints on the diagonal of the bounding box that follows the texels' correlation
+		int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 3; c++) {
+				lo[c] = std::min(lo[c], (int)texels[4 * i + c]);
+				hi[c] = std::max(hi[c], (int)texels[4 * i + c]);
+				mean[c] += texels[4 * i + c] / 16.0f;
+			}
+		float covRG = 0.0f, covRB = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			const float r = texels[4 * i + 0] - mean[0];
+			covRG += r * (texels[4 * i + 1] - mean[1]);
+			covRB += r * (texels[4 * i + 2] - mean[2]);
+		}
+		// Inset by 1/16 of the range, since texels at the corners are rare
+		for (int c = 0; c < 3; c++) {
+			const int inset = (hi[c] - lo[c]) >> 4;
+			lo[c] += inset;
+			hi[c] -= inset;
+		}
+		if (covRG < 0.0f)
+			std::swap(lo[1], hi[1]);
+		if (covRB < 0.0f)
+			std::swap(lo[2], hi[2]);
+
+		std::uint16_t c0 = pack565(hi[0], hi[1], hi[2]);
+		std::uint16_t c1 = pack565(lo[0], lo[1], lo[2]);
+		if (c0 < c1)
+			std::swap(c0, c1);		// 4 color mode
+
+		std::uint32_t indices = 0;
+		if (c0 != c1) {
+			int palette[4][3];
+			unpack565(c0, palette[0]);
+			unpack565(c1, palette[1]);
+			for (int c = 0; c < 3; c++) {
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			indices = paletteIndices(texels, palette);
+		}
+		block[0] = (uchar)(c0 & 0xff);
+		block[1] = (uchar)(c0 >> 8);
+		block[2] = (uchar)(c1 & 0xff);
+		block[3] = (uchar)(c1 >> 8);
+		for (int i = 0; i < 4; i++)
+			block[4 + i] = (uchar)(indices >> (8 * i));
+	}
+	void TextureCompressor::encodeBC4(const uchar texels[64], int channel, uchar block[8]) {
+		// 8 value mode : r0 = max > r1 = min, with 6 values between them
+		int lo = 255, hi = 0;
+		for (int i = 0; i < 16; i++) {
+			lo = std::min(lo, (int)texels[4 * i + channel]);
+			hi = std::max(hi, (int)texels[4 * i + channel]);
+		}
+		block[0] = (uchar)hi;
+		block[1] = (uchar)lo;
+
+		std::uint64_t indices = 0;
+		if (hi > lo) {
+			const int range = hi - lo;
+			for (int i = 0; i < 16; i++) {
+				// Step from r0 toward r1, then codes 0 and 1 are the ends and 2 ~ 7 lie between them
+				const int k = ((hi - texels[4 * i + channel]) * 7 + range / 2) / range;
+				const std::uint64_t code = (k == 0 ? 0 : (k == 7 ? 1 : k + 1));
+				indices |= code << (3 * i);
+			}
+		}
+		for (int i = 0; i < 6; i++)
+			block[2 + i] = (uchar)(indices >> (8 * i));
+	}
+	void TextureCompressor::encodeBC3(const uchar texels[64], uchar block[16]) {
+		encodeBC4(texels, 3, block);
+		encodeBC1(texels, block + 8);
+	}
+	void TextureCompressor::encodeBC5(const uchar texels[64], uchar block[16]) {
+		encodeBC4(texels, 0, block);
+		encodeBC4(texels, 1, block + 8);
+	}
+
+	// Formats
+	int TextureCompressor::format(int compression, const uchar* pixels, int width, int height, int channels) {
+		switch (compression) {
+		case TEXTURE_COMPRESSION_COLOR:
+			if (channels == 4)
+				for (size_t i = 0; i < (size_t)width * height; i++)
+					if (pixels[4 * i + 3] != 255)
+						return TEXTURE_BC3;
+			return TEXTURE_BC1;
+		case TEXTURE_COMPRESSION_GRAY:
+			return TEXTURE_BC4;
+		case TEXTURE_COMPRESSION_NORMAL:
+			return TEXTURE_BC5;
+		default:
+			return 0;
+		}
+	}
+	bool TextureCompressor::supported(int format) {
+		switch (format) {
+		case TEXTURE_BC1:
+		case TEXTURE_BC3:
+			return GLEW_EXT_texture_compression_s3tc;
+		case TEXTURE_BC4:
+		case TEXTURE_BC5:
+			return GLEW_ARB_texture_compression_rgtc || GLEW_VERSION_3_0;
+		default:
+			return false;
+		}
+	}
+	uint TextureCompressor::glFormat(int format, bool srgb) {
+		switch (format) {
+		case TEXTURE_BC1:
+			return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case TEXTURE_BC3:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case TEXTURE_BC4:
+			return GL_COMPRESSED_RED_RGTC1;
+		case TEXTURE_BC5:
+			return GL_COMPRESSED_RG_RGTC2;
+		default:
+			throw(std::runtime_error("[TEXTURE COMPRESS ERROR] : Invalid block format"));
+		}
+	}
+	int TextureCompressor::blockSize(int format) {
+		return (format == TEXTURE_BC1 || format == TEXTURE_BC4) ? 8 : 16;
+	}
+	size_t TextureCompressor::levelSize(int format, int width, int height) {
+		return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * blockSize(format);
+	}
+
+	TextureCompressor::Image TextureCompressor::compress(const uchar* pixels, int width, int height, int channels, int format, uint threadNum) {
+		if (format != TEXTURE_BC1 && format != TEXTURE_BC3 && format != TEXTURE_BC4 && format != TEXTURE_BC5)
+			throw(std::runtime_error("[TEXTURE COMPRESS ERROR] : Invalid block format"));
+		Image image;
+		image.format = format;
+		image.width = width;
+		image.height = height;
+
+		// 1. Mip chain in RGBA
+		struct Level {
+			int width;
+			int height;
+			size_t offset;
+			std::vector<uchar> texels;
+		};
+		std::vector<Level> levels;
+		{
+			Level level = { width, height, 0, std::vector<uchar>((size_t)width * height * 4) };
+			for (size_t i = 0; i < (size_t)width * height; i++) {
+				uchar* d = &level.texels[4 * i];
+				const uchar* s = &pixels[channels * i];
+				d[0] = s[0];
+				d[1] = (channels >= 2 ? s[1] : s[0]);
+				d[2] = (channels >= 3 ? s[2] : s[0]);
+				d[3] = (channels == 4 ? s[3] : (channels == 2 ? s[1] : 255));
+			}
+			levels.push_back(std::move(level));
+		}
+		const bool linear = (format == TEXTURE_BC1 || format == TEXTURE_BC3);
+		while (levels.back().width > 1 || levels.back().height > 1) {
+			const auto& last = levels.back();
+			Level level = { std::max(1, last.width / 2), std::max(1, last.height / 2), 0,
+				downsample(last.texels.data(), last.width, last.height, 4, linear) };
+			levels.push_back(std::move(level));
+		}
+		size_t size = 0;
+		for (auto& level : levels) {
+			level.offset = size;
+			size += levelSize(format, level.width, level.height);
+		}
+		image.levelNum = (int)levels.size();
+		image.data.resize(size);
+
+		// 2. Encode rows of blocks of every level, taken by workers one at a time
+		struct Row {
+			int level;
+			int y;
+		};
+		std::vector<Row> rows;
+		for (int l = 0; l < (int)levels.size(); l++)
+			for (int y = 0; y < (levels[l].height + 3) / 4; y++)
+				rows.push_back({ l, y });
+
+		const int bsize = blockSize(format);
+		std::atomic<size_t> next{ 0 };
+		auto work = [&]() {
+			uchar texels[64];
+			for (size_t r = next++; r < rows.size(); r = next++) {
+				const auto& level = levels[rows[r].level];
+				const int by = rows[r].y;
+				const int bw = (level.width + 3) / 4;
+				uchar* dst = image.data.data() + level.offset + (size_t)by * bw * bsize;
+				for (int bx = 0; bx < bw; bx++, dst += bsize) {
+					// Texels out of the image repeat the edge
+					for (int j = 0; j < 4; j++) {
+						const int y = std::min(4 * by + j, level.height - 1);
+						for (int i = 0; i < 4; i++) {
+							const int x = std::min(4 * bx + i, level.width - 1);
+							std::memcpy(&texels[4 * (4 * j + i)], &level.texels[((size_t)y * level.width + x) * 4], 4);
+						}
+					}
+					switch (format) {
+					case TEXTURE_BC1: encodeBC1(texels, dst); break;
+					case TEXTURE_BC3: encodeBC3(texels, dst); break;
+					case TEXTURE_BC4: encodeBC4(texels, 0, dst); break;
+					case TEXTURE_BC5: encodeBC5(texels, dst); break;
+					}
+				}
+			}
+		};
+		uint workerNum = (threadNum == 0 ? std::thread::hardware_concurrency() : threadNum);
+		workerNum = std::max(1u, std::min(workerNum, (uint)rows.size()));
+		std::vector<std::thread> workers;
+		for (uint i = 1; i < workerNum; i++)
+			workers.emplace_back(work);
+		work();
+		for (auto& worker : workers)
+			worker.join();
+		return image;
+	}
+
+	void TextureCompressor::dropLevels(Image& image, int levels) {
+		levels = std::min(levels, image.levelNum - 1);
+		if (levels <= 0)
+			return;
+		size_t offset = 0;
+		for (int l = 0; l < levels; l++)
+			offset += levelSize(image.format, std::max(1, image.width >> l), std::max(1, image.height >> l));
+		image.data.erase(image.data.begin(), image.data.begin() + offset);
+		image.width = std::max(1, image.width >> levels);
+		image.height = std::max(1, image.height >> levels);
+		image.levelNum -= levels;
+	}
+
+	// Cache
+	void TextureCompressor::setCacheDir(const std::string& dir) {
+		cacheDir = dir;
+		if (!cacheDir.empty() && cacheDir.back() != '/' && cacheDir.back() != '\\')
+			cacheDir += '/';
+	}
+	const std::string& TextureCompressor::getCacheDir() noexcept {
+		return cacheDir;
+	}
+	uint TextureCompressor::getCacheHitNum() noexcept {
+		return cacheHitNum;
+	}
+	uint TextureCompressor::getCacheMissNum() noexcept {
+		return cacheMissNum;
+	}
+	// FNV-1a
+	static void hashBytes(std::uint64_t& hash, const void* data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= ((const uchar*)data)[i];
+			hash *= 1099511628211ull;
+		}
+	}
+	static bool loadCache(std::uint64_t key, TextureCompressor::Image& image) {
+		if (cacheDir.empty())
+			return false;
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bct", (unsigned long long)key);
+		IO::MappedFile file;
+		if (!file.open(cacheDir + name) || file.getSize() < sizeof(CompressedHeader))
+			return false;
+		const char* data = file.getData();
+		CompressedHeader header;
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, "MEBC", 4) != 0 || header.version != TEXTURE_COMPRESS_VERSION ||
+			header.key != key || file.getSize() != sizeof(header) + header.size)
+			return false;
+		image.format = header.format;
+		image.width = header.width;
+		image.height = header.height;
+		image.levelNum = header.levelNum;
+		image.data.assign(data + sizeof(header), data + file.getSize());
+		return true;
+	}
+	static void saveCache(std::uint64_t key, const TextureCompressor::Image& image) {
+		if (cacheDir.empty())
+			return;
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.bct", (unsigned long long)key);
+		CompressedHeader header;
+		std::memcpy(header.magic, "MEBC", 4);
+		header.version = TEXTURE_COMPRESS_VERSION;
+		header.key = key;
+		header.format = image.format;
+		header.width = image.width;
+		header.height = image.height;
+		header.levelNum = image.levelNum;
+		header.size = image.data.size();
+		std::vector<char> data(sizeof(header) + image.data.size());
+		std::memcpy(data.data(), &header, sizeof(header));
+		std::memcpy(data.data() + sizeof(header), image.data.data(), image.data.size());
+		IO::write_binary(cacheDir + name, data.data(), data.size());
+	}
+	bool TextureCompressor::load(const std::string& path, int compression, Image& image, uint threadNum) {
+		return load(path, "", 0, compression, image, threadNum);
+	}
+	bool TextureCompressor::load(const std::string& path, const std::string& packPath, int packChannel, int compression, Image& image, uint threadNum) {
+		IO::MappedFile source, packSource;
+		if (!source.open(path))
+			return false;
+		if (packPath.empty())
+			return load(source.view(), nullptr, packChannel, compression, image, threadNum);
+		if (!packSource.open(packPath))
+			return false;
+		const IO::View packView = packSource.view();
+		return load(source.view(), &packView, packChannel, compression, image, threadNum);
+	}
+	bool TextureCompressor::load(const IO::View& source, const IO::View* packSource, int packChannel, int compression, Image& image, uint threadNum) {
+		// Key of source files and what they are compressed for
+		std::uint64_t key = 14695981039346656037ull;
+		hashBytes(key, source.data, source.size);
+		if (packSource != nullptr) {
+			hashBytes(key, packSource->data, packSource->size);
+			hashBytes(key, &packChannel, sizeof(packChannel));
+		}
+		const std::int32_t params[2] = { compression, TEXTURE_COMPRESS_VERSION };
+		hashBytes(key, params, sizeof(params));
+
+		if (loadCache(key, image)) {
+			cacheHitNum++;
+			return true;
+		}
+		cacheMissNum++;
+
+		int width, height, channels;
+		uchar* pixels;
+		if (packSource == nullptr) {
+			int imageChannels;
+			pixels = decode(source, width, height, imageChannels, 4);
+			channels = 4;
+		}
+		else
+			pixels = pack(source, *packSource, packChannel, width, height, channels);
+		if (pixels == nullptr)
+			return false;
+		image = compress(pixels, width, height, channels, format(compression, pixels, width, height, channels), threadNum);
+		stbi_image_free(pixels);
+		saveCache(key, image);
+		return true;
+	}
+
+	// Packing
+	uchar* TextureCompressor::pack(const std::string& path, const std::string& packPath, int packChannel, int& width, int& height, int& channels) {
+		IO::MappedFile source, packSource;
+		if (!source.open(path) || !packSource.open(packPath))
+			return nullptr;
+		return pack(source.view(), packSource.view(), packChannel, width, height, channels);
+	}
+	uchar* TextureCompressor::pack(const IO::View& source, const IO::View& packSource, int packChannel, int& width, int& height, int& channels) {
+		if (packChannel != 2 && packChannel != 3)
+			throw(std::runtime_error("[TEXTURE COMPRESS ERROR] : Maps are packed into blue or alpha only"));
+		channels = packChannel + 1;
+		int imageChannels, packWidth, packHeight, packChannels;
+		uchar* pixels = decode(source, width, height, imageChannels, channels);
+		if (pixels == nullptr)
+			return nullptr;
+		uchar* packPixels = decode(packSource, packWidth, packHeight, packChannels, 1);
+		if (packPixels == nullptr) {
+			stbi_image_free(pixels);
+			return nullptr;
+		}
+		for (int y = 0; y < height; y++) {
+			const int py = (int)((long long)y * packHeight / height);
+			for (int x = 0; x < width; x++) {
+				const int px = (int)((long long)x * packWidth / width);
+				pixels[((size_t)y * width + x) * channels + packChannel] = packPixels[(size_t)py * packWidth + px];
+			}
+		}
+		stbi_image_free(packPixels);
+		return pixels;
+	}
+	uchar* TextureCompressor::decode(const std::string& path, int& width, int& height, int& channels, int desired) {
+		IO::MappedFile file;
+		if (!file.open(path))
+			return nullptr;
+		return decode(file.view(), width, height, channels, desired);
+	}
+	uchar* TextureCompressor::decode(const IO::View& source, int& width, int& height, int& channels, int desired) {
+		if (source.size == 0 || source.size > (size_t)INT_MAX)
+			return nullptr;
+		return stbi_load_from_memory((const uchar*)source.data, (int)source.size, &width, &height, &channels, desired);
+	}
+	void TextureCompressor::free(uchar* pixels) {
+		stbi_image_free(pixels);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_TEXTURE_COMPRESS_H__
+#define __ME_TEXTURE_COMPRESS_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "IO.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What a texture holds, which decides its block format
+#define TEXTURE_COMPRESSION_NONE	0
+#define TEXTURE_COMPRESSION_COLOR	1		// BC1, or BC3 if any texel is not opaque
+#define TEXTURE_COMPRESSION_GRAY	2		// BC4, red channel only ( specular, parallax )
+#define TEXTURE_COMPRESSION_NORMAL	3		// BC5, x and y of tangent space normal, z is reconstructed in shader
+
+#define TEXTURE_BC1		1
+#define TEXTURE_BC3		3
+#define TEXTURE_BC4		4
+#define TEXTURE_BC5		5
+
+#define TEXTURE_COMPRESS_VERSION		1		// Bump when encoder output changes, to invalidate cache files
+
+namespace ME {
+	// CPU encoder of BC1 / BC3 / BC4 / BC5 blocks with full mip chains, and a cache of its results on disk.
+	// Rows of blocks are encoded on several threads, and palette distances 4 at a time with SSE.
+	class TextureCompressor {
+	public:
+		struct Image {
+			int format = 0;					// TEXTURE_BC*
+			int width = 0;
+			int height = 0;
+			int levelNum = 0;
+			std::vector<uchar> data;		// Blocks of each mip level one after another, largest first
+
+			inline bool getValid() const noexcept {
+				return format != 0 && levelNum > 0;
+			}
+		};
+	public:
+		// Block format for [ compression ] of [ pixels ] with [ channels ] channels, 0 for none.
+		// Without [ pixels ] color is taken as opaque, which is enough for [ supported() ] since BC1 and BC3 go together.
+		static int format(int compression, const uchar* pixels, int width, int height, int channels);
+		// True if driver takes [ format ] ( S3TC for BC1 and BC3, RGTC for BC4 and BC5 ). Call on GL thread.
+		static bool supported(int format);
+		// @srgb : Color formats ( BC1, BC3 ) in sRGB, see [ Texture2D::setSRGB() ]
+		static uint glFormat(int format, bool srgb = false);
+		static int blockSize(int format);
+		static size_t levelSize(int format, int width, int height);
+
+		// Encode [ pixels ] of [ channels ] channels into [ format ], with mip levels down to 1 x 1.
+		// Mip levels of BC1 and BC3 are filtered in linear space, the rest as they are.
+		// @threadNum : 0 for every hardware thread, 1 from a worker that already runs beside others
+		static Image compress(const uchar* pixels, int width, int height, int channels, int format, uint threadNum = 0);
+
+		// Next mip level of [ pixels ] with a 2 x 2 box filter, in linear space if [ linear ]. Odd edges repeat their last texel.
+		static std::vector<uchar> downsample(const uchar* pixels, int width, int height, int channels, bool linear);
+		// Drop the [ levels ] largest mip levels of [ image ], keeping at least one
+		static void dropLevels(Image& image, int levels);
+
+		// Encode single blocks. [ texels ] are 16 RGBA texels in row order.
+		static void encodeBC1(const uchar texels[64], uchar block[8]);
+		static void encodeBC3(const uchar texels[64], uchar block[16]);
+		// @channel : Component of [ texels ] to encode
+		static void encodeBC4(const uchar texels[64], int channel, uchar block[8]);
+		static void encodeBC5(const uchar texels[64], uchar block[16]);
+
+		// Cache
+		// Compressed images are kept in [ dir ] under the hash of their source file, empty [ dir ] turns it off.
+		static void setCacheDir(const std::string& dir);
+		static const std::string& getCacheDir() noexcept;
+		static uint getCacheHitNum() noexcept;
+		static uint getCacheMissNum() noexcept;
+		// Compressed image file at [ path ] for [ compression ], from cache if it is there, otherwise
+		// decoded, encoded and saved to cache. Returns false if the file cannot be read or decoded.
+		// Safe to call from worker threads.
+		static bool load(const std::string& path, int compression, Image& image, uint threadNum = 0);
+		// Same as above, with the gray image at [ packPath ] packed into [ packChannel ] as [ pack() ] does
+		static bool load(const std::string& path, const std::string& packPath, int packChannel, int compression, Image& image, uint threadNum = 0);
+		// Same as above, from file bytes already read into memory. [ packSource ] is nullptr if nothing is packed.
+		static bool load(const IO::View& source, const IO::View* packSource, int packChannel, int compression, Image& image, uint threadNum = 0);
+
+		// Packing
+		// Image at [ path ] with the gray image at [ packPath ] in its [ packChannel ] : 2 to replace blue
+		// ( height into a normal map, whose z is rebuilt in shader ), 3 to add alpha ( specular into a diffuse map ).
+		// [ packPath ] is resampled to the size of [ path ] if they differ. Returns nullptr if either cannot be
+		// read, otherwise pixels of [ channels ] = [ packChannel ] + 1 channels to free with [ free() ].
+		static uchar* pack(const std::string& path, const std::string& packPath, int packChannel, int& width, int& height, int& channels);
+		static uchar* pack(const IO::View& source, const IO::View& packSource, int packChannel, int& width, int& height, int& channels);
+		// Decode the image at [ path ] from its file mapping, as stbi_load() would but without reading the file into
+		// a buffer first. [ desired ] channels, 0 to keep those of the image. nullptr if it cannot be read.
+		static uchar* decode(const std::string& path, int& width, int& height, int& channels, int desired = 0);
+		static uchar* decode(const IO::View& source, int& width, int& height, int& channels, int desired = 0);
+		static void free(uchar* pixels);
+	};
+}
+
+#endif
\ No newline at end of file
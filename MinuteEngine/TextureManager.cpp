@@ -0,0 +1,247 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "TextureManager.h"
+#include "TextureStream.h"
+#include "Residency.h"
+#include "IO.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace ME {
+	// FNV-1a
+	static void hashBytes(std::uint64_t& hash, const void* data, size_t size) {
+		for (size_t i = 0; i < size; i++) {
+			hash ^= ((const uchar*)data)[i];
+			hash *= 1099511628211ull;
+		}
+		hash ^= 0xff;		// Separator between files and parameters
+		hash *= 1099511628211ull;
+	}
+
+	TextureManager& TextureManager::global() {
+		static TextureManager manager;
+		return manager;
+	}
+	void TextureManager::destroy() {
+		for (auto& entry : entries) {
+			auto texture = entry.second.texture.lock();
+			if (texture != nullptr) {
+				TextureStreamer::global().cancel(texture->id);
+				texture->destroy();
+			}
+		}
+		entries.clear();
+		pathKeys.clear();
+		idKeys.clear();
+		alive = false;
+	}
+
+	std::uint64_t TextureManager::key(const std::string& path, const std::string& packPath, const std::string& params) {
+		const std::string pathKey = path + '\n' + packPath + '\n' + params;
+		auto it = pathKeys.find(pathKey);
+		if (it != pathKeys.end())
+			return it->second;
+
+		std::uint64_t hash = 14695981039346656037ull;
+		IO::MappedFile file;
+		if (!file.open(path))
+			return 0;
+		hashBytes(hash, file.getData(), file.getSize());
+		if (!packPath.empty()) {
+			if (!file.open(packPath))
+				return 0;
+			hashBytes(hash, file.getData(), file.getSize());
+		}
+		hashBytes(hash, params.data(), params.size());
+		if (hash == 0)
+			hash = 1;
+		pathKeys[pathKey] = hash;
+		return hash;
+	}
+	TextureManager::Handle TextureManager::find(std::uint64_t key) {
+		requestNum++;
+		auto it = entries.find(key);
+		if (it == entries.end())
+			return nullptr;
+		Handle texture = it->second.texture.lock();
+		if (texture != nullptr)
+			sharedNum++;
+		return texture;
+	}
+	TextureManager::Handle TextureManager::insert(std::uint64_t key, const Texture2D& texture, const Entry& entry) {
+		std::shared_ptr<Texture2D> ptr(new Texture2D(texture), [this, key](Texture2D* texture) { release(key, texture); });
+		auto& e = entries[key] = entry;
+		e.texture = ptr;
+		e.lastUse = ResidencyManager::global().getFrame();
+		idKeys[texture.id] = key;
+		return ptr;
+	}
+	void TextureManager::release(std::uint64_t key, Texture2D* texture) {
+		if (alive && texture->id != 0) {
+			// A request for the same key may have loaded it again after this one expired
+			auto it = entries.find(key);
+			if (it != entries.end() && it->second.texture.expired())
+				entries.erase(it);
+			idKeys.erase(texture->id);
+			TextureStreamer::global().cancel(texture->id);
+			texture->destroy();
+		}
+		delete texture;
+	}
+
+	TextureManager::Handle TextureManager::load(const std::string& path, int compression, bool async, const Color& placeholder) {
+		const std::uint64_t k = key(path, "", std::to_string(compression));
+		if (k == 0)
+			throw(std::runtime_error("Texture image load failed : " + path));
+		auto texture = find(k);
+		if (texture != nullptr)
+			return texture;
+		Entry entry;
+		entry.path = path;
+		entry.compression = compression;
+		entry.placeholder = placeholder;
+		return insert(k, async ? Texture2D::createAsync(path, placeholder, compression) : Texture2D::create(path, compression), entry);
+	}
+	TextureManager::Handle TextureManager::loadPacked(const std::string& path, const std::string& packPath, int packChannel, int compression,
+		bool async, const Color& placeholder) {
+		const std::uint64_t k = key(path, packPath, std::to_string(compression) + ' ' + std::to_string(packChannel));
+		if (k == 0)
+			throw(std::runtime_error("Texture image load failed : " + path + ", " + packPath));
+		auto texture = find(k);
+		if (texture != nullptr)
+			return texture;
+		Entry entry;
+		entry.path = path;
+		entry.packPath = packPath;
+		entry.packChannel = packChannel;
+		entry.compression = compression;
+		entry.placeholder = placeholder;
+		return insert(k, async ?
+			Texture2D::createPackedAsync(path, packPath, packChannel, placeholder, compression) :
+			Texture2D::createPacked(path, packPath, packChannel, compression), entry);
+	}
+
+	// Residency
+	void TextureManager::restream(Entry& entry, const Texture2D& texture, int lod, int priority) {
+		// Stream jobs of the same texture replace each other, so the latest request wins
+		TextureStreamer::global().request(texture, entry.path, entry.compression, entry.packPath, entry.packChannel, lod, priority);
+		entry.lod = lod;
+	}
+	void TextureManager::touch(uint id) {
+		auto it = idKeys.find(id);
+		if (it == idKeys.end())
+			return;
+		auto& entry = entries.at(it->second);
+		entry.lastUse = ResidencyManager::global().getFrame();
+		if (entry.lod == 0)
+			return;
+		auto texture = entry.texture.lock();
+		if (texture == nullptr)
+			return;
+		restream(entry, *texture, 0, ASYNC_IO_PRIORITY_VISIBLE);		// Being drawn with a placeholder or blurred
+		entry.demoting = false;
+	}
+	size_t TextureManager::trim(size_t bytes, uint before) {
+		struct Candidate {
+			uint lastUse;
+			Entry* entry;
+			std::shared_ptr<Texture2D> texture;
+		};
+		std::vector<Candidate> candidates;
+		for (auto& entry : entries) {
+			auto texture = entry.second.texture.lock();
+			if (texture != nullptr && entry.second.lastUse < before && entry.second.lod != TEXTURE_LOD_EVICTED)
+				candidates.push_back({ entry.second.lastUse, &entry.second, texture });
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.lastUse < b.lastUse; });
+
+		// 1. Demote, so that they stay sharp enough if they come back into view
+		size_t freed = 0;
+		for (auto& c : candidates) {
+			if (freed >= bytes)
+				return freed;
+			if (c.entry->lod != 0)
+				continue;
+			const size_t current = Texture2D::getBytes(c.texture->id);
+			c.entry->expectedBytes = current >> (2 * TEXTURE_DEMOTE_LEVELS);
+			c.entry->demoting = true;
+			restream(*c.entry, *c.texture, TEXTURE_DEMOTE_LEVELS, ASYNC_IO_PRIORITY_BACKGROUND);
+			freed += current - c.entry->expectedBytes;
+		}
+		// 2. Evict to the placeholder, which frees memory right away
+		for (auto& c : candidates) {
+			if (freed >= bytes)
+				break;
+			const size_t current = (c.entry->demoting ? c.entry->expectedBytes : Texture2D::getBytes(c.texture->id));
+			TextureStreamer::global().cancel(c.texture->id);
+			const auto& p = c.entry->placeholder;
+			const uchar texel[4] = { (uchar)(p.r * 255.0f), (uchar)(p.g * 255.0f), (uchar)(p.b * 255.0f), (uchar)(p.a * 255.0f) };
+			Texture2D texture = *c.texture;
+			texture.upload(1, 1, texel, c.entry->packPath.empty() ? 3 : c.entry->packChannel + 1);
+			c.entry->lod = TEXTURE_LOD_EVICTED;
+			c.entry->demoting = false;
+			freed += current - std::min(current, Texture2D::getBytes(c.texture->id));
+		}
+		return freed;
+	}
+	size_t TextureManager::getExpectedBytes() const {
+		size_t bytes = 0;
+		for (const auto& entry : entries) {
+			auto texture = entry.second.texture.lock();
+			if (texture == nullptr)
+				continue;
+			const bool landed = TextureStreamer::global().getResident(texture->id);
+			bytes += (entry.second.demoting && !landed ? entry.second.expectedBytes : Texture2D::getBytes(texture->id));
+		}
+		return bytes;
+	}
+
+	// Stats
+	std::vector<TextureManager::Stat> TextureManager::getStats() const {
+		std::vector<Stat> stats;
+		for (const auto& entry : entries) {
+			auto texture = entry.second.texture.lock();
+			if (texture == nullptr)
+				continue;
+			Stat stat;
+			stat.path = entry.second.path;
+			stat.id = texture->id;
+			stat.bytes = Texture2D::getBytes(texture->id);
+			stat.userNum = texture.use_count() - 1;		// Not counting [ texture ] here
+			stat.resident = TextureStreamer::global().getResident(texture->id);
+			stat.lod = entry.second.lod;
+			stat.lastUse = entry.second.lastUse;
+			stats.push_back(stat);
+		}
+		std::sort(stats.begin(), stats.end(), [](const Stat& a, const Stat& b) { return a.bytes > b.bytes; });
+		return stats;
+	}
+	size_t TextureManager::getResidentBytes() const {
+		size_t bytes = 0;
+		for (const auto& entry : entries) {
+			auto texture = entry.second.texture.lock();
+			if (texture != nullptr)
+				bytes += Texture2D::getBytes(texture->id);
+		}
+		return bytes;
+	}
+	std::string TextureManager::getReport(uint maxNum) const {
+		const auto stats = getStats();
+		std::ostringstream ss;
+		ss << stats.size() << " textures, " << getResidentBytes() / 1024 << " KiB, " <<
+			sharedNum << " of " << requestNum << " requests shared";
+		for (size_t i = 0; i < stats.size() && i < maxNum; i++)
+			ss << "\n    " << stats[i].path << " : " << stats[i].bytes / 1024 << " KiB, " << stats[i].userNum << " users" <<
+				(stats[i].lod == TEXTURE_LOD_EVICTED ? ", evicted" : (stats[i].lod > 0 ? ", demoted" : "")) <<
+				(stats[i].resident ? "" : " ( streaming )");
+		return ss.str();
+	}
+}
\ No newline at end of file
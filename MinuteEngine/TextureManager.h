@@ -0,0 +1,118 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_TEXTURE_MANAGER_H__
+#define __ME_TEXTURE_MANAGER_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Texture.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define TEXTURE_LOD_EVICTED			-1
+#define TEXTURE_DEMOTE_LEVELS		2		// Demoted textures take 1 / 16 of their memory
+
+namespace ME {
+	// Shares textures between renders. Each texture is keyed by the content hash of its source files and how it
+	// is loaded, so the same image is on GPU once even if it comes from different paths. Handles are reference
+	// counted, and the GL texture is deleted when the last of them goes away.
+	// Files are hashed on their first load by path, and assumed not to change while they are loaded.
+	class TextureManager {
+	public:
+		using Handle = std::shared_ptr<const Texture2D>;
+
+		struct Stat {
+			std::string path;
+			uint id = 0;
+			size_t bytes = 0;			// GPU memory, see [ Texture2D::getBytes() ]
+			long userNum = 0;			// Handles to the texture
+			bool resident = false;		// False while [ TextureStreamer ] still shows a placeholder
+			int lod = 0;				// Mip levels dropped by [ ResidencyManager ], TEXTURE_LOD_EVICTED if evicted
+			uint lastUse = 0;			// Frame of [ ResidencyManager ] the texture was last drawn in
+		};
+	private:
+		struct Entry {
+			std::string path;
+			std::weak_ptr<Texture2D> texture;
+
+			// To load it again after eviction
+			std::string packPath;
+			int packChannel = 0;
+			int compression = TEXTURE_COMPRESSION_NONE;
+			Color placeholder;
+
+			// Residency
+			int lod = 0;
+			uint lastUse = 0;
+			size_t expectedBytes = 0;	// Bytes once a demotion being streamed lands
+			bool demoting = false;
+		};
+		std::unordered_map<std::string, std::uint64_t> pathKeys;	// Path and load parameters to key
+		std::unordered_map<std::uint64_t, Entry> entries;
+		std::unordered_map<uint, std::uint64_t> idKeys;			// Texture ID to key
+		bool alive = true;				// GL context is alive, see [ destroy() ]
+
+		uint requestNum = 0;
+		uint sharedNum = 0;				// Requests that got a texture already loaded
+
+		// Key of the files at [ path ] and [ packPath ] for [ params ], 0 if either cannot be read
+		std::uint64_t key(const std::string& path, const std::string& packPath, const std::string& params);
+		Handle find(std::uint64_t key);
+		Handle insert(std::uint64_t key, const Texture2D& texture, const Entry& entry);
+		// Stream [ entry ] again with [ lod ] levels dropped, reading its files in [ priority ] class
+		void restream(Entry& entry, const Texture2D& texture, int lod, int priority);
+		void release(std::uint64_t key, Texture2D* texture);
+	public:
+		static TextureManager& global();
+		// Delete every texture while GL context is alive. Handles that remain afterwards hold texture 0.
+		void destroy();
+
+		// Texture of the image at [ path ], the same one for every request of the same content.
+		// @compression : See [ Texture2D::create() ]
+		// @async : Load through [ TextureStreamer ], with [ placeholder ] until then
+		Handle load(const std::string& path, int compression = TEXTURE_COMPRESSION_NONE, bool async = true,
+			const Color& placeholder = Color::create(0.5f, 0.5f, 0.5f));
+		// Same as [ load() ], for [ Texture2D::createPacked() ]
+		Handle loadPacked(const std::string& path, const std::string& packPath, int packChannel, int compression = TEXTURE_COMPRESSION_NONE,
+			bool async = true, const Color& placeholder = Color::create(0.5f, 0.5f, 0.5f));
+
+		// Residency
+		// Mark texture [ id ] as drawn in this frame, and bring it back to full size if it was demoted or evicted.
+		// Textures that are not from this manager are ignored.
+		void touch(uint id);
+		// Demote, then evict textures not drawn since frame [ before ], least recently drawn first,
+		// until about [ bytes ] are freed. Returns bytes expected to be freed.
+		size_t trim(size_t bytes, uint before);
+		// Bytes of textures once demotions being streamed land
+		size_t getExpectedBytes() const;
+
+		// Stats
+		// Every texture that is alive, largest first
+		std::vector<Stat> getStats() const;
+		size_t getResidentBytes() const;
+		inline uint getTextureNum() const noexcept {
+			return (uint)entries.size();
+		}
+		inline uint getRequestNum() const noexcept {
+			return requestNum;
+		}
+		inline uint getSharedNum() const noexcept {
+			return sharedNum;
+		}
+		// Bytes of each texture, at most [ maxNum ] of them
+		std::string getReport(uint maxNum = 8) const;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,265 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "TextureStream.h"
+#include "Texture.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+
+#include "stbi/stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace ME {
+	TextureStreamer& TextureStreamer::global() {
+		static TextureStreamer streamer;
+		return streamer;
+	}
+	void TextureStreamer::destroy() {
+		// Reads still in flight would push their decoding onto the pool again
+		AsyncIO::global().stop();
+		pool.stop();
+		if (pbos[0] != 0)
+			glDeleteBuffers(TEXTURE_STREAM_PBO_NUM, pbos);
+		for (auto& pbo : pbos)
+			pbo = 0;
+	}
+
+	void TextureStreamer::request(const Texture2D& texture, const std::string& path, int compression, const std::string& packPath, int packChannel,
+		int skipLevels, int priority) {
+		auto job = std::make_shared<Job>();
+		job->texture = texture.id;
+		job->paths[0] = path;
+		job->packPath = packPath;
+		job->packChannel = packChannel;
+		job->skipLevels = skipLevels;
+		job->priority = priority;
+		// Checked here, GL is not current on workers
+		if (compression != TEXTURE_COMPRESSION_NONE &&
+			TextureCompressor::supported(TextureCompressor::format(compression, nullptr, 0, 0, 3)))
+			job->compression = compression;
+		request(job);
+	}
+	void TextureStreamer::request(const TextureCube& texture, const std::string path[6], int priority) {
+		auto job = std::make_shared<Job>();
+		job->texture = texture.id;
+		job->cube = true;
+		job->priority = priority;
+		for (int i = 0; i < 6; i++)
+			job->paths[i] = path[i];
+		request(job);
+	}
+	void TextureStreamer::request(const JobPtr& job) {
+		job->serial = nextSerial++;
+		pending[job->texture] = job->serial;
+		job->remaining = job->faceNum();
+		job->reading = job->faceNum() + (job->packPath.empty() ? 0 : 1);
+		auto& io = AsyncIO::global();
+		for (int i = 0; i < job->faceNum(); i++)
+			io.read(job->paths[i], job->priority, [this, job, i](AsyncIO::Result& result) {
+				job->sources[i] = std::move(result.data);
+				received(job);
+			});
+		if (!job->packPath.empty())
+			io.read(job->packPath, job->priority, [this, job](AsyncIO::Result& result) {
+				job->packSource = std::move(result.data);
+				received(job);
+			});
+	}
+	void TextureStreamer::received(const JobPtr& job) {
+		// On the reading thread, which should go back to reading
+		if (--job->reading == 0)
+			for (int i = 0; i < job->faceNum(); i++)
+				pool.push([this, job, i]() { decode(job, i); });
+	}
+	void TextureStreamer::decode(const JobPtr& job, int face) {
+		auto& f = job->faces[face];
+		const IO::View source = { job->sources[face].data(), job->sources[face].size() };
+		const IO::View packSource = { job->packSource.data(), job->packSource.size() };
+		const bool packed = !job->packPath.empty();
+		uchar* data = nullptr;
+		// Nothing is decoded if a file cannot be read, [ update() ] logs it and keeps the placeholder
+		if (job->compression != TEXTURE_COMPRESSION_NONE) {
+			// Single thread, other workers of the pool already encode in parallel
+			if (!packed || !packSource.empty())
+				TextureCompressor::load(source, packed ? &packSource : nullptr, job->packChannel, job->compression, job->image, 1);
+		}
+		else if (packed)
+			data = TextureCompressor::pack(source, packSource, job->packChannel, f.width, f.height, f.channels);
+		else {
+			// Cube faces are always RGB, 2D textures keep the channels of their image
+			data = TextureCompressor::decode(source, f.width, f.height, f.channels, job->cube ? 3 : 0);
+			if (job->cube)
+				f.channels = 3;
+		}
+		std::vector<char>().swap(job->sources[face]);
+		if (!job->cube)
+			std::vector<char>().swap(job->packSource);
+		if (data != nullptr)
+			f.pixels = std::shared_ptr<uchar>(data, stbi_image_free);
+
+		// Smaller image for a demoted texture
+		if (job->skipLevels > 0 && job->image.getValid())
+			TextureCompressor::dropLevels(job->image, job->skipLevels);
+		for (int l = 0; l < job->skipLevels && f.pixels != nullptr && (f.width > 1 || f.height > 1); l++) {
+			auto next = TextureCompressor::downsample(f.pixels.get(), f.width, f.height, f.channels, false);	// As glGenerateMipmap() would
+			f.pixels = std::shared_ptr<uchar>(new uchar[next.size()], std::default_delete<uchar[]>());
+			std::memcpy(f.pixels.get(), next.data(), next.size());
+			f.width = std::max(1, f.width / 2);
+			f.height = std::max(1, f.height / 2);
+		}
+		if (--job->remaining == 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			decoded.push_back(job);
+		}
+	}
+
+	std::vector<std::pair<const uchar*, size_t>> TextureStreamer::segments(const Job& job) {
+		std::vector<std::pair<const uchar*, size_t>> ret;
+		if (job.image.getValid())
+			ret.emplace_back(job.image.data.data(), job.image.data.size());
+		else
+			for (int i = 0; i < job.faceNum(); i++) {
+				const auto& face = job.faces[i];
+				ret.emplace_back(face.pixels.get(), (size_t)face.width * face.height * face.channels);
+			}
+		return ret;
+	}
+	size_t TextureStreamer::stage(Job& job, size_t budget) {
+		if (job.pbo < 0) {
+			if (pbos[0] == 0)
+				glGenBuffers(TEXTURE_STREAM_PBO_NUM, pbos);
+			job.pbo = nextPBO;
+			nextPBO = (nextPBO + 1) % TEXTURE_STREAM_PBO_NUM;
+			job.size = 0;
+			for (const auto& segment : segments(job))
+				job.size += segment.second;
+			job.staged = 0;
+
+			// Fresh storage, so that mapping does not wait for the last upload from this buffer
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[job.pbo]);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, job.size, NULL, GL_STREAM_DRAW);
+		}
+		else
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[job.pbo]);
+
+		const size_t size = std::min(budget, job.size - job.staged);
+		if (size > 0) {
+			auto* dst = (uchar*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, job.staged, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+			if (dst == nullptr)
+				throw(std::runtime_error("[TEXTURE STREAM ERROR] : Cannot map pixel buffer"));
+
+			// Faces, or levels of compressed image, lie one after another in the buffer
+			size_t copied = 0;
+			size_t segmentBegin = 0;
+			for (const auto& segment : segments(job)) {
+				if (copied >= size)
+					break;
+				const size_t from = job.staged + copied;
+				if (from < segmentBegin + segment.second) {
+					const size_t n = std::min(size - copied, segmentBegin + segment.second - from);
+					std::memcpy(dst + copied, segment.first + (from - segmentBegin), n);
+					copied += n;
+				}
+				segmentBegin += segment.second;
+			}
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			job.staged += size;
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return size;
+	}
+	void TextureStreamer::upload(Job& job) {
+		GLint alignment = 4;
+		glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[job.pbo]);
+
+		// Pixels are read from the buffer, so these are offsets
+		size_t offset = 0;
+		if (job.cube) {
+			TextureCube texture;
+			texture.id = job.texture;
+			for (int i = 0; i < 6; i++) {
+				const auto& face = job.faces[i];
+				texture.upload(i, face.width, face.height, (const void*)offset);
+				offset += (size_t)face.width * face.height * face.channels;
+			}
+		}
+		else {
+			Texture2D texture;
+			texture.id = job.texture;
+			const auto& image = job.image;
+			if (image.getValid())
+				texture.uploadCompressed(image.format, image.width, image.height, image.levelNum, (const void*)offset);
+			else
+				texture.upload(job.faces[0].width, job.faces[0].height, (const void*)offset, job.faces[0].channels);
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+		for (auto& face : job.faces)
+			face.pixels.reset();
+		job.image = TextureCompressor::Image();
+		pending.erase(job.texture);
+		uploadedBytes += job.size;
+	}
+	void TextureStreamer::update() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& job : decoded) {
+				if (cancelled(*job))
+					continue;
+				// A texture that failed to load keeps its placeholder, other jobs go on
+				bool failed = false;
+				for (int i = 0; i < job->faceNum() && !failed; i++) {
+					if (job->faces[i].pixels == nullptr && !job->image.getValid()) {
+						std::cerr << "[TEXTURE STREAMER] : Texture image load failed : " << job->paths[i] << std::endl;
+						failed = true;
+					}
+				}
+				if (failed) {
+					pending.erase(job->texture);
+					failedNum++;
+					continue;
+				}
+				uploads.push_back(job);
+			}
+			decoded.clear();
+		}
+
+		size_t budget = (frameBudget == 0 ? (size_t)-1 : frameBudget);
+		while (!uploads.empty() && budget > 0) {
+			auto& job = *uploads.front();
+			if (cancelled(job)) {
+				uploads.pop_front();
+				continue;
+			}
+			budget -= stage(job, budget);
+			if (job.staged < job.size)
+				break;
+			upload(job);
+			uploads.pop_front();
+		}
+	}
+	void TextureStreamer::finish() {
+		const size_t budget = frameBudget;
+		frameBudget = 0;
+		while (!pending.empty()) {
+			update();
+			if (!pending.empty())
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		frameBudget = budget;
+	}
+}
\ No newline at end of file
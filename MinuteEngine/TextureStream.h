@@ -0,0 +1,151 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_TEXTURE_STREAM_H__
+#define __ME_TEXTURE_STREAM_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "ThreadPool.h"
+#include "TextureCompress.h"
+#include "AsyncIO.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define TEXTURE_STREAM_PBO_NUM				3
+#define TEXTURE_STREAM_DEF_FRAME_BUDGET		(16u << 20)		// Bytes staged into pixel buffers per frame, 0 for no limit
+
+namespace ME {
+	class Texture2D;
+	class TextureCube;
+
+	// Loads textures without blocking the render thread. Files are read through [ AsyncIO ] in the priority class
+	// of their request, and once all files of a texture are in, images are decoded by a thread pool ( each face of a
+	// cube on its own ) and block-compressed there if they ask for it, then copied into a ring of pixel unpack buffers on the GL thread, at most [ frameBudget ]
+	// bytes per frame, and uploaded from there. A texture keeps its placeholder until the whole image is uploaded.
+	class TextureStreamer {
+	private:
+		struct Face {
+			int width = 0;
+			int height = 0;
+			int channels = 0;
+			std::shared_ptr<uchar> pixels;		// Freed by stbi_image_free(), or delete[] if resized
+		};
+		struct Job {
+			uint texture = 0;
+			bool cube = false;
+			std::string paths[6];
+			Face faces[6];
+			std::string packPath;				// Gray image packed into [ packChannel ] of the image, if any
+			int packChannel = 0;
+			int compression = TEXTURE_COMPRESSION_NONE;
+			int skipLevels = 0;					// Mip levels left out from the top, see [ ResidencyManager ]
+			int priority = ASYNC_IO_PRIORITY_NORMAL;
+			std::vector<char> sources[6];		// File bytes, freed once decoded
+			std::vector<char> packSource;
+			std::atomic<int> reading{ 0 };		// Files not read yet
+			TextureCompressor::Image image;		// Instead of [ faces ] if compressed
+			uint serial = 0;
+			std::atomic<int> remaining{ 0 };	// Faces not decoded yet
+
+			// Staging, on the GL thread
+			int pbo = -1;
+			size_t size = 0;
+			size_t staged = 0;
+
+			inline int faceNum() const noexcept {
+				return cube ? 6 : 1;
+			}
+		};
+		using JobPtr = std::shared_ptr<Job>;
+
+		std::mutex mutex;
+		std::vector<JobPtr> decoded;			// Filled by workers, taken by [ update() ]
+		std::deque<JobPtr> uploads;
+		// Textures that still show their placeholder, to the serial of their latest request. A job whose serial
+		// is not here was cancelled, even if GL has given its texture ID to a new texture since.
+		std::unordered_map<uint, uint> pending;
+		uint nextSerial = 0;
+
+		uint pbos[TEXTURE_STREAM_PBO_NUM] = { 0 };
+		int nextPBO = 0;
+		size_t frameBudget = TEXTURE_STREAM_DEF_FRAME_BUDGET;
+		size_t uploadedBytes = 0;
+		uint failedNum = 0;					// Textures whose images could not be read or decoded
+
+		ThreadPool pool;					// Last, so that workers stop before the rest is destroyed
+
+		void request(const JobPtr& job);
+		// Called as each file of [ job ] is read, pushes decoding once all of them are
+		void received(const JobPtr& job);
+		void decode(const JobPtr& job, int face);
+		// Copy as much of [ job ] as [ budget ] allows into its pixel buffer. Returns bytes copied.
+		size_t stage(Job& job, size_t budget);
+		// Pixels of [ job ] in the order they lie in its pixel buffer
+		static std::vector<std::pair<const uchar*, size_t>> segments(const Job& job);
+		void upload(Job& job);
+		inline bool cancelled(const Job& job) const {
+			auto it = pending.find(job.texture);
+			return it == pending.end() || it->second != job.serial;
+		}
+	public:
+		static TextureStreamer& global();
+		// Release pixel buffers, while GL context is alive
+		void destroy();
+
+		// @compression : TEXTURE_COMPRESSION_*, see [ Texture2D::create() ]
+		// @packPath, packChannel : See [ Texture2D::createPacked() ]
+		// @skipLevels : Upload the image from this mip level on, i.e. at 1 / 2^skipLevels of its size
+		// @priority : ASYNC_IO_PRIORITY_*, order in which files are read
+		void request(const Texture2D& texture, const std::string& path, int compression = TEXTURE_COMPRESSION_NONE,
+			const std::string& packPath = "", int packChannel = 0, int skipLevels = 0, int priority = ASYNC_IO_PRIORITY_NORMAL);
+		void request(const TextureCube& texture, const std::string path[6], int priority = ASYNC_IO_PRIORITY_NORMAL);
+		// Stage and upload decoded images within the frame budget. Call once per frame on the GL thread.
+		// A texture whose image cannot be read or decoded is logged, and keeps its placeholder.
+		void update();
+		// Block until every requested texture is resident
+		void finish();
+		// Drop what is requested for [ texture ], before it is deleted
+		inline void cancel(uint texture) {
+			pending.erase(texture);
+		}
+
+		inline bool getResident(uint texture) const {
+			return pending.find(texture) == pending.end();
+		}
+		inline uint getPendingNum() const noexcept {
+			return (uint)pending.size();
+		}
+		inline uint getFailedNum() const noexcept {
+			return failedNum;
+		}
+		inline size_t getUploadedBytes() const noexcept {
+			return uploadedBytes;
+		}
+		inline size_t getFrameBudget() const noexcept {
+			return frameBudget;
+		}
+		inline void setFrameBudget(size_t bytes) noexcept {
+			frameBudget = bytes;
+		}
+		inline void setThreadNum(uint num) {
+			pool.stop();
+			pool.start(num);
+		}
+	};
+}
+
+#endif
\ No newline at end of file
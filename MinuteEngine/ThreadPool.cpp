@@ -0,0 +1,65 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace ME {
+	ThreadPool::~ThreadPool() {
+		stop();
+	}
+	void ThreadPool::start(uint threadNum) {
+		if (!workers.empty())
+			return;
+		if (threadNum == 0) {
+			const uint hardware = std::thread::hardware_concurrency();
+			threadNum = std::max(1u, (hardware > 1 ? hardware - 1 : 1u));
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = false;
+		}
+		for (uint i = 0; i < threadNum; i++)
+			workers.emplace_back(&ThreadPool::work, this);
+	}
+	void ThreadPool::stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			jobs.clear();
+		}
+		condition.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+	void ThreadPool::push(std::function<void()> job) {
+		if (workers.empty())
+			start();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		condition.notify_one();
+	}
+	void ThreadPool::work() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping)
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+}
\ No newline at end of file
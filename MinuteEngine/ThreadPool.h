@@ -0,0 +1,55 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_THREAD_POOL_H__
+#define __ME_THREAD_POOL_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ME {
+	// Fixed number of worker threads that run jobs in the order they were pushed.
+	// Jobs must not touch OpenGL, which only works on the thread that owns the context.
+	class ThreadPool {
+	private:
+		std::vector<std::thread> workers;
+		std::deque<std::function<void()>> jobs;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping = false;
+
+		void work();
+	public:
+		ThreadPool() = default;
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		// @threadNum : 0 to leave a hardware thread for the render thread, at least 1
+		void start(uint threadNum = 0);
+		// Drop jobs that have not started, and wait for the running ones
+		void stop();
+		// Start with default number of threads if not started yet
+		void push(std::function<void()> job);
+
+		inline uint getThreadNum() const noexcept {
+			return (uint)workers.size();
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#include "VarianceShadow.h"
+#include "Residency.h"
+
+#include <GL/glew.h>
+#include <SDL_opengl.h>
+
+namespace ME {
+	// Make a RGBA32F texture of [ size ] x [ size ] and a framebuffer that renders into its first level
+	static void createMomentTarget(uint size, bool mipmap, uint& fbo, uint& texture) {
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (mipmap)
+			glGenerateMipmap(GL_TEXTURE_2D);	// Allocate every level
+		const size_t bytes = (size_t)size * size * 16;
+		ResidencyManager::global().setTargetBytes(texture, mipmap ? bytes * 4 / 3 : bytes);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	VarianceShadow VarianceShadow::create(uint mapSize) {
+		VarianceShadow vs;
+		vs.mapSize = mapSize;
+		createMomentTarget(mapSize, true, vs.fbo, vs.momentMap);
+		createMomentTarget(mapSize, false, vs.tempFBO, vs.tempMap);
+		return vs;
+	}
+	void VarianceShadow::destroy() {
+		ResidencyManager::global().eraseTarget(momentMap);
+		ResidencyManager::global().eraseTarget(tempMap);
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteTextures(1, &momentMap);
+		glDeleteFramebuffers(1, &tempFBO);
+		glDeleteTextures(1, &tempMap);
+		fbo = 0;
+		momentMap = 0;
+		tempFBO = 0;
+		tempMap = 0;
+	}
+}
\ No newline at end of file
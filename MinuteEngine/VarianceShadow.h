@@ -0,0 +1,89 @@
+/*
+ *******************************************************************************************
+ * Author	: Sang Hyun Son
+ * Email	: shh1295@gmail.com
+ * Github	: github.com/SonSang
+ *******************************************************************************************
+ */
+
+#ifndef __ME_VARIANCE_SHADOW_H__
+#define __ME_VARIANCE_SHADOW_H__
+
+#ifdef _MSC_VER
+#pragma once
+#endif
+
+#include "Utils.h"
+#include "glm/vec2.hpp"
+
+#define VARIANCE_SHADOW_DEF_MAP_SIZE		512
+#define VARIANCE_SHADOW_DEF_BLUR_RADIUS		4			// In texels of moment map
+#define VARIANCE_SHADOW_MAX_BLUR_RADIUS		15
+#define VARIANCE_SHADOW_DEF_POS_EXPONENT	40.0f		// Exponents of EVSM warp, limited by 32 bit float range
+#define VARIANCE_SHADOW_DEF_NEG_EXPONENT	5.0f
+#define VARIANCE_SHADOW_DEF_BLEED_REDUCTION	0.2f		// Cut off of Chebyshev bound that hides light bleeding
+
+namespace ME {
+	// Pre-filtered shadow of a [ Shadow ] ( exponential variance shadow map ). Depth rendered into [ ShadowAtlas ]
+	// is converted into 4 moments of exponentially warped depth, blurred by separable Gaussian and mip-mapped,
+	// so that a single filtered fetch gives soft shadow of any width.
+	class VarianceShadow {
+	private:
+		bool valid = false;
+		uint fbo = 0;
+		uint momentMap = 0;				// RGBA32F : exp(c+ d), exp(c+ d)^2, -exp(-c- d), exp(-c- d)^2, with mipmaps
+		uint tempFBO = 0;
+		uint tempMap = 0;				// Result of horizontal blur
+		uint mapSize = VARIANCE_SHADOW_DEF_MAP_SIZE;
+
+		int blurRadius = VARIANCE_SHADOW_DEF_BLUR_RADIUS;
+		glm::vec2 exponents = glm::vec2(VARIANCE_SHADOW_DEF_POS_EXPONENT, VARIANCE_SHADOW_DEF_NEG_EXPONENT);
+		float bleedReduction = VARIANCE_SHADOW_DEF_BLEED_REDUCTION;
+	public:
+		static VarianceShadow create(uint mapSize = VARIANCE_SHADOW_DEF_MAP_SIZE);
+		void destroy();
+
+		inline uint getFBO() const noexcept {
+			return fbo;
+		}
+		inline uint getMomentMap() const noexcept {
+			return momentMap;
+		}
+		inline uint getTempFBO() const noexcept {
+			return tempFBO;
+		}
+		inline uint getTempMap() const noexcept {
+			return tempMap;
+		}
+		inline uint getMapSize() const noexcept {
+			return mapSize;
+		}
+		inline int getBlurRadius() const noexcept {
+			return blurRadius;
+		}
+		inline const glm::vec2& getExponents() const noexcept {
+			return exponents;
+		}
+		inline float getBleedReduction() const noexcept {
+			return bleedReduction;
+		}
+		inline bool getValid() const noexcept {
+			return valid;
+		}
+
+		inline void setValid(bool valid) noexcept {
+			this->valid = valid;
+		}
+		inline void setBlurRadius(int radius) noexcept {
+			blurRadius = (radius < 0 ? 0 : (radius > VARIANCE_SHADOW_MAX_BLUR_RADIUS ? VARIANCE_SHADOW_MAX_BLUR_RADIUS : radius));
+		}
+		inline void setExponents(const glm::vec2& exponents) noexcept {
+			this->exponents = exponents;
+		}
+		inline void setBleedReduction(float reduction) noexcept {
+			bleedReduction = reduction;
+		}
+	};
+}
+
+#endif
\ No newline at end of file